@@ -147,10 +147,14 @@ HEADERS += \
 	src/gl/glmesh.h \
 	src/gl/glnode.h \
 	src/gl/glparticles.h \
+	src/gl/glpicking.h \
+	src/gl/glprofiler.h \
 	src/gl/glproperty.h \
 	src/gl/glscene.h \
+	src/gl/glskinning.h \
 	src/gl/gltex.h \
 	src/gl/gltexloaders.h \
+	src/gl/glthumbnail.h \
 	src/gl/gltools.h \
 	src/gl/icontrollable.h \
 	src/gl/renderer.h \
@@ -212,10 +216,14 @@ SOURCES += \
 	src/gl/glmesh.cpp \
 	src/gl/glnode.cpp \
 	src/gl/glparticles.cpp \
+	src/gl/glpicking.cpp \
+	src/gl/glprofiler.cpp \
 	src/gl/glproperty.cpp \
 	src/gl/glscene.cpp \
+	src/gl/glskinning.cpp \
 	src/gl/gltex.cpp \
 	src/gl/gltexloaders.cpp \
+	src/gl/glthumbnail.cpp \
 	src/gl/gltools.cpp \
 	src/gl/renderer.cpp \
 	src/io/material.cpp \
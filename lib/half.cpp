@@ -43,6 +43,16 @@
 
 #include "half.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HALF_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(__AVX2__)
+#define HALF_AVX2
+#include <immintrin.h>
+#endif
+
 // Load immediate
 static inline uint32_t _uint32_li( uint32_t a )
 {
@@ -447,6 +457,99 @@ half_to_float( uint16_t h )
   return (f_result);
 }
 
+// half_to_float_array
+// -------------------
+//
+//  Converts an array of halves, with exactly the same results as half_to_float.
+//
+//  Normals are rebiased, Inf/NaN keep their mantissa and denormals are
+//  scaled from the integer mantissa, which is exact in single precision.
+//  F16C is not used because it quiets signaling NaNs.
+//
+#if defined(HALF_SSE2)
+static inline __m128i _half_to_float_sse2( __m128i h )
+{
+  const __m128i h_s_mask       = _mm_set1_epi32( 0x00008000 );
+  const __m128i h_em_mask      = _mm_set1_epi32( 0x00007fff );
+  const __m128i h_f_bias       = _mm_set1_epi32( 0x38000000 );
+  const __m128i h_e_mask_m1    = _mm_set1_epi32( 0x00007bff );
+  const __m128i h_m_hidden     = _mm_set1_epi32( 0x00000400 );
+  const __m128  h_denorm_scale = _mm_set1_ps( 5.9604644775390625e-8f ); // 2^-24
+  const __m128i f_s            = _mm_slli_epi32( _mm_and_si128( h, h_s_mask ), 16 );
+  const __m128i h_em           = _mm_and_si128( h, h_em_mask );
+  const __m128i f_em_norm      = _mm_add_epi32( _mm_slli_epi32( h_em, 13 ), h_f_bias );
+  const __m128i is_infnan      = _mm_cmpgt_epi32( h_em, h_e_mask_m1 );
+  const __m128i f_em_infnan    = _mm_add_epi32( f_em_norm, _mm_and_si128( is_infnan, h_f_bias ) );
+  const __m128i is_denorm      = _mm_cmplt_epi32( h_em, h_m_hidden );
+  const __m128i f_em_denorm    = _mm_castps_si128( _mm_mul_ps( _mm_cvtepi32_ps( h_em ), h_denorm_scale ) );
+  const __m128i f_em           = _mm_or_si128( _mm_and_si128( is_denorm, f_em_denorm ), _mm_andnot_si128( is_denorm, f_em_infnan ) );
+
+  return _mm_or_si128( f_s, f_em );
+}
+#endif
+
+#if defined(HALF_AVX2)
+static inline __m256i _half_to_float_avx2( __m256i h )
+{
+  const __m256i h_s_mask       = _mm256_set1_epi32( 0x00008000 );
+  const __m256i h_em_mask      = _mm256_set1_epi32( 0x00007fff );
+  const __m256i h_f_bias       = _mm256_set1_epi32( 0x38000000 );
+  const __m256i h_e_mask_m1    = _mm256_set1_epi32( 0x00007bff );
+  const __m256i h_m_hidden     = _mm256_set1_epi32( 0x00000400 );
+  const __m256  h_denorm_scale = _mm256_set1_ps( 5.9604644775390625e-8f ); // 2^-24
+  const __m256i f_s            = _mm256_slli_epi32( _mm256_and_si256( h, h_s_mask ), 16 );
+  const __m256i h_em           = _mm256_and_si256( h, h_em_mask );
+  const __m256i f_em_norm      = _mm256_add_epi32( _mm256_slli_epi32( h_em, 13 ), h_f_bias );
+  const __m256i is_infnan      = _mm256_cmpgt_epi32( h_em, h_e_mask_m1 );
+  const __m256i f_em_infnan    = _mm256_add_epi32( f_em_norm, _mm256_and_si256( is_infnan, h_f_bias ) );
+  const __m256i is_denorm      = _mm256_cmpgt_epi32( h_m_hidden, h_em );
+  const __m256i f_em_denorm    = _mm256_castps_si256( _mm256_mul_ps( _mm256_cvtepi32_ps( h_em ), h_denorm_scale ) );
+  const __m256i f_em           = _mm256_blendv_epi8( f_em_infnan, f_em_denorm, is_denorm );
+
+  return _mm256_or_si256( f_s, f_em );
+}
+#endif
+
+void
+half_to_float_array( const uint16_t * src, uint32_t * dst, size_t count )
+{
+  size_t i = 0;
+
+#if defined(HALF_AVX2)
+  for ( ; i + 8 <= count; i += 8 ) {
+    const __m256i h = _mm256_cvtepu16_epi32( _mm_loadu_si128( (const __m128i *)(src + i) ) );
+    _mm256_storeu_si256( (__m256i *)(dst + i), _half_to_float_avx2( h ) );
+  }
+#endif
+
+#if defined(HALF_SSE2)
+  const __m128i zero = _mm_setzero_si128();
+  for ( ; i + 8 <= count; i += 8 ) {
+    const __m128i h = _mm_loadu_si128( (const __m128i *)(src + i) );
+    _mm_storeu_si128( (__m128i *)(dst + i), _half_to_float_sse2( _mm_unpacklo_epi16( h, zero ) ) );
+    _mm_storeu_si128( (__m128i *)(dst + i + 4), _half_to_float_sse2( _mm_unpackhi_epi16( h, zero ) ) );
+  }
+#endif
+
+  for ( ; i < count; i++ )
+    dst[i] = half_to_float( src[i] );
+}
+
+// half_from_float_array
+// ---------------------
+//
+//  Converts an array of floats, with exactly the same results as half_from_float.
+//
+//  half_from_float is branch-free and is left for the compiler to vectorize,
+//  since the hardware conversions round to nearest even instead.
+//
+void
+half_from_float_array( const uint32_t * src, uint16_t * dst, size_t count )
+{
+  for ( size_t i = 0; i < count; i++ )
+    dst[i] = half_from_float( src[i] );
+}
+
 // half_add
 // --------
 //
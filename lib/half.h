@@ -1,10 +1,13 @@
 #ifndef HALF_H
 #define HALF_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 uint32_t half_to_float( uint16_t h );
 uint16_t half_from_float( uint32_t f );
+void half_to_float_array( const uint16_t * src, uint32_t * dst, size_t count );
+void half_from_float_array( const uint32_t * src, uint16_t * dst, size_t count );
 uint16_t half_add( uint16_t arg0, uint16_t arg1 );
 uint16_t half_mul( uint16_t arg0, uint16_t arg1 );
 
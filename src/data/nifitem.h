@@ -276,6 +276,30 @@ public:
 		qDeleteAll( childItems );
 	}
 
+	/*! Deep copy this item and all of its children
+	 *
+	 * The NifData of each item is shared with the source until modified.
+	 *
+	 * @param parent	The parent of the copy
+	 * @return			The copied item
+	 */
+	NifItem * clone( NifItem * parent = nullptr ) const
+	{
+		NifItem * item = new NifItem( itemData, parent );
+		item->linkAncestorRows = linkAncestorRows;
+		item->linkRows = linkRows;
+		item->arrConds = arrConds;
+		item->rowIdx = (parent) ? rowIdx : -1;
+		item->conditionStatus = conditionStatus;
+		item->vercondStatus = vercondStatus;
+
+		item->childItems.reserve( childItems.count() );
+		for ( const NifItem * c : childItems )
+			item->childItems.append( c->clone( item ) );
+
+		return item;
+	}
+
 	//! Return the parent item.
 	NifItem * parent() const
 	{
@@ -258,6 +258,12 @@ public:
 	bool isMatrix4() const { return typ == tMatrix4; }
 	//! Check if the type of the data is a quaternion type.
 	bool isQuat() const { return typ == tQuat || typ == tQuatXYZW; }
+	//! Check if the type of the data is stored with a size independent of its value.
+	bool isFixedSize() const
+	{
+		return isCount() || isFloat() || isLink()
+			|| (typ >= tColor3 && typ <= tTriangle) || (typ >= tHalfVector3 && typ <= tBSVertexDesc);
+	}
 	//! Check if the type of the data is a string type.
 	bool isString() const { return (typ >= tSizedString && typ <= tChar8String) || typ == tString; }
 	//! Check if the type of the data is a Vector 4.
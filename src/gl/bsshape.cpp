@@ -30,6 +30,13 @@ void BSShape::clear()
 	colors.clear();
 	bones.clear();
 	weights.clear();
+
+	releaseBuffers();
+
+	lodSource.clear();
+
+	pickTriangles.clear();
+	pickTree.clear();
 }
 
 void BSShape::update( const NifModel * nif, const QModelIndex & index )
@@ -45,7 +52,10 @@ void BSShape::update( const NifModel * nif, const QModelIndex & index )
 		return;
 
 	// Update shaders from this mesh's shader property
-	updateShaderProperties( nif );
+	//	Only changes to blocks the program conditions read reset the selected program
+	bool shaderInput = index.isValid() && (iBlock == index || extraData);
+	if ( shaderInput )
+		updateShaderProperties( nif );
 
 	if ( extraData )
 		return;
@@ -53,8 +63,10 @@ void BSShape::update( const NifModel * nif, const QModelIndex & index )
 	nifVersion = nif->getUserVersion2();
 
 	isLOD = nif->isNiBlock( iBlock, "BSMeshLODTriShape" );
-	if ( isLOD )
+	if ( isLOD ) {
+		updateLodSizes( nif );
 		emit nif->lodSliderChanged( true );
+	}
 
 	auto vertexFlags = nif->get<BSVertexDesc>( iBlock, "Vertex Desc" );
 
@@ -183,6 +195,8 @@ void BSShape::update( const NifModel * nif, const QModelIndex & index )
 			for ( int i = 0; i < nif->rowCount( partIdx ); i++ )
 				triangles << nif->getArray<Triangle>( nif->index( i, 0, partIdx ), "Triangles" );
 		}
+
+		invalidateBuffers();
 	}
 
 	if ( bssp )
@@ -235,6 +249,8 @@ void BSShape::transform()
 		bones.clear();
 		weights.clear();
 		partitions.clear();
+		gpuSkinnable = false;
+		boneRevision = -1;
 
 		if ( iSkin.isValid() && iSkinData.isValid() ) {
 			skeletonRoot = nif->getLink( iSkin, "Skeleton Root" );
@@ -246,6 +262,8 @@ void BSShape::transform()
 			for ( int i = 0; i < bones.count(); i++ )
 				weights[i].bone = bones[i];
 
+			skin.resetInfluences( verts.count(), 4 );
+
 			for ( int i = 0; i < numVerts; i++ ) {
 				auto idx = nif->index( i, 0, iVertData );
 				auto wts = nif->getArray<float>( idx, "Bone Weights" );
@@ -257,8 +275,10 @@ void BSShape::transform()
 					if ( bns[j] >= weights.count() )
 						continue;
 
-					if ( wts[j] > 0.0 )
+					if ( wts[j] > 0.0 ) {
 						weights[bns[j]].weights << VertexWeight( i, wts[j] );
+						skin.addInfluence( i, bns[j], wts[j] );
+					}
 				}
 			}
 
@@ -267,6 +287,12 @@ void BSShape::transform()
 				weights[i].setTransform( nif, b.child( i, 0 ) );
 
 			isSkinned = weights.count();
+
+			gpuSkinnable = isSkinned && weights.count() <= MAX_GPU_BONES
+				&& skin.exportInfluences( weights.count(), boneIndices, boneWeights );
+			boneIndexBuffer.invalidate();
+			boneWeightBuffer.invalidate();
+			bindSphere = BoundSphere( verts );
 		}
 	}
 
@@ -288,66 +314,52 @@ void BSShape::transformShapes()
 
 	transformRigid = true;
 
+	gpuSkinned = false;
+
 	if ( isSkinned && scene->options & Scene::DoSkinning ) {
 		transformRigid = false;
 
-		int vcnt = verts.count();
-
-		transVerts.resize( vcnt );
-		transVerts.fill( Vector3() );
-		transNorms.resize( vcnt );
-		transNorms.fill( Vector3() );
-		transTangents.resize( vcnt );
-		transTangents.fill( Vector3() );
-		transBitangents.resize( vcnt );
-		transBitangents.fill( Vector3() );
-
-
-		Node * root = findParent( 0 );
-		for ( const BoneWeights & bw : weights ) {
-			Node * bone = root ? root->findChild( bw.bone ) : nullptr;
-			if ( bone ) {
-				Transform t = scene->view * bone->localTrans( 0 ) * bw.trans;
-				for ( const VertexWeight & w : bw.weights ) {
-					if ( w.vertex >= vcnt )
-						continue;
+		updateBoneTransforms();
 
-					transVerts[w.vertex] += t * verts[w.vertex] * w.weight;
-					transNorms[w.vertex] += t.rotation * norms[w.vertex] * w.weight;
-					transTangents[w.vertex] += t.rotation * tangents[w.vertex] * w.weight;
-					transBitangents[w.vertex] += t.rotation * bitangents[w.vertex] * w.weight;
-				}
-			}
-		}
+		gpuSkinned = gpuSkinningAvailable();
+		if ( gpuSkinned )
+			skinOnGpu();
+		else
+			skinVertices();
+	} else {
+		useBindPose();
+	}
 
-		for ( int n = 0; n < vcnt; n++ ) {
-			transNorms[n].normalize();
-			transTangents[n].normalize();
-			transBitangents[n].normalize();
-		}
+	updateSortedTriangles();
 
-		boundSphere = BoundSphere( transVerts );
-		boundSphere.applyInv( viewTrans() );
-		updateBounds = false;
+	transColors = colors;
+	if ( bslsp && !(bslsp->getFlags1() & ShaderFlags::SLSF1_Vertex_Alpha) ) {
+		setColorAlpha( -1.0f );
+		for ( int c = 0; c < colors.count(); c++ )
+			transColors[c] = Color4( colors[c].red(), colors[c].green(), colors[c].blue(), 1.0f );
 	} else {
-		transVerts = verts;
-		transNorms = norms;
-		transTangents = tangents;
-		transBitangents = bitangents;
+		setColorAlpha( 1.0f );
 	}
+}
 
-	transColors = colors;
-	if ( bslsp ) {
-		if ( !(bslsp->getFlags1() & ShaderFlags::SLSF1_Vertex_Alpha) ) {
-			for ( int c = 0; c < colors.count(); c++ )
-				transColors[c] = Color4( colors[c].red(), colors[c].green(), colors[c].blue(), 1.0f );
-		}
+void BSShape::updateBoneTransforms()
+{
+	// Bones missing from the scene do not contribute
+	skin.setBoneCount( weights.count() );
+
+	updateBoneNodes( 0 );
+	for ( int b = 0; b < weights.count(); b++ ) {
+		Node * bone = boneNodes.value( b );
+		if ( bone )
+			skin.setBone( b, scene->view * bone->localTrans( 0 ) * weights[b].trans );
+		else
+			skin.clearBone( b );
 	}
 }
 
 void BSShape::drawShapes( NodeList * secondPass, bool presort )
 {
-	if ( isHidden() )
+	if ( isHidden() || culled )
 		return;
 
 	glPointSize( 8.5 );
@@ -356,8 +368,6 @@ void BSShape::drawShapes( NodeList * secondPass, bool presort )
 	if ( !(scene->options & Scene::ShowMarkers) && name.contains( "EditorMarker" ) )
 		return;
 
-	auto nif = static_cast<const NifModel *>(iBlock.model());
-
 	if ( Node::SELECTING ) {
 		if ( scene->selMode & Scene::SelObject ) {
 			int s_nodeId = ID2COLORKEY( nodeId );
@@ -367,6 +377,9 @@ void BSShape::drawShapes( NodeList * secondPass, bool presort )
 		}
 	}
 
+	// BSOrderedNode
+	presorted |= presort;
+
 	// Draw translucent meshes in second pass
 	AlphaProperty * aprop = findProperty<AlphaProperty>();
 	Material * mat = (bssp) ? bssp->mat() : nullptr;
@@ -379,6 +392,16 @@ void BSShape::drawShapes( NodeList * secondPass, bool presort )
 		return;
 	}
 
+	// Other opaque shapes are drawn after the traversal, sorted by render state
+	if ( secondPass && !presorted && scene->enqueue( this ) )
+		return;
+
+	// Picking draws without shaders, so skin on the CPU
+	if ( gpuSkinned && Node::SELECTING ) {
+		gpuSkinned = false;
+		skinVertices();
+	}
+
 	if ( transformRigid ) {
 		glPushMatrix();
 		glMultMatrix( viewTrans() );
@@ -390,21 +413,28 @@ void BSShape::drawShapes( NodeList * secondPass, bool presort )
 		glPolygonOffset( 1.0f, 2.0f );
 	}
 
+	QOpenGLFunctions * fn = scene->renderer->fn;
+
 	glEnableClientState( GL_VERTEX_ARRAY );
-	glVertexPointer( 3, GL_FLOAT, 0, transVerts.constData() );
+	if ( vertBuffer.bind( fn, transVerts ) )
+		glVertexPointer( 3, GL_FLOAT, 0, nullptr );
+	else
+		glVertexPointer( 3, GL_FLOAT, 0, transVerts.constData() );
 
 	if ( !Node::SELECTING ) {
-		glEnableClientState( GL_NORMAL_ARRAY );
-		glNormalPointer( GL_FLOAT, 0, transNorms.constData() );
+		if ( normBuffer.bind( fn, transNorms ) ) {
+			glEnableClientState( GL_NORMAL_ARRAY );
+			glNormalPointer( GL_FLOAT, 0, nullptr );
+		}
 
 		bool doVCs = (bssp && (bssp->getFlags2() & ShaderFlags::SLSF2_Vertex_Colors));
 		// Always do vertex colors for FO4 if colors present
 		if ( nifVersion == 130 && hasVertexColors && colors.count() )
 			doVCs = true;
 
-		if ( transColors.count() && (scene->options & Scene::DoVertexColors) && doVCs ) {
+		if ( (scene->options & Scene::DoVertexColors) && doVCs && colorBuffer.bind( fn, transColors ) ) {
 			glEnableClientState( GL_COLOR_ARRAY );
-			glColorPointer( 4, GL_FLOAT, 0, transColors.constData() );
+			glColorPointer( 4, GL_FLOAT, 0, nullptr );
 		} else if ( !hasVertexColors && (bslsp && bslsp->hasVertexColors) ) {
 			// Correctly blacken the mesh if SLSF2_Vertex_Colors is still on
 			//	yet "Has Vertex Colors" is not.
@@ -414,44 +444,26 @@ void BSShape::drawShapes( NodeList * secondPass, bool presort )
 		}
 	}
 
+	// Texture coordinates of the fixed function pipeline are client side arrays
+	fn->glBindBuffer( GL_ARRAY_BUFFER, 0 );
 
 	if ( !Node::SELECTING )
 		shader = scene->renderer->setupProgram( this, shader );
 	
 	if ( isDoubleSided ) {
 		glCullFace( GL_FRONT );
-		glDrawElements( GL_TRIANGLES, triangles.count() * 3, GL_UNSIGNED_SHORT, triangles.constData() );
+		drawTriangles( 0, sortedTriangles.count() );
 		glCullFace( GL_BACK );
 	}
 
 	if ( !isLOD ) {
-		glDrawElements( GL_TRIANGLES, triangles.count() * 3, GL_UNSIGNED_SHORT, triangles.constData() );
-	} else if ( triangles.count() ) {
-		auto lod0 = nif->get<uint>( iBlock, "LOD0 Size" );
-		auto lod1 = nif->get<uint>( iBlock, "LOD1 Size" );
-		auto lod2 = nif->get<uint>( iBlock, "LOD2 Size" );
-
-		auto lod0tris = triangles.mid( 0, lod0 );
-		auto lod1tris = triangles.mid( lod0, lod1 );
-		auto lod2tris = triangles.mid( lod0 + lod1, lod2 );
-
-		// If Level2, render all
-		// If Level1, also render Level0
-		switch ( scene->lodLevel ) {
-		case Scene::Level2:
-			if ( lod2tris.count() )
-				glDrawElements( GL_TRIANGLES, lod2tris.count() * 3, GL_UNSIGNED_SHORT, lod2tris.constData() );
-		case Scene::Level1:
-			if ( lod1tris.count() )
-				glDrawElements( GL_TRIANGLES, lod1tris.count() * 3, GL_UNSIGNED_SHORT, lod1tris.constData() );
-		case Scene::Level0:
-		default:
-			if ( lod0tris.count() )
-				glDrawElements( GL_TRIANGLES, lod0tris.count() * 3, GL_UNSIGNED_SHORT, lod0tris.constData() );
-			break;
-		}
+		drawTriangles( 0, sortedTriangles.count() );
+	} else {
+		drawLodTriangles();
 	}
 
+	fn->glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
+
 	if ( !Node::SELECTING )
 		scene->renderer->stopProgram();
 
@@ -547,38 +559,38 @@ void BSShape::drawSelection() const
 
 	auto push = [this] ( const Transform & t ) {	
 		if ( transformRigid ) {
-			glPushMatrix();
-			glMultMatrix( t );
+			DebugDraw::pushMatrix();
+			DebugDraw::multMatrix( t );
 		}
 	};
 
 	auto pop = [this] () {
 		if ( transformRigid )
-			glPopMatrix();
+			DebugDraw::popMatrix();
 	};
 
 	push( viewTrans() );
 
-	glDepthFunc( GL_LEQUAL );
+	DebugDraw::depthFunc( GL_LEQUAL );
 
 	glDisable( GL_LIGHTING );
 	glDisable( GL_COLOR_MATERIAL );
 	glDisable( GL_TEXTURE_2D );
 	glDisable( GL_NORMALIZE );
-	glEnable( GL_DEPTH_TEST );
-	glDepthMask( GL_FALSE );
-	glEnable( GL_BLEND );
+	DebugDraw::enable( GL_DEPTH_TEST );
+	DebugDraw::depthMask( GL_FALSE );
+	DebugDraw::enable( GL_BLEND );
 	glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
 	glDisable( GL_ALPHA_TEST );
 
-	glDisable( GL_CULL_FACE );
+	DebugDraw::disable( GL_CULL_FACE );
 
 	// TODO: User Settings
 	GLfloat lineWidth = 1.5;
 	GLfloat pointSize = 5.0;
 
-	glLineWidth( lineWidth );
-	glPointSize( pointSize );
+	DebugDraw::lineWidth( lineWidth );
+	DebugDraw::pointSize( pointSize );
 
 	glNormalColor();
 
@@ -595,7 +607,7 @@ void BSShape::drawSelection() const
 
 	// Draw All Verts lambda
 	auto allv = [this]( float size ) {
-		glPointSize( size );
+		DebugDraw::pointSize( size );
 		glBegin( GL_POINTS );
 
 		for ( int j = 0; j < transVerts.count(); j++ )
@@ -607,7 +619,7 @@ void BSShape::drawSelection() const
 	if ( n == "Bounding Sphere" && !extraData ) {
 		auto sph = BoundSphere( nif, idx );
 		if ( sph.radius > 0.0 ) {
-			glColor4f( 1, 1, 1, 0.33 );
+			DebugDraw::color( Color4( 1, 1, 1, 0.33 ) );
 			drawSphereSimple( sph.center, sph.radius, 72 );
 		}
 	}
@@ -634,7 +646,7 @@ void BSShape::drawSelection() const
 		}
 
 		if ( !idxs.count() ) {
-			glPopMatrix();
+			DebugDraw::popMatrix();
 			return;
 		}
 
@@ -644,11 +656,11 @@ void BSShape::drawSelection() const
 		float pbvR = nif->get<float>( iBSphere.child( 1, 2 ) );
 
 		if ( pbvR > 0.0 ) {
-			glColor4f( 0, 1, 0, 0.33 );
+			DebugDraw::color( Color4( 0, 1, 0, 0.33 ) );
 			drawSphereSimple( pbvC, pbvR, 72 );
 		}
 
-		glPopMatrix();
+		DebugDraw::popMatrix();
 
 		for ( auto i : idxs ) {
 			// Transform compound
@@ -665,19 +677,19 @@ void BSShape::drawSelection() const
 			t.translation = bvC;
 			t.scale = scale;
 
-			glPushMatrix();
-			glMultMatrix( scene->view * t );
+			DebugDraw::pushMatrix();
+			DebugDraw::multMatrix( scene->view * t );
 
 			if ( bvR > 0.0 ) {
-				glColor4f( 1, 1, 1, 0.33 );
+				DebugDraw::color( Color4( 1, 1, 1, 0.33 ) );
 				drawSphereSimple( Vector3( 0, 0, 0 ), bvR, 72 );
 			}
 
-			glPopMatrix();
+			DebugDraw::popMatrix();
 		}
 
-		glPushMatrix();
-		glMultMatrix( viewTrans() );
+		DebugDraw::pushMatrix();
+		DebugDraw::multMatrix( viewTrans() );
 	}
 
 	if ( n == "Vertex Data" || n == "Vertex" || n == "Vertices" ) {
@@ -692,8 +704,8 @@ void BSShape::drawSelection() const
 		}
 
 		if ( s >= 0 ) {
-			glPointSize( 10 );
-			glDepthFunc( GL_ALWAYS );
+			DebugDraw::pointSize( 10 );
+			DebugDraw::depthFunc( GL_ALWAYS );
 			glHighlightColor();
 			glBegin( GL_POINTS );
 			glVertex( transVerts.value( s ) );
@@ -701,7 +713,7 @@ void BSShape::drawSelection() const
 		}
 	} 
 	
-	glPolygonMode( GL_FRONT_AND_BACK, GL_LINE );
+	DebugDraw::polygonMode( GL_LINE );
 
 	// Draw Lines lambda
 	auto lines = [this, &normalScale, &allv, &lineWidth]( const QVector<Vector3> & v ) {
@@ -720,16 +732,16 @@ void BSShape::drawSelection() const
 		glEnd();
 
 		if ( s >= 0 ) {
-			glDepthFunc( GL_ALWAYS );
+			DebugDraw::depthFunc( GL_ALWAYS );
 			glHighlightColor();
-			glLineWidth( 3.0 );
+			DebugDraw::lineWidth( 3.0 );
 			glBegin( GL_LINES );
 			glVertex( transVerts.value( s ) );
 			glVertex( transVerts.value( s ) + v.value( s ) * normalScale * 2 );
 			glVertex( transVerts.value( s ) );
 			glVertex( transVerts.value( s ) - v.value( s ) * normalScale / 2 );
 			glEnd();
-			glLineWidth( lineWidth );
+			DebugDraw::lineWidth( lineWidth );
 		}
 	};
 	
@@ -747,7 +759,7 @@ void BSShape::drawSelection() const
 	if ( n == "Triangles" ) {
 		int s = scene->currentIndex.row();
 		if ( s >= 0 ) {
-			glPolygonMode( GL_FRONT_AND_BACK, GL_FILL );
+			DebugDraw::polygonMode( GL_FILL );
 			glHighlightColor();
 
 			Triangle tri = triangles.value( s );
@@ -756,7 +768,7 @@ void BSShape::drawSelection() const
 			glVertex( transVerts.value( tri.v2() ) );
 			glVertex( transVerts.value( tri.v3() ) );
 			glEnd();
-			glPolygonMode( GL_FRONT_AND_BACK, GL_LINE );
+			DebugDraw::polygonMode( GL_LINE );
 		}
 	}
 
@@ -769,7 +781,7 @@ void BSShape::drawSelection() const
 								{ 0, 255, 255, 128 }, { 255, 0, 255, 128 }, { 255, 255, 255, 128 } 
 		};
 
-		glPolygonMode( GL_FRONT_AND_BACK, GL_FILL );
+		DebugDraw::polygonMode( GL_FILL );
 
 		auto type = idx.sibling( idx.row(), 1 ).data( Qt::DisplayRole ).toString();
 
@@ -821,7 +833,7 @@ void BSShape::drawSelection() const
 					if ( j >= maxTris )
 						continue;
 
-					glColor( Color4( cols.value( i % 7 ) ) );
+					DebugDraw::color( Color4( cols.value( i % 7 ) ) );
 					Triangle tri = triangles[j];
 					glBegin( GL_TRIANGLES );
 					glVertex( transVerts.value( tri.v1() ) );
@@ -833,7 +845,7 @@ void BSShape::drawSelection() const
 
 			// Sub-segmentless Segments
 			if ( numRec == 0 && cnt > 0 ) {
-				glColor( Color4( cols.value( (idx.row() + l) % 7 ) ) );
+				DebugDraw::color( Color4( cols.value( (idx.row() + l) % 7 ) ) );
 
 				for ( int i = off; i < cnt + off; i++ ) {
 					if ( i >= maxTris )
@@ -881,7 +893,7 @@ void BSShape::drawSelection() const
 
 	// General wireframe
 	if ( blk == iBlock && idx != iVertData && p != "Vertex Data" && p != "Vertices" ) {
-		glLineWidth( 1.6f );
+		DebugDraw::lineWidth( 1.6f );
 		glNormalColor();
 		for ( const Triangle& tri : triangles ) {
 			glBegin( GL_TRIANGLES );
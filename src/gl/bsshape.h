@@ -43,6 +43,8 @@ public:
 	QModelIndex vertexAt( int ) const override;
 
 protected:
+	//! Updates the bone palette for this frame
+	void updateBoneTransforms();
 
 	QPersistentModelIndex iVertData;
 	QPersistentModelIndex iTriData;
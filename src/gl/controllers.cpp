@@ -39,6 +39,9 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "gl/glscene.h"
 #include "model/nifmodel.h"
 
+#include <algorithm>
+#include <cmath>
+
 
 // `NiControllerManager` blocks
 
@@ -435,6 +438,9 @@ void MorphController::updateTime( float time )
 		}
 	}
 
+	// The morphed vertices change every frame
+	target->vertBuffer.invalidate( GL_STREAM_DRAW );
+	target->pickTree.invalidateVertices();
 	target->updateBounds = true;
 }
 
@@ -585,7 +591,7 @@ bool ParticleController::update( const NifModel * nif, const QModelIndex & index
 		grow = 0.0;
 		fade = 0.0;
 
-		list.clear();
+		list.resize( 0 );
 
 		QModelIndex iParticles = nif->getIndex( iBlock, "Particles" );
 
@@ -597,14 +603,18 @@ bool ParticleController::update( const NifModel * nif, const QModelIndex & index
 			//if ( iParticles.isValid() )
 			//{
 			for ( int p = 0; p < numValid && p < nif->rowCount( iParticles ); p++ ) {
-				Particle particle;
-				particle.velocity = nif->get<Vector3>( iParticles.child( p, 0 ), "Velocity" );
-				particle.lifetime = nif->get<float>( iParticles.child( p, 0 ), "Lifetime" );
-				particle.lifespan = nif->get<float>( iParticles.child( p, 0 ), "Lifespan" );
-				particle.lasttime = nif->get<float>( iParticles.child( p, 0 ), "Timestamp" );
-				particle.vertex = nif->get<int>( iParticles.child( p, 0 ), "Vertex ID" );
+				QModelIndex iParticle = iParticles.child( p, 0 );
+				Vector3 velocity = nif->get<Vector3>( iParticle, "Velocity" );
+
 				// Display saved particle start on initial load
-				list.append( particle );
+				int n = list.append();
+				list.vx[n] = velocity[0];
+				list.vy[n] = velocity[1];
+				list.vz[n] = velocity[2];
+				list.lifetime[n] = nif->get<float>( iParticle, "Lifetime" );
+				list.lifespan[n] = nif->get<float>( iParticle, "Lifespan" );
+				list.lasttime[n] = nif->get<float>( iParticle, "Timestamp" );
+				list.vertex[n] = nif->get<int>( iParticle, "Vertex ID" );
 			}
 
 			//}
@@ -647,6 +657,41 @@ bool ParticleController::update( const NifModel * nif, const QModelIndex & index
 	return false;
 }
 
+void ParticleController::ParticleArrays::resize( int n )
+{
+	x.resize( n );
+	y.resize( n );
+	z.resize( n );
+	vx.resize( n );
+	vy.resize( n );
+	vz.resize( n );
+	lifetime.resize( n );
+	lifespan.resize( n );
+	lasttime.resize( n );
+	vertex.resize( n );
+}
+
+int ParticleController::ParticleArrays::append()
+{
+	int n = count();
+	resize( n + 1 );
+	return n;
+}
+
+void ParticleController::ParticleArrays::copy( int from, int to )
+{
+	x[to] = x[from];
+	y[to] = y[from];
+	z[to] = z[from];
+	vx[to] = vx[from];
+	vy[to] = vy[from];
+	vz[to] = vz[from];
+	lifetime[to] = lifetime[from];
+	lifespan[to] = lifespan[from];
+	lasttime[to] = lasttime[from];
+	vertex[to] = vertex[from];
+}
+
 void ParticleController::updateTime( float time )
 {
 	if ( !(target && active) )
@@ -654,28 +699,40 @@ void ParticleController::updateTime( float time )
 
 	localtime = ctrlTime( time );
 
-	int n = 0;
-
-	while ( n < list.count() ) {
-		Particle & p = list[n];
-
-		float deltaTime = (localtime > p.lasttime ? localtime - p.lasttime : 0); //( stop - start ) - p.lasttime + localtime );
-
-		p.lifetime += deltaTime;
+	int count = list.count();
+	int vertCount = target->verts.count();
+	const Vector3 * verts = target->verts.constData();
 
-		if ( p.lifetime < p.lifespan && p.vertex < target->verts.count() ) {
-			p.position = target->verts[p.vertex];
+	steps.resize( count );
 
-			for ( int i = 0; i < 4; i++ )
-				moveParticle( p, deltaTime / 4 );
+	// Age the particles and compact the live ones to the front, keeping their order
+	int n = 0;
 
-			p.lasttime = localtime;
+	for ( int i = 0; i < count; i++ ) {
+		float deltaTime = (localtime > list.lasttime[i] ? localtime - list.lasttime[i] : 0); //( stop - start ) - p.lasttime + localtime );
+		float lifetime = list.lifetime[i] + deltaTime;
+		int vertex = list.vertex[i];
+
+		if ( lifetime < list.lifespan[i] && vertex >= 0 && vertex < vertCount ) {
+			if ( n != i )
+				list.copy( i, n );
+
+			list.lifetime[n] = lifetime;
+			list.lasttime[n] = localtime;
+			list.x[n] = verts[vertex][0];
+			list.y[n] = verts[vertex][1];
+			list.z[n] = verts[vertex][2];
+			steps[n] = deltaTime / 4;
 			n++;
-		} else {
-			list.remove( n );
 		}
 	}
 
+	list.resize( n );
+	steps.resize( n );
+
+	for ( int i = 0; i < 4; i++ )
+		moveParticles();
+
 	if ( emitNode && emitNode->isVisible() && localtime >= emitStart && localtime <= emitStop ) {
 		float emitDelta = (localtime > emitLast ? localtime - emitLast : 0);
 		emitLast = localtime;
@@ -687,90 +744,129 @@ void ParticleController::updateTime( float time )
 		if ( num > 0 ) {
 			emitAccu -= num;
 
-			while ( num-- > 0 && list.count() < target->verts.count() ) {
-				Particle p;
-				startParticle( p );
-				list.append( p );
-			}
+			while ( num-- > 0 && list.count() < vertCount )
+				startParticle( list.append() );
 		}
 	}
 
-	n = 0;
+	count = std::min( list.count(), vertCount );
 
-	while ( n < list.count() ) {
-		Particle & p = list[n];
-		p.vertex = n;
-		target->verts[n] = p.position;
+	Vector3 * out = target->verts.data();
 
-		if ( n < target->sizes.count() )
-			sizeParticle( p, target->sizes[n] );
+	for ( n = 0; n < count; n++ ) {
+		list.vertex[n] = n;
+		out[n] = Vector3( list.x[n], list.y[n], list.z[n] );
+	}
 
-		if ( n < target->colors.count() )
-			colorParticle( p, target->colors[n] );
+	sizeParticles( target->sizes.data(), std::min( count, target->sizes.count() ) );
 
-		n++;
+	if ( iColorKeys.isValid() ) {
+		int colorCount = std::min( count, target->colors.count() );
+
+		for ( n = 0; n < colorCount; n++ ) {
+			int i = 0;
+			interpolate( target->colors[n], iColorKeys, list.lifetime[n] / list.lifespan[n], i );
+		}
 	}
 
 	target->active = list.count();
 	target->size = size;
 }
 
-void ParticleController::startParticle( Particle & p )
+void ParticleController::startParticle( int n )
 {
-	p.position = random( emitRadius * 2 ) - emitRadius;
-	p.position += target->worldTrans().rotation.inverted() * (emitNode->worldTrans().translation - target->worldTrans().translation);
+	Vector3 position = random( emitRadius * 2 ) - emitRadius;
+	position += target->worldTrans().rotation.inverted() * (emitNode->worldTrans().translation - target->worldTrans().translation);
 
 	float i = inc + random( incRnd );
 	float d = dec + random( decRnd );
 
-	p.velocity = Vector3( rand() & 1 ? sin( i ) : -sin( i ), 0, cos( i ) );
+	Vector3 velocity = Vector3( rand() & 1 ? sin( i ) : -sin( i ), 0, cos( i ) );
 
 	Matrix m; m.fromEuler( 0, 0, rand() & 1 ? d : -d );
-	p.velocity = m * p.velocity;
-
-	p.velocity = p.velocity * (spd + random( spdRnd ));
-	p.velocity = target->worldTrans().rotation.inverted() * emitNode->worldTrans().rotation * p.velocity;
-
-	p.lifetime = 0;
-	p.lifespan = ttl + random( ttlRnd );
-	p.lasttime = localtime;
+	velocity = m * velocity;
+
+	velocity = velocity * (spd + random( spdRnd ));
+	velocity = target->worldTrans().rotation.inverted() * emitNode->worldTrans().rotation * velocity;
+
+	list.x[n] = position[0];
+	list.y[n] = position[1];
+	list.z[n] = position[2];
+	list.vx[n] = velocity[0];
+	list.vy[n] = velocity[1];
+	list.vz[n] = velocity[2];
+	list.lifetime[n] = 0;
+	list.lifespan[n] = ttl + random( ttlRnd );
+	list.lasttime[n] = localtime;
 }
 
-void ParticleController::moveParticle( Particle & p, float deltaTime )
+void ParticleController::moveParticles()
 {
-	for ( Gravity g : grav ) {
+	// Plain loops over the arrays, which the compiler can vectorize
+	int count = list.count();
+	float * x = list.x.data();
+	float * y = list.y.data();
+	float * z = list.z.data();
+	float * vx = list.vx.data();
+	float * vy = list.vy.data();
+	float * vz = list.vz.data();
+	const float * dt = steps.constData();
+
+	for ( const Gravity & g : grav ) {
 		switch ( g.type ) {
 		case 0:
-			p.velocity += g.direction * (g.force * deltaTime);
-			break;
+		{
+			float gx = g.direction[0] * g.force;
+			float gy = g.direction[1] * g.force;
+			float gz = g.direction[2] * g.force;
+
+			for ( int i = 0; i < count; i++ ) {
+				vx[i] += gx * dt[i];
+				vy[i] += gy * dt[i];
+				vz[i] += gz * dt[i];
+			}
+		}
+		break;
 		case 1:
 		{
-			Vector3 dir = (g.position - p.position);
-			dir.normalize();
-			p.velocity += dir * (g.force * deltaTime);
+			for ( int i = 0; i < count; i++ ) {
+				float dx = g.position[0] - x[i];
+				float dy = g.position[1] - y[i];
+				float dz = g.position[2] - z[i];
+				float len = std::sqrt( dx * dx + dy * dy + dz * dz );
+				float f = (len > 0) ? g.force * dt[i] / len : 0;
+
+				vx[i] += dx * f;
+				vy[i] += dy * f;
+				vz[i] += dz * f;
+			}
 		}
 		break;
 		}
 	}
-	p.position += p.velocity * deltaTime;
+
+	for ( int i = 0; i < count; i++ ) {
+		x[i] += vx[i] * dt[i];
+		y[i] += vy[i] * dt[i];
+		z[i] += vz[i] * dt[i];
+	}
 }
 
-void ParticleController::sizeParticle( Particle & p, float & sz )
+void ParticleController::sizeParticles( float * sizes, int count ) const
 {
-	sz = 1.0;
+	const float * lifetime = list.lifetime.constData();
+	const float * lifespan = list.lifespan.constData();
 
-	if ( grow > 0 && p.lifetime < grow )
-		sz *= p.lifetime / grow;
+	for ( int i = 0; i < count; i++ ) {
+		float sz = 1.0;
 
-	if ( fade > 0 && p.lifespan - p.lifetime < fade )
-		sz *= (p.lifespan - p.lifetime) / fade;
-}
+		if ( grow > 0 && lifetime[i] < grow )
+			sz *= lifetime[i] / grow;
 
-void ParticleController::colorParticle( Particle & p, Color4 & color )
-{
-	if ( iColorKeys.isValid() ) {
-		int i = 0;
-		interpolate( color, iColorKeys, p.lifetime / p.lifespan, i );
+		if ( fade > 0 && lifespan[i] - lifetime[i] < fade )
+			sz *= (lifespan[i] - lifetime[i]) / fade;
+
+		sizes[i] = sz;
 	}
 }
 
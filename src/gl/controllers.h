@@ -182,22 +182,29 @@ class Particles;
 //! Controller for `NiParticleSystemController` and other blocks
 class ParticleController final : public Controller
 {
-	struct Particle
+	//! Particle state as a structure of arrays, entry n of each array belongs to the nth particle
+	struct ParticleArrays
 	{
-		Vector3 position;
-		Vector3 velocity;
-		Vector3 unknown;
-		float lifetime = 0;
-		float lifespan = 0;
-		float lasttime = 0;
-		short y = 0;
-		short vertex = 0;
-
-		Particle()
-		{
-		}
+		QVector<float> x, y, z;
+		QVector<float> vx, vy, vz;
+		QVector<float> lifetime;
+		QVector<float> lifespan;
+		QVector<float> lasttime;
+		QVector<int> vertex;
+
+		int count() const { return lifetime.count(); }
+
+		//! Resizes every array, new particles start zeroed
+		void resize( int n );
+		//! Appends a zeroed particle and returns its index
+		int append();
+		//! Copies particle @p from over particle @p to
+		void copy( int from, int to );
 	};
-	QVector<Particle> list;
+	ParticleArrays list;
+	//! Time step of each particle for one of the integration steps of this frame
+	QVector<float> steps;
+
 	struct Gravity
 	{
 		float force;
@@ -235,13 +242,14 @@ public:
 
 	void updateTime( float time ) override final;
 
-	void startParticle( Particle & p );
-
-	void moveParticle( Particle & p, float deltaTime );
+	//! Emits particle @p n from the emitter node
+	void startParticle( int n );
 
-	void sizeParticle( Particle & p, float & size );
+	//! Applies gravity to all particles and moves them over one integration step
+	void moveParticles();
 
-	void colorParticle( Particle & p, Color4 & color );
+	//! Scales the sizes of the particles by their grow and fade times
+	void sizeParticles( float * sizes, int count ) const;
 };
 
 
@@ -147,7 +147,9 @@ void IControllable::update( const NifModel * nif, const QModelIndex & i )
 
 void IControllable::transform()
 {
-	if ( scene->animate ) {
+	if ( scene->animate && !controllers.isEmpty() ) {
+		FrameProfiler::Scope scope( scene->profiler, FrameProfiler::Controllers );
+
 		for ( Controller * controller : controllers ) {
 			controller->updateTime( scene->time );
 		}
@@ -32,15 +32,79 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "glmarker.h"
 
+#include "gl/gltools.h"
+
 #include <QOpenGLContext>
+#include <QOpenGLFunctions>
+
 
-void drawMarker( const GLMarker * marker )
+void MarkerBuffers::draw( QOpenGLFunctions * fn, const GLMarker * marker )
 {
-	glEnableClientState( GL_VERTEX_ARRAY );
+	bind( fn, marker );
+
+	glDrawElements( GL_TRIANGLES, marker->nf * 3, GL_UNSIGNED_SHORT, nullptr );
+
+	unbind( fn );
+}
+
+void MarkerBuffers::draw( QOpenGLFunctions * fn, const GLMarker * marker, const QVector<MarkerInstance> & instances )
+{
+	if ( instances.isEmpty() )
+		return;
+
+	bind( fn, marker );
+
+	for ( const MarkerInstance & instance : instances ) {
+		glPushMatrix();
+		glMultMatrix( instance.transform );
+		glScale( instance.scale );
+
+		glDrawElements( GL_TRIANGLES, marker->nf * 3, GL_UNSIGNED_SHORT, nullptr );
+
+		glPopMatrix();
+	}
+
+	unbind( fn );
+}
+
+void MarkerBuffers::release( QOpenGLFunctions * fn )
+{
+	for ( const Mesh & mesh : meshes ) {
+		fn->glDeleteBuffers( 1, &mesh.verts );
+		fn->glDeleteBuffers( 1, &mesh.faces );
+	}
+
+	meshes.clear();
+}
+
+void MarkerBuffers::bind( QOpenGLFunctions * fn, const GLMarker * marker )
+{
+	auto it = meshes.find( marker );
+	if ( it == meshes.end() ) {
+		Mesh mesh;
 
-	glVertexPointer( 3, GL_FLOAT, 0, marker->verts );
+		fn->glGenBuffers( 1, &mesh.verts );
+		fn->glBindBuffer( GL_ARRAY_BUFFER, mesh.verts );
+		fn->glBufferData( GL_ARRAY_BUFFER, marker->nv * 3 * sizeof(float), marker->verts, GL_STATIC_DRAW );
 
-	glDrawElements( GL_TRIANGLES, marker->nf * 3, GL_UNSIGNED_SHORT, marker->faces );
+		fn->glGenBuffers( 1, &mesh.faces );
+		fn->glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, mesh.faces );
+		fn->glBufferData( GL_ELEMENT_ARRAY_BUFFER, marker->nf * 3 * sizeof(unsigned short), marker->faces, GL_STATIC_DRAW );
 
+		it = meshes.insert( marker, mesh );
+	} else {
+		fn->glBindBuffer( GL_ARRAY_BUFFER, it->verts );
+		fn->glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, it->faces );
+	}
+
+	glEnableClientState( GL_VERTEX_ARRAY );
+	glVertexPointer( 3, GL_FLOAT, 0, nullptr );
+}
+
+void MarkerBuffers::unbind( QOpenGLFunctions * fn )
+{
 	glDisableClientState( GL_VERTEX_ARRAY );
+
+	fn->glBindBuffer( GL_ARRAY_BUFFER, 0 );
+	fn->glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
 }
@@ -33,6 +33,14 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #ifndef GLMARKER_H
 #define GLMARKER_H
 
+#include "data/niftypes.h"
+
+#include <QHash>
+#include <QVector>
+
+
+class QOpenGLFunctions;
+
 struct GLMarker
 {
 	int nv;
@@ -41,6 +49,41 @@ struct GLMarker
 	const unsigned short * faces;
 };
 
-void drawMarker( const GLMarker * marker );
+//! Placement of one copy of a marker
+struct MarkerInstance
+{
+	Transform transform;
+	Vector3 scale = Vector3( 1, 1, 1 );
+};
+
+/*! The marker meshes of one GL context
+ *
+ * Each marker is uploaded into a vertex and an index buffer the first time it is drawn
+ * and kept until release(), so drawing a marker only binds its buffers.
+ */
+class MarkerBuffers final
+{
+public:
+	//! Draws a marker with the current matrices
+	void draw( QOpenGLFunctions * fn, const GLMarker * marker );
+	//! Draws a marker once per instance, binding its buffers once
+	void draw( QOpenGLFunctions * fn, const GLMarker * marker, const QVector<MarkerInstance> & instances );
+	//! Deletes the buffers of all markers
+	void release( QOpenGLFunctions * fn );
+
+private:
+	struct Mesh
+	{
+		unsigned int verts = 0;
+		unsigned int faces = 0;
+	};
+
+	//! Binds the buffers of a marker, uploading it first if needed
+	void bind( QOpenGLFunctions * fn, const GLMarker * marker );
+	//! Unbinds the buffers
+	void unbind( QOpenGLFunctions * fn );
+
+	QHash<const GLMarker *, Mesh> meshes;
+};
 
 #endif
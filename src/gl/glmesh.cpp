@@ -45,6 +45,8 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <QOpenGLFunctions>
 
+#include <algorithm>
+
 
 //! @file glmesh.cpp Scene management for visible meshes such as NiTriShapes.
 
@@ -81,6 +83,7 @@ void Mesh::clear()
 	weights.clear();
 	partitions.clear();
 	sortedTriangles.clear();
+	lodSource.clear();
 	indices.clear();
 	transVerts.clear();
 	transNorms.clear();
@@ -88,6 +91,11 @@ void Mesh::clear()
 	transTangents.clear();
 	transBitangents.clear();
 
+	releaseBuffers();
+
+	pickTriangles.clear();
+	pickTree.clear();
+
 	isLOD = false;
 	isDoubleSided = false;
 }
@@ -187,12 +195,449 @@ void Shape::boneSphere( const NifModel * nif, const QModelIndex & index ) const
 
 	auto bSphere = BoundSphere( nif, nif->getIndex( index, "Bounding Sphere" ) );
 	if ( bSphere.radius > 0.0 ) {
-		glColor4f( 1, 1, 1, 0.33 );
+		DebugDraw::color( Color4( 1, 1, 1, 0.33 ) );
 		auto pos = boneT.rotation.inverted() * (bSphere.center - boneT.translation);
 		drawSphereSimple( t * pos, bSphere.radius, 36 );
 	}
 }
 
+bool Shape::bindCoords( int set )
+{
+	if ( set < 0 || set >= coords.count() )
+		return false;
+
+	if ( coordBuffers.count() < coords.count() )
+		coordBuffers.resize( coords.count() );
+
+	auto fn = scene->renderer->fn;
+	if ( !coordBuffers[set].bind( fn, coords.at( set ) ) )
+		return false;
+
+	glEnableClientState( GL_TEXTURE_COORD_ARRAY );
+	glTexCoordPointer( 2, GL_FLOAT, 0, nullptr );
+	fn->glBindBuffer( GL_ARRAY_BUFFER, 0 );
+	return true;
+}
+
+bool Shape::bindTangents()
+{
+	auto fn = scene->renderer->fn;
+	if ( !tangentBuffer.bind( fn, (transTangents.count()) ? transTangents : tangents ) )
+		return false;
+
+	glEnableClientState( GL_TEXTURE_COORD_ARRAY );
+	glTexCoordPointer( 3, GL_FLOAT, 0, nullptr );
+	fn->glBindBuffer( GL_ARRAY_BUFFER, 0 );
+	return true;
+}
+
+bool Shape::bindBitangents()
+{
+	auto fn = scene->renderer->fn;
+	if ( !bitangentBuffer.bind( fn, (transBitangents.count()) ? transBitangents : bitangents ) )
+		return false;
+
+	glEnableClientState( GL_TEXTURE_COORD_ARRAY );
+	glTexCoordPointer( 3, GL_FLOAT, 0, nullptr );
+	fn->glBindBuffer( GL_ARRAY_BUFFER, 0 );
+	return true;
+}
+
+bool Shape::bindBoneIndices()
+{
+	auto fn = scene->renderer->fn;
+	if ( !boneIndexBuffer.bind( fn, boneIndices ) )
+		return false;
+
+	glEnableClientState( GL_TEXTURE_COORD_ARRAY );
+	glTexCoordPointer( 4, GL_FLOAT, 0, nullptr );
+	fn->glBindBuffer( GL_ARRAY_BUFFER, 0 );
+	return true;
+}
+
+bool Shape::bindBoneWeights()
+{
+	auto fn = scene->renderer->fn;
+	if ( !boneWeightBuffer.bind( fn, boneWeights ) )
+		return false;
+
+	glEnableClientState( GL_TEXTURE_COORD_ARRAY );
+	glTexCoordPointer( 4, GL_FLOAT, 0, nullptr );
+	fn->glBindBuffer( GL_ARRAY_BUFFER, 0 );
+	return true;
+}
+
+bool Shape::gpuSkinningAvailable() const
+{
+	if ( !gpuSkinnable || (scene->options & Scene::DisableShaders) || (scene->visMode & Scene::VisSilhouette) )
+		return false;
+
+	// Vertex selection and the selection highlights read the skinned vertices
+	if ( scene->selMode & Scene::SelVertex )
+		return false;
+
+	auto blk = scene->currentBlock;
+	if ( blk == iBlock || blk == iData || blk == iSkin || blk == iSkinData || blk == iSkinPart )
+		return false;
+
+	return scene->renderer->isSkinningProgram( shader );
+}
+
+void Shape::updateBoneNodes( int rootId )
+{
+	if ( boneRevision == scene->nodeRevision() && boneNodes.count() == bones.count() )
+		return;
+
+	boneRevision = scene->nodeRevision();
+
+	// Same result as root->findChild() on every bone, without searching the subtree
+	Node * root = findParent( rootId );
+	boneNodes.fill( nullptr, bones.count() );
+	for ( int b = 0; b < bones.count() && root; b++ ) {
+		Node * bone = scene->findNode( bones[b] );
+		if ( bone && bone->findParent( rootId ) == root )
+			boneNodes[b] = bone;
+	}
+}
+
+void Shape::skinOnGpu()
+{
+	useBindPose();
+
+	// Every skinned vertex is a weighted average of its bind pose position
+	//	transformed by its bones, so it lies within the bounds of the transformed bind pose
+	boundSphere = skin.bounds( bindSphere );
+	boundSphere.applyInv( viewTrans() );
+	updateBounds = false;
+}
+
+void Shape::skinVertices()
+{
+	FrameProfiler::Scope scope( scene->profiler, FrameProfiler::Skinning );
+
+	skin.skin( verts, norms, tangents, bitangents, transVerts, transNorms, transTangents, transBitangents );
+
+	// The skinned arrays change every frame
+	vertBuffer.invalidate( GL_STREAM_DRAW );
+	normBuffer.invalidate( GL_STREAM_DRAW );
+	tangentBuffer.invalidate( GL_STREAM_DRAW );
+	bitangentBuffer.invalidate( GL_STREAM_DRAW );
+	cpuSkinned = true;
+	pickTree.invalidateVertices();
+
+	boundSphere = BoundSphere( transVerts );
+	boundSphere.applyInv( viewTrans() );
+	updateBounds = false;
+}
+
+void Shape::useBindPose()
+{
+	transVerts = verts;
+	transNorms = norms;
+	transTangents = tangents;
+	transBitangents = bitangents;
+
+	// The buffers and the picking boxes still hold the vertices skinned last frame
+	if ( cpuSkinned ) {
+		vertBuffer.invalidate();
+		normBuffer.invalidate();
+		tangentBuffer.invalidate();
+		bitangentBuffer.invalidate();
+		pickTree.invalidateVertices();
+		cpuSkinned = false;
+	}
+}
+
+void Shape::setColorAlpha( float alpha )
+{
+	if ( alpha != colorAlpha ) {
+		colorBuffer.invalidate();
+		colorAlpha = alpha;
+	}
+}
+
+/*! Sorts triangles back to front as seen from @p eye
+ *
+ * The squared distances of the triangle centers are quantized to 16 bits and
+ * sorted with two 8 bit counting passes.
+ */
+static void sortTrianglesByDepth( const QVector<Triangle> & tris, const QVector<Vector3> & verts,
+								  const Vector3 & eye, QVector<Triangle> & out )
+{
+	int n = tris.count();
+	int vcnt = verts.count();
+
+	QVector<float> dist( n );
+	float lo = FLT_MAX, hi = 0.0f;
+	for ( int t = 0; t < n; t++ ) {
+		const Triangle & tri = tris[t];
+		if ( tri[0] >= vcnt || tri[1] >= vcnt || tri[2] >= vcnt )
+			continue;
+
+		Vector3 c = (verts[tri[0]] + verts[tri[1]] + verts[tri[2]]) / 3.0;
+		dist[t] = (c - eye).squaredLength();
+		lo = std::min( lo, dist[t] );
+		hi = std::max( hi, dist[t] );
+	}
+
+	// Farthest first
+	float scale = (hi > lo) ? 65535.0f / (hi - lo) : 0.0f;
+	QVector<quint16> keys( n );
+	for ( int t = 0; t < n; t++ )
+		keys[t] = quint16( (hi - std::max( dist[t], lo )) * scale );
+
+	QVector<int> order( n ), temp( n );
+	for ( int t = 0; t < n; t++ )
+		order[t] = t;
+
+	for ( int shift = 0; shift < 16; shift += 8 ) {
+		int count[257] = {};
+		for ( int t = 0; t < n; t++ )
+			count[((keys[order[t]] >> shift) & 0xFF) + 1]++;
+		for ( int b = 0; b < 256; b++ )
+			count[b + 1] += count[b];
+		for ( int t = 0; t < n; t++ )
+			temp[count[(keys[order[t]] >> shift) & 0xFF]++] = order[t];
+
+		order.swap( temp );
+	}
+
+	out.resize( n );
+	for ( int t = 0; t < n; t++ )
+		out[t] = tris[order[t]];
+}
+
+void Shape::updateSortedTriangles()
+{
+	// Picking does not depend on the order, so keep the sort of the last frame
+	if ( Node::SELECTING ) {
+		if ( sortedTriangles.constData() != triangles.constData() && sortSource.constData() != triangles.constData() ) {
+			// Reloaded data comes with invalidated buffers; only a sort of old data is left to drop
+			if ( !sortSource.isEmpty() )
+				triangleBuffer.invalidate();
+
+			sortedTriangles = triangles;
+			sortSource.clear();
+			sortVerts.clear();
+		}
+		return;
+	}
+
+	AlphaProperty * aprop = findProperty<AlphaProperty>();
+
+	// Skinned vertices are in view space and change every frame; LOD ranges depend on the triangle order
+	bool depthSort = aprop && aprop->blend() && aprop->sort() && transformRigid && !isLOD
+		&& (scene->options & Scene::DoBlending) && triangles.count() > 1
+		&& viewTrans().scale != 0.0f;
+
+	if ( !depthSort ) {
+		// The index buffer holds the sorted triangles, or already the data triangles
+		if ( !sortSource.isEmpty() )
+			triangleBuffer.invalidate();
+
+		sortedTriangles = triangles;
+		sortSource.clear();
+		sortVerts.clear();
+		return;
+	}
+
+	const Transform & vt = viewTrans();
+	Vector3 eye = vt.rotation.inverted() * (Vector3() - vt.translation) / vt.scale;
+
+	// Sort again only if the data changed or the eye moved by more than 2% of its distance
+	if ( sortSource.constData() == triangles.constData() && sortVerts.constData() == transVerts.constData()
+		 && (eye - sortEye).length() <= 0.02f * sortDistance )
+		return;
+
+	if ( sortVerts.constData() != transVerts.constData() )
+		sortCenter = BoundSphere( transVerts ).center;
+
+	sortSource = triangles;
+	sortVerts = transVerts;
+	sortEye = eye;
+	sortDistance = (eye - sortCenter).length();
+
+	FrameProfiler::Scope scope( scene->profiler, FrameProfiler::Sorting );
+	sortTrianglesByDepth( triangles, transVerts, eye, sortedTriangles );
+	triangleBuffer.invalidate( GL_DYNAMIC_DRAW );
+}
+
+void Shape::drawTriangles( int start, int count, int minVertex, int maxVertex )
+{
+	// Same clamping as QVector::mid()
+	if ( start < 0 || start >= sortedTriangles.count() )
+		return;
+
+	count = std::min( count, sortedTriangles.count() - start );
+	if ( count <= 0 || !triangleBuffer.bind( scene->renderer->fn, sortedTriangles ) )
+		return;
+
+	auto offset = (const GLvoid *)(start * sizeof(Triangle));
+	if ( maxVertex >= minVertex && scene->renderer->drawRangeElements )
+		scene->renderer->drawRangeElements( GL_TRIANGLES, minVertex, maxVertex, count * 3, GL_UNSIGNED_SHORT, offset );
+	else
+		glDrawElements( GL_TRIANGLES, count * 3, GL_UNSIGNED_SHORT, offset );
+
+	scene->profiler.count( FrameProfiler::DrawCalls );
+	scene->profiler.count( FrameProfiler::Vertices, count * 3 );
+}
+
+void Shape::updateLodSizes( const NifModel * nif )
+{
+	lodSizes[0] = nif->get<uint>( iBlock, "LOD0 Size" );
+	lodSizes[1] = nif->get<uint>( iBlock, "LOD1 Size" );
+	lodSizes[2] = nif->get<uint>( iBlock, "LOD2 Size" );
+	lodSource.clear();
+}
+
+void Shape::drawLodTriangles()
+{
+	if ( lodSource.constData() != sortedTriangles.constData() ) {
+		lodSource = sortedTriangles;
+
+		// The levels are consecutive ranges; each level also draws the ones before it
+		int end = 0;
+		int minVertex = 0xFFFF;
+		int maxVertex = -1;
+		for ( int level = 0; level < 3; level++ ) {
+			int levelEnd = std::min( end + std::max( lodSizes[level], 0 ), lodSource.count() );
+
+			for ( ; end < levelEnd; end++ ) {
+				const Triangle & t = lodSource.at( end );
+				for ( int v = 0; v < 3; v++ ) {
+					minVertex = std::min<int>( minVertex, t[v] );
+					maxVertex = std::max<int>( maxVertex, t[v] );
+				}
+			}
+
+			lodRanges[level] = { end, minVertex, maxVertex };
+		}
+	}
+
+	int level = qBound( 0, int( scene->lodLevel ), 2 );
+	const LodRange & range = lodRanges[level];
+
+	drawTriangles( 0, range.count, range.minVertex, range.maxVertex );
+}
+
+bool Shape::castRay( const Vector3 & origin, const Vector3 & dir, float & distance, int & triangle, int & vertex )
+{
+	// Positions skinned by the shader program are not known on the CPU
+	if ( gpuSkinned ) {
+		gpuSkinned = false;
+		skinVertices();
+	}
+
+	// Rigid vertices are in shape space, skinned ones in eye space
+	Vector3 o = origin;
+	Vector3 d = dir;
+	if ( transformRigid ) {
+		Transform t = viewTrans();
+		if ( t.scale == 0.0f )
+			return false;
+
+		Matrix r = t.rotation.inverted();
+		o = r * ( origin - t.translation ) / t.scale;
+		d = r * dir / t.scale;
+	}
+
+	if ( pickTriangles.isEmpty() ) {
+		pickTriangles = triangles;
+
+		for ( const TriStrip & strip : tristrips ) {
+			for ( int i = 2; i < strip.count(); i++ ) {
+				quint16 a = strip[i - 2];
+				quint16 b = strip[i - 1];
+				quint16 c = strip[i];
+				if ( a == b || b == c || a == c )
+					continue;
+
+				if ( i & 1 )
+					pickTriangles.append( Triangle( a, c, b ) );
+				else
+					pickTriangles.append( Triangle( a, b, c ) );
+			}
+		}
+
+		pickTree.invalidate();
+	}
+
+	pickTree.update( transVerts, pickTriangles );
+
+	int hit = pickTree.intersect( transVerts, pickTriangles, o, d, distance );
+	if ( hit < 0 )
+		return false;
+
+	vertex = TriangleTree::nearestVertex( transVerts, pickTriangles.at( hit ), o + d * distance );
+	triangle = hit;
+	return true;
+}
+
+void Shape::useGeometry( const SharedGeometry & shared )
+{
+	releaseBuffers();
+
+	verts = shared.verts;
+	norms = shared.norms;
+	colors = shared.colors;
+	tangents = shared.tangents;
+	bitangents = shared.bitangents;
+	coords = shared.coords;
+	triangles = shared.triangles;
+	tristrips = shared.tristrips;
+	hasVertexColors = shared.hasVertexColors;
+
+	vertBuffer = shared.vertBuffer;
+	normBuffer = shared.normBuffer;
+	colorBuffer = shared.colorBuffer;
+	tangentBuffer = shared.tangentBuffer;
+	bitangentBuffer = shared.bitangentBuffer;
+	coordBuffers = shared.coordBuffers;
+	triangleBuffer = shared.triangleBuffer;
+}
+
+void Shape::releaseBuffers()
+{
+	auto fn = scene->renderer->fn;
+
+	vertBuffer.release( fn );
+	normBuffer.release( fn );
+	colorBuffer.release( fn );
+	tangentBuffer.release( fn );
+	bitangentBuffer.release( fn );
+	for ( auto & b : coordBuffers )
+		b.release( fn );
+	coordBuffers.clear();
+	boneIndexBuffer.release( fn );
+	boneWeightBuffer.release( fn );
+	triangleBuffer.release( fn );
+	stripBuffer.release( fn );
+	stripSource.clear();
+	stripPoints.clear();
+	cpuSkinned = false;
+	colorAlpha = 1.0f;
+}
+
+void Shape::invalidateBuffers()
+{
+	vertBuffer.invalidate();
+	normBuffer.invalidate();
+	colorBuffer.invalidate();
+	tangentBuffer.invalidate();
+	bitangentBuffer.invalidate();
+	for ( auto & b : coordBuffers )
+		b.invalidate();
+	triangleBuffer.invalidate();
+	stripBuffer.invalidate();
+	stripSource.clear();
+	sortSource.clear();
+	sortVerts.clear();
+	colorAlpha = 1.0f;
+
+	pickTriangles.clear();
+	pickTree.invalidate();
+}
+
 void Mesh::update( const NifModel * nif, const QModelIndex & index )
 {
 	Shape::update( nif, index );
@@ -208,8 +653,10 @@ void Mesh::update( const NifModel * nif, const QModelIndex & index )
 		return;
 
 	isLOD = nif->isNiBlock( iBlock, "BSLODTriShape" );
-	if ( isLOD )
+	if ( isLOD ) {
+		updateLodSizes( nif );
 		emit nif->lodSliderChanged( true );
+	}
 
 	updateData |= ( iData == index ) || ( iTangentData == index );
 	updateSkin |= ( iSkin == index );
@@ -224,7 +671,10 @@ void Mesh::update( const NifModel * nif, const QModelIndex & index )
 	isDoubleSided = false;
 
 	// Update shader from this mesh's shader property
-	if ( nif->checkVersion( 0x14020007, 0 ) && nif->inherits( iBlock, "NiTriBasedGeom" ) )
+	//	Only changes to blocks the program conditions read reset the selected program
+	bool shaderInput = index.isValid() && (iBlock == index || iData == index
+		|| nif->inherits( index, "NiProperty" ) || nif->inherits( index, "BSShaderTextureSet" ));
+	if ( shaderInput && nif->checkVersion( 0x14020007, 0 ) && nif->inherits( iBlock, "NiTriBasedGeom" ) )
 		updateShaderProperties( nif );
 
 	if ( iBlock == index ) {
@@ -314,9 +764,13 @@ void Mesh::transform()
 		nifVersion = nif->getUserVersion2();
 		updateData = false;
 
+		// Shared geometry brings buffers of its own
+		invalidateBuffers();
+
+		bool isNiMesh = nif->checkVersion( 0x14050000, 0 ) && nif->inherits( iBlock, "NiMesh" );
 
 		// NiMesh Rendering
-		if ( nif->checkVersion( 0x14050000, 0 ) && nif->inherits( iBlock, "NiMesh" ) ) {
+		if ( isNiMesh ) {
 			verts.clear();
 			norms.clear();
 			tangents.clear();
@@ -651,6 +1105,9 @@ void Mesh::transform()
 				);
 				break;
 			}
+		} else if ( const SharedGeometry * shared = scene->findGeometry( nif->getBlockNumber( iData ) ) ) {
+			// Another shape linking to the data block loaded it since it last changed
+			useGeometry( *shared );
 		} else {
 
 			verts  = nif->getArray<Vector3>( iData, "Vertices" );
@@ -664,11 +1121,6 @@ void Mesh::transform()
 				hasVertexColors = false;
 			}
 
-			if ( isVertexAlphaAnimation ) {
-				for ( int i = 0; i < colors.count(); i++ )
-					colors[i].setRGBA( colors[i].red(), colors[i].green(), colors[i].blue(), 1 );
-			}
-
 			tangents   = nif->getArray<Vector3>( iData, "Tangents" );
 			bitangents = nif->getArray<Vector3>( iData, "Bitangents" );
 
@@ -750,6 +1202,28 @@ void Mesh::transform()
 				tristrips.clear();
 			}
 
+			SharedGeometry loaded;
+			loaded.verts = verts;
+			loaded.norms = norms;
+			loaded.colors = colors;
+			loaded.tangents = tangents;
+			loaded.bitangents = bitangents;
+			loaded.coords = coords;
+			loaded.triangles = triangles;
+			loaded.tristrips = tristrips;
+			loaded.hasVertexColors = hasVertexColors;
+
+			useGeometry( *scene->addGeometry( nif->getBlockNumber( iData ), loaded ) );
+		}
+
+		if ( !isNiMesh ) {
+			if ( isVertexAlphaAnimation ) {
+				for ( int i = 0; i < colors.count(); i++ )
+					colors[i].setRGBA( colors[i].red(), colors[i].green(), colors[i].blue(), 1 );
+
+				colorBuffer.invalidate();
+			}
+
 			QModelIndex iExtraData = nif->getIndex( iBlock, "Extra Data List" );
 
 			if ( iExtraData.isValid() ) {
@@ -770,6 +1244,9 @@ void Mesh::transform()
 
 							for ( int c = 0; c < verts.count(); c++ )
 								bitangents[c] = *t++;
+
+							tangentBuffer.invalidate();
+							bitangentBuffer.invalidate();
 						}
 					}
 				}
@@ -829,145 +1306,149 @@ void Mesh::transform()
 		}
 
 		isSkinned = weights.count() || partitions.count();
+		boneRevision = -1;
 
+		updateSkinWeights();
 	}
 
 	Node::transform();
 }
 
-void Mesh::transformShapes()
+void Mesh::updateSkinWeights()
 {
-	if ( isHidden() )
-		return;
+	int vcnt = verts.count();
 
-	Node::transformShapes();
+	bindSphere = BoundSphere( verts );
 
-	transformRigid = true;
+	if ( partitions.count() ) {
+		int width = 0;
+		for ( const SkinPartition & part : partitions )
+			width = std::max( width, part.numWeightsPerVertex );
 
-	if ( isSkinned && doSkinning ) {
-		transformRigid = false;
-
-		int vcnt = verts.count();
-		int ncnt = norms.count();
-		int tcnt = tangents.count();
-		int bcnt = bitangents.count();
-
-		transVerts.resize( vcnt );
-		transVerts.fill( Vector3() );
-		transNorms.resize( vcnt );
-		transNorms.fill( Vector3() );
-		transTangents.resize( vcnt );
-		transTangents.fill( Vector3() );
-		transBitangents.resize( vcnt );
-		transBitangents.fill( Vector3() );
-
-		Node * root = findParent( skeletonRoot );
-
-		if ( partitions.count() ) {
-			for ( const SkinPartition& part : partitions ) {
-				QVector<Transform> boneTrans( part.boneMap.count() );
+		skin.resetInfluences( vcnt, width );
 
-				for ( int t = 0; t < boneTrans.count(); t++ ) {
-					Node * bone = root ? root->findChild( bones.value( part.boneMap[t] ) ) : 0;
-					boneTrans[ t ] = scene->view;
+		// Vertices shared by several partitions are skinned by the first one
+		QVector<bool> done( vcnt, false );
+		for ( const SkinPartition & part : partitions ) {
+			for ( int v = 0; v < part.vertexMap.count(); v++ ) {
+				int vindex = part.vertexMap[v];
+				if ( vindex < 0 || vindex >= vcnt )
+					break;
 
-					if ( bone )
-						boneTrans[ t ] = boneTrans[ t ] * bone->localTrans( skeletonRoot ) * weights.value( part.boneMap[t] ).trans;
+				if ( done[vindex] )
+					continue;
 
-					//if ( bone ) boneTrans[ t ] = bone->viewTrans() * weights.value( part.boneMap[t] ).trans;
+				done[vindex] = true;
+				for ( int w = 0; w < part.numWeightsPerVertex; w++ ) {
+					QPair<int, float> weight = part.weights.value( v * part.numWeightsPerVertex + w );
+					skin.addInfluence( vindex, part.boneMap.value( weight.first, -1 ), weight.second );
 				}
+			}
+		}
+	} else {
+		QVector<int> count( vcnt, 0 );
+		for ( const BoneWeights & bw : weights ) {
+			for ( const VertexWeight & vw : bw.weights ) {
+				if ( vw.vertex < 0 || vw.vertex >= vcnt )
+					break;
 
-				for ( int v = 0; v < part.vertexMap.count(); v++ ) {
-					int vindex = part.vertexMap[ v ];
-					if ( vindex < 0 || vindex >= vcnt )
-						break;
-
-					if ( transVerts[vindex] == Vector3() ) {
-						for ( int w = 0; w < part.numWeightsPerVertex; w++ ) {
-							QPair<int, float> weight = part.weights[ v * part.numWeightsPerVertex + w ];
+				count[vw.vertex]++;
+			}
+		}
 
+		skin.resetInfluences( vcnt, vcnt ? *std::max_element( count.constBegin(), count.constEnd() ) : 0 );
 
-							Transform trans = boneTrans.value( weight.first );
+		for ( int b = 0; b < weights.count(); b++ ) {
+			for ( const VertexWeight & vw : weights[b].weights ) {
+				if ( vw.vertex < 0 || vw.vertex >= vcnt )
+					break;
 
-							if ( vcnt > vindex )
-								transVerts[vindex] += trans * verts[vindex] * weight.second;
-							if ( ncnt > vindex )
-								transNorms[vindex] += trans.rotation * norms[vindex] * weight.second;
-							if ( tcnt > vindex )
-								transTangents[vindex] += trans.rotation * tangents[vindex] * weight.second;
-							if ( bcnt > vindex )
-								transBitangents[vindex] += trans.rotation * bitangents[vindex] * weight.second;
-						}
-					}
-				}
+				skin.addInfluence( vw.vertex, b, vw.weight );
 			}
-		} else {
-			int x = 0;
-			for ( const BoneWeights& bw : weights ) {
-				Transform trans = viewTrans() * skeletonTrans;
-				Node * bone = root ? root->findChild( bw.bone ) : 0;
+		}
+	}
 
-				if ( bone )
-					trans = trans * bone->localTrans( skeletonRoot ) * bw.trans;
+	// Partition influences refer to the skin bones, NiSkinData weights to the bone list
+	int boneCount = partitions.count() ? bones.count() : weights.count();
+	gpuSkinnable = isSkinned && boneCount <= MAX_GPU_BONES && skin.exportInfluences( boneCount, boneIndices, boneWeights );
+	boneIndexBuffer.invalidate();
+	boneWeightBuffer.invalidate();
+}
 
-				if ( bone )
-					weights[x++].tcenter = bone->viewTrans() * bw.center;
-				else
-					x++;
-
-				for ( const VertexWeight& vw : bw.weights ) {
-					int vindex = vw.vertex;
-					if ( vindex < 0 || vindex >= vcnt )
-						break;
-
-					if ( vcnt > vindex )
-						transVerts[vindex] += trans * verts[vindex] * vw.weight;
-					if ( ncnt > vindex )
-						transNorms[vindex] += trans.rotation * norms[vindex] * vw.weight;
-					if ( tcnt > vindex )
-						transTangents[vindex] += trans.rotation * tangents[vindex] * vw.weight;
-					if ( bcnt > vindex )
-						transBitangents[vindex] += trans.rotation * bitangents[vindex] * vw.weight;
-				}
-			}
-		}
+void Mesh::transformShapes()
+{
+	if ( isHidden() )
+		return;
 
-		for ( int n = 0; n < transNorms.count(); n++ )
-			transNorms[n].normalize();
+	Node::transformShapes();
 
-		for ( int t = 0; t < transTangents.count(); t++ )
-			transTangents[t].normalize();
+	transformRigid = true;
 
-		for ( int t = 0; t < transBitangents.count(); t++ )
-			transBitangents[t].normalize();
+	gpuSkinned = false;
 
-		boundSphere = BoundSphere( transVerts );
-		boundSphere.applyInv( viewTrans() );
-		updateBounds = false;
+	if ( isSkinned && doSkinning ) {
+		transformRigid = false;
+
+		updateBoneTransforms();
+
+		gpuSkinned = gpuSkinningAvailable();
+		if ( gpuSkinned )
+			skinOnGpu();
+		else
+			skinVertices();
 	} else {
-		transVerts = verts;
-		transNorms = norms;
-		transTangents = tangents;
-		transBitangents = bitangents;
-		transColors = colors;
+		useBindPose();
 	}
 
-	sortedTriangles = triangles;
+	updateSortedTriangles();
 
 	MaterialProperty * matprop = findProperty<MaterialProperty>();
 	if ( matprop && matprop->alphaValue() != 1.0 ) {
 		float a = matprop->alphaValue();
+		setColorAlpha( a );
 		transColors.resize( colors.count() );
 
 		for ( int c = 0; c < colors.count(); c++ )
 			transColors[c] = colors[c].blend( a );
 	} else {
 		transColors = colors;
-		if ( bslsp ) {
-			if ( !(bslsp->getFlags1() & ShaderFlags::SLSF1_Vertex_Alpha) ) {
-				for ( int c = 0; c < colors.count(); c++ )
-					transColors[c] = Color4( colors[c].red(), colors[c].green(), colors[c].blue(), 1.0f );
+		if ( bslsp && !(bslsp->getFlags1() & ShaderFlags::SLSF1_Vertex_Alpha) ) {
+			setColorAlpha( -1.0f );
+			for ( int c = 0; c < colors.count(); c++ )
+				transColors[c] = Color4( colors[c].red(), colors[c].green(), colors[c].blue(), 1.0f );
+		} else {
+			setColorAlpha( 1.0f );
+		}
+	}
+}
+
+void Mesh::updateBoneTransforms()
+{
+	updateBoneNodes( skeletonRoot );
+
+	if ( partitions.count() ) {
+		skin.setBoneCount( bones.count() );
+		for ( int b = 0; b < bones.count(); b++ ) {
+			Node * bone = boneNodes[b];
+			Transform t = scene->view;
+
+			if ( bone )
+				t = t * bone->localTrans( skeletonRoot ) * weights.value( b ).trans;
+
+			skin.setBone( b, t );
+		}
+	} else {
+		skin.setBoneCount( weights.count() );
+		for ( int b = 0; b < weights.count(); b++ ) {
+			Node * bone = boneNodes.value( b );
+			Transform t = viewTrans() * skeletonTrans;
+
+			if ( bone ) {
+				t = t * bone->localTrans( skeletonRoot ) * weights[b].trans;
+				weights[b].tcenter = bone->viewTrans() * weights[b].center;
 			}
+
+			skin.setBone( b, t );
 		}
 	}
 }
@@ -984,15 +1465,13 @@ BoundSphere Mesh::bounds() const
 
 void Mesh::drawShapes( NodeList * secondPass, bool presort )
 {
-	if ( isHidden() )
+	if ( isHidden() || culled )
 		return;
 
 	// TODO: Only run this if BSXFlags has "EditorMarkers present" flag
 	if ( !(scene->options & Scene::ShowMarkers) && name.startsWith( "EditorMarker" ) )
 		return;
 
-	auto nif = static_cast<const NifModel *>(iBlock.model());
-	
 	if ( Node::SELECTING ) {
 		if ( scene->selMode & Scene::SelObject ) {
 			int s_nodeId = ID2COLORKEY( nodeId );
@@ -1016,6 +1495,16 @@ void Mesh::drawShapes( NodeList * secondPass, bool presort )
 		return;
 	}
 
+	// Other opaque meshes are drawn after the traversal, sorted by render state
+	if ( secondPass && !presorted && scene->enqueue( this ) )
+		return;
+
+	// Picking draws without shaders, so skin on the CPU
+	if ( gpuSkinned && Node::SELECTING ) {
+		gpuSkinned = false;
+		skinVertices();
+	}
+
 	// TODO: Option to hide Refraction and other post effects
 
 	// rigid mesh? then pass the transformation on to the gl layer
@@ -1039,24 +1528,29 @@ void Mesh::drawShapes( NodeList * secondPass, bool presort )
 	glEnable( GL_POLYGON_OFFSET_FILL );
 	glPolygonOffset( 1.0f, 2.0f );
 
+	QOpenGLFunctions * fn = scene->renderer->fn;
+
 	glEnableClientState( GL_VERTEX_ARRAY );
-	glVertexPointer( 3, GL_FLOAT, 0, transVerts.constData() );
+	if ( vertBuffer.bind( fn, transVerts ) )
+		glVertexPointer( 3, GL_FLOAT, 0, nullptr );
+	else
+		glVertexPointer( 3, GL_FLOAT, 0, transVerts.constData() );
 
 	if ( !Node::SELECTING ) {
-		if ( transNorms.count() ) {
+		if ( normBuffer.bind( fn, transNorms ) ) {
 			glEnableClientState( GL_NORMAL_ARRAY );
-			glNormalPointer( GL_FLOAT, 0, transNorms.constData() );
+			glNormalPointer( GL_FLOAT, 0, nullptr );
 		}
 
 		// Do VCs if legacy or if either bslsp or bsesp is set
 		bool doVCs = (!bssp) || (bssp && (bssp->getFlags2() & ShaderFlags::SLSF2_Vertex_Colors));
 
-		if ( transColors.count()
-			&& ( scene->options & Scene::DoVertexColors )
-			&& doVCs )
+		if ( ( scene->options & Scene::DoVertexColors )
+			&& doVCs
+			&& colorBuffer.bind( fn, transColors ) )
 		{
 			glEnableClientState( GL_COLOR_ARRAY );
-			glColorPointer( 4, GL_FLOAT, 0, transColors.constData() );
+			glColorPointer( 4, GL_FLOAT, 0, nullptr );
 		} else {
 			if ( !hasVertexColors && (bslsp && bslsp->hasVertexColors) ) {
 				// Correctly blacken the mesh if SLSF2_Vertex_Colors is still on
@@ -1068,6 +1562,9 @@ void Mesh::drawShapes( NodeList * secondPass, bool presort )
 		}
 	}
 
+	// Texture coordinates of the fixed function pipeline are client side arrays
+	fn->glBindBuffer( GL_ARRAY_BUFFER, 0 );
+
 	// TODO: Hotspot.  See about optimizing this.
 	if ( !Node::SELECTING )
 		shader = scene->renderer->setupProgram( this, shader );
@@ -1078,38 +1575,34 @@ void Mesh::drawShapes( NodeList * secondPass, bool presort )
 
 	if ( !isLOD ) {
 		// render the triangles
-		if ( sortedTriangles.count() )
-			glDrawElements( GL_TRIANGLES, sortedTriangles.count() * 3, GL_UNSIGNED_SHORT, sortedTriangles.constData() );
-
-	} else if ( sortedTriangles.count() ) {
-		auto lod0 = nif->get<uint>( iBlock, "LOD0 Size" );
-		auto lod1 = nif->get<uint>( iBlock, "LOD1 Size" );
-		auto lod2 = nif->get<uint>( iBlock, "LOD2 Size" );
-
-		auto lod0tris = sortedTriangles.mid( 0, lod0 );
-		auto lod1tris = sortedTriangles.mid( lod0, lod1 );
-		auto lod2tris = sortedTriangles.mid( lod0 + lod1, lod2 );
-
-		// If Level2, render all
-		// If Level1, also render Level0
-		switch ( scene->lodLevel ) {
-		case Scene::Level2:
-			if ( lod2tris.count() )
-				glDrawElements( GL_TRIANGLES, lod2tris.count() * 3, GL_UNSIGNED_SHORT, lod2tris.constData() );
-		case Scene::Level1:
-			if ( lod1tris.count() )
-				glDrawElements( GL_TRIANGLES, lod1tris.count() * 3, GL_UNSIGNED_SHORT, lod1tris.constData() );
-		case Scene::Level0:
-		default:
-			if ( lod0tris.count() )
-				glDrawElements( GL_TRIANGLES, lod0tris.count() * 3, GL_UNSIGNED_SHORT, lod0tris.constData() );
-			break;
-		}
+		drawTriangles( 0, sortedTriangles.count() );
+	} else {
+		drawLodTriangles();
 	}
 
 	// render the tristrips
-	for ( auto & s : tristrips )
-		glDrawElements( GL_TRIANGLE_STRIP, s.count(), GL_UNSIGNED_SHORT, s.constData() );
+	const auto & strips = tristrips;
+	if ( strips.constData() != stripSource.constData() ) {
+		stripSource = strips;
+		stripPoints.clear();
+		for ( const TriStrip & s : strips )
+			stripPoints += s;
+
+		stripBuffer.invalidate();
+	}
+
+	if ( stripBuffer.bind( fn, stripPoints ) ) {
+		int offset = 0;
+		for ( const TriStrip & s : strips ) {
+			glDrawElements( GL_TRIANGLE_STRIP, s.count(), GL_UNSIGNED_SHORT, (const GLvoid *)(offset * sizeof(quint16)) );
+			offset += s.count();
+
+			scene->profiler.count( FrameProfiler::DrawCalls );
+			scene->profiler.count( FrameProfiler::Vertices, s.count() );
+		}
+	}
+
+	fn->glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
 
 	if ( isDoubleSided ) {
 		glEnable( GL_CULL_FACE );
@@ -1182,24 +1675,24 @@ void Mesh::drawSelection() const
 	}
 
 	if ( transformRigid ) {
-		glPushMatrix();
-		glMultMatrix( viewTrans() );
+		DebugDraw::pushMatrix();
+		DebugDraw::multMatrix( viewTrans() );
 	}
 
 	glDisable( GL_LIGHTING );
 	glDisable( GL_COLOR_MATERIAL );
 	glDisable( GL_TEXTURE_2D );
 	glDisable( GL_NORMALIZE );
-	glEnable( GL_DEPTH_TEST );
-	glDepthMask( GL_FALSE );
-	glEnable( GL_BLEND );
+	DebugDraw::enable( GL_DEPTH_TEST );
+	DebugDraw::depthMask( GL_FALSE );
+	DebugDraw::enable( GL_BLEND );
 	glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
 	glDisable( GL_ALPHA_TEST );
 
-	glDisable( GL_CULL_FACE );
+	DebugDraw::disable( GL_CULL_FACE );
 
-	glLineWidth( 1.0 );
-	glPointSize( 3.5 );
+	DebugDraw::lineWidth( 1.0 );
+	DebugDraw::pointSize( 3.5 );
 
 	QString n;
 	int i = -1;
@@ -1220,10 +1713,10 @@ void Mesh::drawSelection() const
 		n = idx.data( NifSkopeDisplayRole ).toString();
 	}
 
-	glDepthFunc( GL_LEQUAL );
+	DebugDraw::depthFunc( GL_LEQUAL );
 	glNormalColor();
 
-	glPolygonMode( GL_FRONT_AND_BACK, GL_POINT );
+	DebugDraw::polygonMode( GL_POINT );
 
 	if ( n == "Vertices" || n == "Normals" || n == "Vertex Colors"
 	     || n == "UV Sets" || n == "Tangents" || n == "Bitangents" )
@@ -1236,7 +1729,7 @@ void Mesh::drawSelection() const
 		glEnd();
 
 		if ( i >= 0 ) {
-			glDepthFunc( GL_ALWAYS );
+			DebugDraw::depthFunc( GL_ALWAYS );
 			glHighlightColor();
 			glBegin( GL_POINTS );
 			glVertex( transVerts.value( i ) );
@@ -1262,7 +1755,7 @@ void Mesh::drawSelection() const
 		glEnd();
 
 		if ( i >= 0 ) {
-			glDepthFunc( GL_ALWAYS );
+			DebugDraw::depthFunc( GL_ALWAYS );
 			glHighlightColor();
 			glBegin( GL_POINTS );
 			QModelIndex iPoints = points.child( i, 0 );
@@ -1280,7 +1773,7 @@ void Mesh::drawSelection() const
 		}
 	}
 
-	glPolygonMode( GL_FRONT_AND_BACK, GL_LINE );
+	DebugDraw::polygonMode( GL_LINE );
 
 	// TODO: Reenable as an alternative to MSAA when MSAA is not supported
 	//glEnable( GL_LINE_SMOOTH );
@@ -1311,7 +1804,7 @@ void Mesh::drawSelection() const
 		glEnd();
 
 		if ( i >= 0 ) {
-			glDepthFunc( GL_ALWAYS );
+			DebugDraw::depthFunc( GL_ALWAYS );
 			glHighlightColor();
 			glBegin( GL_LINES );
 			glVertex( transVerts.value( i ) );
@@ -1339,7 +1832,7 @@ void Mesh::drawSelection() const
 		glEnd();
 
 		if ( i >= 0 ) {
-			glDepthFunc( GL_ALWAYS );
+			DebugDraw::depthFunc( GL_ALWAYS );
 			glHighlightColor();
 			glBegin( GL_LINES );
 			glVertex( transVerts.value( i ) );
@@ -1369,7 +1862,7 @@ void Mesh::drawSelection() const
 		glEnd();
 
 		if ( i >= 0 ) {
-			glDepthFunc( GL_ALWAYS );
+			DebugDraw::depthFunc( GL_ALWAYS );
 			glHighlightColor();
 			glBegin( GL_LINES );
 			glVertex( transVerts.value( i ) );
@@ -1381,7 +1874,7 @@ void Mesh::drawSelection() const
 	}
 
 	if ( n == "Faces" || n == "Triangles" ) {
-		glLineWidth( 1.5f );
+		DebugDraw::lineWidth( 1.5f );
 
 		for ( const Triangle& tri : triangles ) {
 			glBegin( GL_TRIANGLES );
@@ -1393,8 +1886,8 @@ void Mesh::drawSelection() const
 		}
 
 		if ( i >= 0 ) {
-			glPolygonMode( GL_FRONT_AND_BACK, GL_FILL );
-			glDepthFunc( GL_ALWAYS );
+			DebugDraw::polygonMode( GL_FILL );
+			DebugDraw::depthFunc( GL_ALWAYS );
 			glHighlightColor();
 			Triangle tri = triangles.value( i );
 			glBegin( GL_TRIANGLES );
@@ -1403,12 +1896,12 @@ void Mesh::drawSelection() const
 			glVertex( transVerts.value( tri.v3() ) );
 			//glVertex( transVerts.value( tri.v1() ) );
 			glEnd();
-			glPolygonMode( GL_FRONT_AND_BACK, GL_LINE );
+			DebugDraw::polygonMode( GL_LINE );
 		}
 	}
 
 	if ( n == "Faces" || n == "Strips" || n == "Strip Lengths" ) {
-		glLineWidth( 1.5f );
+		DebugDraw::lineWidth( 1.5f );
 
 		for ( const TriStrip& strip : tristrips ) {
 			quint16 a = strip.value( 0 );
@@ -1441,7 +1934,7 @@ void Mesh::drawSelection() const
 				quint16 c = strip[v];
 
 				if ( a != b && b != c && c != a ) {
-					glDepthFunc( GL_ALWAYS );
+					DebugDraw::depthFunc( GL_ALWAYS );
 					glHighlightColor();
 					glBegin( GL_LINE_STRIP );
 					glVertex( transVerts.value( a ) );
@@ -1508,7 +2001,7 @@ void Mesh::drawSelection() const
 	}
 
 	if ( transformRigid )
-		glPopMatrix();
+		DebugDraw::popMatrix();
 }
 
 QString Mesh::textStats() const
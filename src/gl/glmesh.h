@@ -34,6 +34,8 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define GLMESH_H
 
 #include "gl/glnode.h" // Inherited
+#include "gl/glpicking.h"
+#include "gl/glskinning.h"
 #include "gl/gltools.h"
 
 #include <QPersistentModelIndex>
@@ -49,12 +51,14 @@ using TexCoords = QVector<Vector2>;
 Q_DECLARE_TYPEINFO( TexCoords, Q_MOVABLE_TYPE );
 
 class NifModel;
+struct SharedGeometry;
 
 class Shape : public Node
 {
 	friend class MorphController;
 	friend class UVController;
 	friend class Renderer;
+	friend class Scene;
 
 public:
 	Shape( Scene * s, const QModelIndex & b );
@@ -65,6 +69,17 @@ public:
 	virtual void drawVerts() const {};
 	virtual QModelIndex vertexAt( int ) const { return QModelIndex(); };
 
+	/*! Casts a ray given in eye space at the triangles of the shape
+	 *
+	 * @param origin	The ray origin
+	 * @param dir		The ray direction
+	 * @param distance	Hits beyond it are ignored; set to the distance of the hit in multiples of @p dir
+	 * @param triangle	Set to the index of the triangle hit
+	 * @param vertex	Set to the index of the vertex of the triangle nearest to the hit
+	 * @return			True if the shape was hit
+	 */
+	bool castRay( const Vector3 & origin, const Vector3 & dir, float & distance, int & triangle, int & vertex );
+
 	int shapeNumber;
 
 protected:
@@ -75,12 +90,51 @@ protected:
 
 	void boneSphere( const NifModel * nif, const QModelIndex & index ) const;
 
+	//! Points the texture coordinate array of the active texture unit at a UV set buffer
+	bool bindCoords( int set );
+	//! Points the texture coordinate array of the active texture unit at the tangent buffer
+	bool bindTangents();
+	//! Points the texture coordinate array of the active texture unit at the bitangent buffer
+	bool bindBitangents();
+	//! Points the texture coordinate array of the active texture unit at the bone index buffer
+	bool bindBoneIndices();
+	//! Points the texture coordinate array of the active texture unit at the bone weight buffer
+	bool bindBoneWeights();
+	//! Can the shape be skinned by the shader program it was last drawn with?
+	bool gpuSkinningAvailable() const;
+	//! Resolves the nodes of the bones below the skeleton root @p rootId
+	void updateBoneNodes( int rootId );
+	//! Passes the bind pose on to the shader program, bounded by the bone palette
+	void skinOnGpu();
+	//! Skins the vertices on the CPU with the bone palette
+	void skinVertices();
+	//! Draws the vertices in bind pose, or as transformed by the view
+	void useBindPose();
+	//! Invalidates the color buffer if the transformed colors are made with another alpha
+	void setColorAlpha( float alpha );
+	//! Sorts the triangles back to front if the shape is alpha sorted
+	void updateSortedTriangles();
+	//! Draws a range of the sorted triangles from the index buffer, using vertices @p minVertex to @p maxVertex if known
+	void drawTriangles( int start, int count, int minVertex = 0, int maxVertex = -1 );
+	//! Reads the triangle counts of the LOD levels
+	void updateLodSizes( const NifModel * nif );
+	//! Draws the triangles of the LOD levels up to the level of the scene
+	void drawLodTriangles();
+	//! Takes over the arrays and buffer objects of a data block loaded by the scene
+	void useGeometry( const SharedGeometry & shared );
+	//! Deletes the GPU buffers
+	void releaseBuffers();
+	//! Marks the GPU buffers of the geometry arrays as rewritten
+	void invalidateBuffers();
+
 	int nifVersion = 0;
 
 	//! Shape data
 	QPersistentModelIndex iData;
 	//! Does the data need updating?
 	bool updateData = false;
+	//! Is the shape outside of the view frustum of the current pass?
+	bool culled = false;
 	//! Was Skinning enabled last update?
 	bool doSkinning = false;
 
@@ -109,9 +163,39 @@ protected:
 	QVector<TriStrip> tristrips;
 	//! Sorted triangles
 	QVector<Triangle> sortedTriangles;
+	//! Triangles of the last depth sort
+	QVector<Triangle> sortSource;
+	//! Vertices of the last depth sort
+	QVector<Vector3> sortVerts;
+	//! Eye position in shape space at the last depth sort
+	Vector3 sortEye;
+	//! Center of the vertices of the last depth sort
+	Vector3 sortCenter;
+	//! Distance of the eye to the center at the last depth sort
+	float sortDistance = 0;
 	//! Triangle indices
 	QVector<quint16> indices;
 
+	//! Triangles drawn up to a LOD level, and the vertices they use
+	struct LodRange
+	{
+		int count = 0;
+		int minVertex = 0;
+		int maxVertex = -1;
+	};
+
+	//! Triangle counts of the LOD levels
+	int lodSizes[3] = {};
+	//! Ranges of the LOD levels, from the start of lodSource
+	LodRange lodRanges[3];
+	//! Triangles the LOD ranges were computed for
+	QVector<Triangle> lodSource;
+
+	//! Triangles and strip triangles for ray casting, empty until the next ray cast after invalidateBuffers()
+	QVector<Triangle> pickTriangles;
+	//! Ray casting hierarchy over the transformed vertices
+	TriangleTree pickTree;
+
 	//! Is the transform rigid or weighted?
 	bool transformRigid = true;
 	//! Transformed vertices
@@ -125,6 +209,31 @@ protected:
 	//! Transformed bitangents
 	QVector<Vector3> transBitangents;
 
+	//! Vertex buffer
+	GLBuffer<Vector3> vertBuffer;
+	//! Normal buffer
+	GLBuffer<Vector3> normBuffer;
+	//! Vertex color buffer
+	GLBuffer<Color4> colorBuffer;
+	//! Tangent buffer
+	GLBuffer<Vector3> tangentBuffer;
+	//! Bitangent buffer
+	GLBuffer<Vector3> bitangentBuffer;
+	//! UV coordinate set buffers
+	QVector<GLBuffer<Vector2>> coordBuffers;
+	//! Sorted triangle index buffer
+	GLBuffer<Triangle> triangleBuffer = GLBuffer<Triangle>( GL_ELEMENT_ARRAY_BUFFER );
+	//! Strip point index buffer
+	GLBuffer<quint16> stripBuffer = GLBuffer<quint16>( GL_ELEMENT_ARRAY_BUFFER );
+	//! Strips concatenated into the strip point buffer
+	QVector<TriStrip> stripSource;
+	//! Concatenated strip points
+	QVector<quint16> stripPoints;
+	//! Were the vertex buffers filled by CPU skinning last frame?
+	bool cpuSkinned = false;
+	//! Alpha the transformed colors were made with, -1 if vertex alpha was dropped
+	float colorAlpha = 1.0f;
+
 	//! Does the skin data need updating?
 	bool updateSkin = false;
 	//! Toggle for skinning
@@ -136,6 +245,31 @@ protected:
 	QVector<BoneWeights> weights;
 	QVector<SkinPartition> partitions;
 
+	//! Bone nodes, indexed like bones; nullptr if not found below the skeleton root
+	QVector<Node *> boneNodes;
+	//! Scene node revision the bone nodes were resolved at, -1 to resolve again
+	int boneRevision = -1;
+
+	//! Maximum number of bones of the skinning shader programs
+	static const int MAX_GPU_BONES = 100;
+
+	//! Do the bone indices and weights describe the skin exactly?
+	bool gpuSkinnable = false;
+	//! Is the shape skinned by the shader program this frame?
+	bool gpuSkinned = false;
+	//! Bone indices per vertex, up to 4
+	QVector<Vector4> boneIndices;
+	//! Bone weights per vertex, up to 4
+	QVector<Vector4> boneWeights;
+	//! Bone influences and palette for this frame
+	SkinKernel skin;
+	//! Bounding sphere of the untransformed vertices
+	BoundSphere bindSphere;
+	//! Bone index buffer
+	GLBuffer<Vector4> boneIndexBuffer;
+	//! Bone weight buffer
+	GLBuffer<Vector4> boneWeightBuffer;
+
 	//! Holds the name of the shader, or "" if no shader
 	QString shader = "";
 
@@ -199,6 +333,10 @@ public:
 	QModelIndex vertexAt( int ) const override;
 
 protected:
+	//! Fills the bone influences of the skinning kernel and the shader program
+	void updateSkinWeights();
+	//! Updates the bone palette for this frame
+	void updateBoneTransforms();
 
 	//! Tangent data
 	QPersistentModelIndex iTangentData;
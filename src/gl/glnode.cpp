@@ -38,6 +38,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "gl/glscene.h"
 #include "gl/marker/furniture.h"
 #include "gl/marker/constraints.h"
+#include "gl/renderer.h"
 #include "model/nifmodel.h"
 #include "ui/settingsdialog.h"
 
@@ -47,6 +48,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <QSettings>
 
 #include <algorithm> // std::stable_sort
+#include <climits>
 
 
 //! @file glnode.cpp Scene management for visible NiNodes and their children.
@@ -150,41 +152,57 @@ bool compareNodes( const Node * node1, const Node * node2 )
 	return p2;
 }
 
-bool compareNodesAlpha( const Node * node1, const Node * node2 )
+void NodeList::sort()
+{
+	std::stable_sort( nodes.begin(), nodes.end(), compareNodes );
+}
+
+void NodeList::alphaSort( QHash<const Node *, int> * order )
 {
 	// Presorted meshes override other sorting
 	// Alpha enabled meshes on top (sorted from rear to front)
+	//	The keys are looked up once per node instead of once per comparison
+	struct Key
+	{
+		Node * node;
+		int rank;
+		bool presorted;
+		bool alpha;
+		float depth;
+	};
 
-	bool p1 = node1->isPresorted();
-	bool p2 = node2->isPresorted();
-
-	// Presort meshes
-	if ( p1 && p2 ) {
-		return node1->id() < node2->id();
+	QVector<Key> keys;
+	keys.reserve( nodes.count() );
+	for ( Node * n : nodes ) {
+		int rank = order ? order->value( n, INT_MAX ) : 0;
+		keys.append( { n, rank, n->isPresorted(), n->findProperty<AlphaProperty>() != nullptr, n->viewDepth() } );
 	}
 
-	bool a1 = node1->findProperty<AlphaProperty>();
-	bool a2 = node2->findProperty<AlphaProperty>();
+	// Start from the order of the previous frame so that ties do not flicker
+	if ( order ) {
+		std::stable_sort( keys.begin(), keys.end(), []( const Key & k1, const Key & k2 ) {
+			return k1.rank < k2.rank;
+		} );
+	}
 
-	float d1 = node1->viewDepth();
-	float d2 = node2->viewDepth();
+	std::stable_sort( keys.begin(), keys.end(), []( const Key & k1, const Key & k2 ) {
+		if ( k1.presorted && k2.presorted )
+			return k1.node->id() < k2.node->id();
 
-	// Alpha sort meshes
-	if ( a1 == a2 ) {
-		return (d1 < d2);
-	}
+		if ( k1.alpha == k2.alpha )
+			return k1.depth < k2.depth;
 
-	return a2;
-}
+		return k2.alpha;
+	} );
 
-void NodeList::sort()
-{
-	std::stable_sort( nodes.begin(), nodes.end(), compareNodes );
-}
+	for ( int i = 0; i < keys.count(); i++ )
+		nodes[i] = keys[i].node;
 
-void NodeList::alphaSort()
-{
-	std::stable_sort( nodes.begin(), nodes.end(), compareNodesAlpha );
+	if ( order ) {
+		order->clear();
+		for ( int i = 0; i < nodes.count(); i++ )
+			order->insert( nodes[i], i );
+	}
 }
 
 /*
@@ -199,7 +217,9 @@ Node::Node( Scene * s, const QModelIndex & index ) : IControllable( s, index ),
 
 	updateSettings();
 
-	connect( NifSkope::getOptions(), &SettingsDialog::saveSettings, this, &Node::updateSettings );
+	// No settings dialog exists when rendering without a window
+	if ( NifSkope::getOptions() )
+		connect( NifSkope::getOptions(), &SettingsDialog::saveSettings, this, &Node::updateSettings );
 }
 
 
@@ -221,22 +241,22 @@ void Node::updateSettings()
 //	TODO: Move away from the GL-like naming
 void glHighlightColor()
 {
-	glColor( Color4( highlightColor ) );
+	DebugDraw::color( Color4( highlightColor ) );
 }
 
 void glNormalColor()
 {
-	glColor( Color4( wireframeColor ) );
+	DebugDraw::color( Color4( wireframeColor ) );
 }
 
 void Node::glHighlightColor() const
 {
-	glColor( Color4( cfg.highlight ) );
+	DebugDraw::color( Color4( cfg.highlight ) );
 }
 
 void Node::glNormalColor() const
 {
-	glColor( Color4( cfg.wireframe ) );
+	DebugDraw::color( Color4( cfg.wireframe ) );
 }
 
 
@@ -535,25 +555,25 @@ void Node::draw()
 
 	if ( Node::SELECTING ) {
 		int s_nodeId = ID2COLORKEY( nodeId );
-		glColor4ubv( (GLubyte *)&s_nodeId );
-		glLineWidth( 5 ); // make hitting a line a litlle bit more easy
+		DebugDraw::color( (GLubyte *)&s_nodeId );
+		DebugDraw::lineWidth( 5 ); // make hitting a line a litlle bit more easy
 	} else {
-		glEnable( GL_DEPTH_TEST );
-		glDepthFunc( GL_LEQUAL );
-		glDepthMask( GL_TRUE );
+		DebugDraw::enable( GL_DEPTH_TEST );
+		DebugDraw::depthFunc( GL_LEQUAL );
+		DebugDraw::depthMask( GL_TRUE );
 		glDisable( GL_TEXTURE_2D );
 		glDisable( GL_NORMALIZE );
 		glDisable( GL_LIGHTING );
 		glDisable( GL_COLOR_MATERIAL );
-		glEnable( GL_BLEND );
+		DebugDraw::enable( GL_BLEND );
 		glDisable( GL_ALPHA_TEST );
 		glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
 
 		glNormalColor();
-		glLineWidth( 2.5 );
+		DebugDraw::lineWidth( 2.5 );
 	}
 
-	glPointSize( 8.5 );
+	DebugDraw::pointSize( 8.5 );
 
 	Vector3 a = viewTrans().translation;
 	Vector3 b = a;
@@ -572,7 +592,7 @@ void Node::draw()
 		glEnd();
 	} else {
 		auto c = cfg.wireframe;
-		glColor4f( c.redF(), c.greenF(), c.blueF(), c.alphaF() / 3.0 );
+		DebugDraw::color( Color4( c.redF(), c.greenF(), c.blueF(), c.alphaF() / 3.0 ) );
 		drawDashLine( a, b, 144 );
 	}
 
@@ -602,34 +622,34 @@ void Node::drawSelection() const
 
 	if ( Node::SELECTING ) {
 		int s_nodeId = ID2COLORKEY( nodeId );
-		glColor4ubv( (GLubyte *)&s_nodeId );
-		glLineWidth( 5 );
+		DebugDraw::color( (GLubyte *)&s_nodeId );
+		DebugDraw::lineWidth( 5 );
 	} else {
-		glEnable( GL_DEPTH_TEST );
-		glDepthFunc( GL_ALWAYS );
-		glDepthMask( GL_TRUE );
+		DebugDraw::enable( GL_DEPTH_TEST );
+		DebugDraw::depthFunc( GL_ALWAYS );
+		DebugDraw::depthMask( GL_TRUE );
 		glDisable( GL_TEXTURE_2D );
 		glDisable( GL_NORMALIZE );
 		glDisable( GL_LIGHTING );
 		glDisable( GL_COLOR_MATERIAL );
-		glEnable( GL_BLEND );
+		DebugDraw::enable( GL_BLEND );
 		glDisable( GL_ALPHA_TEST );
 		glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
 
 		glHighlightColor();
-		glLineWidth( 2.5 );
+		DebugDraw::lineWidth( 2.5 );
 	}
 
-	glPointSize( 8.5 );
+	DebugDraw::pointSize( 8.5 );
 
-	glPushMatrix();
-	glMultMatrix( viewTrans() );
+	DebugDraw::pushMatrix();
+	DebugDraw::multMatrix( viewTrans() );
 
 	float sceneRadius = scene->bounds().radius;
 	float normalScale = (sceneRadius > 150.0) ? 1.0 : sceneRadius / 150.0;
 
 	if ( currentBlock == "BSConnectPoint::Parents" ) {
-		glPolygonMode( GL_FRONT_AND_BACK, GL_LINE );
+		DebugDraw::polygonMode( GL_LINE );
 
 		auto cp = nif->getIndex( scene->currentBlock, "Connect Points" );
 		bool isChild = scene->currentIndex.parent().data( NifSkopeDisplayRole ).toString() == "Connect Points";
@@ -662,8 +682,8 @@ void Node::drawSelection() const
 				glNormalColor();
 			}
 
-			glPushMatrix();
-			glMultMatrix( t );
+			DebugDraw::pushMatrix();
+			DebugDraw::multMatrix( t );
 
 			auto pos = Vector3( 0, 0, 0 );
 
@@ -672,35 +692,35 @@ void Node::drawSelection() const
 			drawDashLine( pos, Vector3( 0, 0, 1 ), 15 );
 			drawCircle( pos, Vector3( 0, 1, 0 ), 1, 64 );
 
-			glPopMatrix();
+			DebugDraw::popMatrix();
 		}
 
 	}
 
 	if ( currentBlock.endsWith( "Node" ) && scene->options & Scene::ShowNodes && scene->options & Scene::ShowAxes ) {
-		glPolygonMode( GL_FRONT_AND_BACK, GL_LINE );
+		DebugDraw::polygonMode( GL_LINE );
 
 		Transform t;
 		Matrix m;
 		m.fromQuat( nif->get<Quat>( scene->currentIndex, "Rotation" ) );
 		t.rotation = m;
 
-		glPushMatrix();
-		glMultMatrix( t );
+		DebugDraw::pushMatrix();
+		DebugDraw::multMatrix( t );
 
 		auto pos = Vector3( 0, 0, 0 );
 
-		glColor( { 0, 1, 0 } );
+		DebugDraw::color( { 0, 1, 0 } );
 		drawDashLine( pos, Vector3( 0, 1, 0 ), 15 );
-		glColor( { 1, 0, 0 } );
+		DebugDraw::color( { 1, 0, 0 } );
 		drawDashLine( pos, Vector3( 1, 0, 0 ), 15 );
-		glColor( { 0, 0, 1 } );
+		DebugDraw::color( { 0, 0, 1 } );
 		drawDashLine( pos, Vector3( 0, 0, 1 ), 15 );
 
-		glPopMatrix();
+		DebugDraw::popMatrix();
 	}
 
-	glPopMatrix();
+	DebugDraw::popMatrix();
 
 	if ( extraData )
 		return;
@@ -716,7 +736,7 @@ void Node::drawSelection() const
 	glEnd();
 
 	auto c = cfg.highlight;
-	glColor4f( c.redF(), c.greenF(), c.blueF(), c.alphaF() * 0.8 );
+	DebugDraw::color( Color4( c.redF(), c.greenF(), c.blueF(), c.alphaF() * 0.8 ) );
 	glBegin( GL_LINES );
 	glVertex( a );
 	glVertex( b );
@@ -729,8 +749,8 @@ void Node::drawSelection() const
 
 void DrawVertexSelection( QVector<Vector3> & verts, int i )
 {
-	glPointSize( 3.5 );
-	glDepthFunc( GL_LEQUAL );
+	DebugDraw::pointSize( 3.5 );
+	DebugDraw::depthFunc( GL_LEQUAL );
 	glNormalColor();
 	glBegin( GL_POINTS );
 
@@ -740,7 +760,7 @@ void DrawVertexSelection( QVector<Vector3> & verts, int i )
 	glEnd();
 
 	if ( i >= 0 ) {
-		glDepthFunc( GL_ALWAYS );
+		DebugDraw::depthFunc( GL_ALWAYS );
 		glHighlightColor();
 		glBegin( GL_POINTS );
 		glVertex( verts.value( i ) );
@@ -750,8 +770,8 @@ void DrawVertexSelection( QVector<Vector3> & verts, int i )
 
 void DrawTriangleSelection( QVector<Vector3> const & verts, Triangle const & tri )
 {
-	glLineWidth( 1.5f );
-	glDepthFunc( GL_ALWAYS );
+	DebugDraw::lineWidth( 1.5f );
+	DebugDraw::depthFunc( GL_ALWAYS );
 	glHighlightColor();
 	glBegin( GL_LINE_STRIP );
 	glVertex( verts.value( tri.v1() ) );
@@ -767,321 +787,333 @@ void DrawTriangleIndex( QVector<Vector3> const & verts, Triangle const & tri, in
 	renderText( c, QString( "%1" ).arg( index ) );
 }
 
-void drawHvkShape( const NifModel * nif, const QModelIndex & iShape, QStack<QModelIndex> & stack, const Scene * scene, const float origin_color3fv[3] )
+//! Decodes a collision shape block into the record drawn by drawHvkShape
+static HavokShape readHvkShape( const NifModel * nif, const QModelIndex & iShape )
 {
-	QString name = (nif) ? nif->itemName( iShape ) : "";
+	HavokShape shape;
 
-	bool extraData = (name == "hkPackedNiTriStripsData");
-
-	if ( (!nif || !iShape.isValid() || stack.contains( iShape )) && !extraData )
-		return;
-
-	if ( !(scene->selMode & Scene::SelObject) )
-		return;
-
-	stack.push( iShape );
+	QString name = nif->itemName( iShape );
 
 	// Scale up for Skyrim
 	float havokScale = (nif->checkVersion( 0x14020007, 0x14020007 ) && nif->getUserVersion() >= 12) ? 10.0f : 1.0f;
 
-	//qDebug() << "draw shape" << nif->getBlockNumber( iShape ) << nif->itemName( iShape );
-
 	if ( name.endsWith( "ListShape" ) ) {
-		QModelIndex iShapes = nif->getIndex( iShape, "Sub Shapes" );
-
-		if ( iShapes.isValid() ) {
-			for ( int r = 0; r < nif->rowCount( iShapes ); r++ ) {
-				if ( !Node::SELECTING ) {
-					if ( scene->currentBlock == nif->getBlock( nif->getLink( iShapes.child( r, 0 ) ) ) ) {
-						// fix: add selected visual to havok meshes
-						glHighlightColor();
-						glLineWidth( 2.5 );
-					} else {
-						if ( scene->currentBlock != iShape ) {
-							// allow group highlighting
-							glLineWidth( 1.0 );
-							glColor3fv( origin_color3fv );
-						}
-					}
-				}
+		shape.type = HavokShape::ListShape;
 
-				drawHvkShape( nif, nif->getBlock( nif->getLink( iShapes.child( r, 0 ) ) ), stack, scene, origin_color3fv );
-			}
-		}
+		QModelIndex iShapes = nif->getIndex( iShape, "Sub Shapes" );
+		for ( int r = 0; r < nif->rowCount( iShapes ); r++ )
+			shape.children << nif->getLink( iShapes.child( r, 0 ) );
 	} else if ( name == "bhkTransformShape" || name == "bhkConvexTransformShape" ) {
-		glPushMatrix();
+		shape.type = HavokShape::TransformShape;
+
 		Matrix4 tm = nif->get<Matrix4>( iShape, "Transform" );
 		// TODO find a better way to apply tm
-		Transform t;
 		Vector3 s;
-		tm.decompose( t.translation, t.rotation, s );
-		t.translation *= havokScale;
-		t.scale = (s[0] + s[1] + s[2]) / 3.0; // assume uniform
-		glMultMatrix( t );
-		drawHvkShape( nif, nif->getBlock( nif->getLink( iShape, "Shape" ) ), stack, scene, origin_color3fv );
-		glPopMatrix();
+		tm.decompose( shape.transform.translation, shape.transform.rotation, s );
+		shape.transform.translation *= havokScale;
+		shape.transform.scale = (s[0] + s[1] + s[2]) / 3.0; // assume uniform
+		shape.children << nif->getLink( iShape, "Shape" );
 	} else if ( name == "bhkSphereShape" ) {
-		if ( Node::SELECTING ) {
-			int s_nodeId = ID2COLORKEY( nif->getBlockNumber( iShape ) );
-			glColor4ubv( (GLubyte *)&s_nodeId );
-		}
-
-		drawSphere( Vector3(), nif->get<float>( iShape, "Radius" ) * havokScale );
+		shape.type = HavokShape::SphereShape;
+		shape.radius = nif->get<float>( iShape, "Radius" ) * havokScale;
 	} else if ( name == "bhkMultiSphereShape" ) {
-		if ( Node::SELECTING ) {
-			int s_nodeId = ID2COLORKEY( nif->getBlockNumber( iShape ) );
-			glColor4ubv( (GLubyte *)&s_nodeId );
-		}
+		shape.type = HavokShape::MultiSphereShape;
 
 		QModelIndex iSpheres = nif->getIndex( iShape, "Spheres" );
-
 		for ( int r = 0; r < nif->rowCount( iSpheres ); r++ ) {
-			drawSphere( nif->get<Vector3>( iSpheres.child( r, 0 ), "Center" ), nif->get<float>( iSpheres.child( r, 0 ), "Radius" ) );
+			Vector3 c = nif->get<Vector3>( iSpheres.child( r, 0 ), "Center" );
+			shape.spheres << Vector4( c, nif->get<float>( iSpheres.child( r, 0 ), "Radius" ) );
 		}
 	} else if ( name == "bhkBoxShape" ) {
-		if ( Node::SELECTING ) {
-			int s_nodeId = ID2COLORKEY( nif->getBlockNumber( iShape ) );
-			glColor4ubv( (GLubyte *)&s_nodeId );
-		}
-
-		Vector3 v = nif->get<Vector3>( iShape, "Dimensions" );
-		v *= havokScale;
-		drawBox( v, -v );
+		shape.type = HavokShape::BoxShape;
+		shape.a = nif->get<Vector3>( iShape, "Dimensions" ) * havokScale;
 	} else if ( name == "bhkCapsuleShape" ) {
-		if ( Node::SELECTING ) {
-			int s_nodeId = ID2COLORKEY( nif->getBlockNumber( iShape ) );
-			glColor4ubv( (GLubyte *)&s_nodeId );
-		}
+		shape.type = HavokShape::CapsuleShape;
+		shape.a = nif->get<Vector3>( iShape, "First Point" ) * havokScale;
+		shape.b = nif->get<Vector3>( iShape, "Second Point" ) * havokScale;
+		shape.radius = nif->get<float>( iShape, "Radius" ) * havokScale;
+	} else if ( name == "bhkCylinderShape" ) {
+		shape.type = HavokShape::CylinderShape;
+		shape.a = Vector3( nif->get<Vector4>( iShape, "Vertex A" ) );
+		shape.b = Vector3( nif->get<Vector4>( iShape, "Vertex B" ) );
+		shape.radius = nif->get<float>( iShape, "Cylinder Radius" );
+	} else if ( name == "bhkNiTriStripsShape" ) {
+		shape.type = HavokShape::MeshShape;
+		shape.triangles = niTSSTriangles( nif, iShape );
+
+		for ( Vector3 & v : shape.triangles )
+			v /= 7.0f;
+
+		QModelIndex iStrips = nif->getIndex( iShape, "Strips Data" );
+		for ( int r = 0; r < nif->rowCount( iStrips ); r++ )
+			shape.dataBlocks << nif->getLink( iStrips.child( r, 0 ) );
+	} else if ( name == "bhkConvexVerticesShape" ) {
+		shape.type = HavokShape::MeshShape;
+		shape.triangles = convexHullTriangles( nif, iShape, havokScale );
+	} else if ( name == "bhkMoppBvTreeShape" ) {
+		shape.type = HavokShape::MoppShape;
+		shape.children << nif->getLink( iShape, "Shape" );
+	} else if ( name == "bhkPackedNiTriStripsShape" || name == "hkPackedNiTriStripsData" ) {
+		shape.type = HavokShape::PackedShape;
+		shape.data = nif->getLink( iShape, "Data" );
+		shape.dataBlocks << shape.data;
 
-        drawCapsule( nif->get<Vector3>( iShape, "First Point" ) * havokScale, nif->get<Vector3>( iShape, "Second Point" ) * havokScale, nif->get<float>( iShape, "Radius" ) * havokScale );
-    } else if (name == "bhkCylinderShape") {
-        if(Node::SELECTING) {
-            int s_nodeId = ID2COLORKEY(nif->getBlockNumber(iShape));
-            glColor4ubv( (GLubyte *)&s_nodeId);
-        }
+		QModelIndex iData = nif->getBlock( shape.data );
+		if ( iData.isValid() ) {
+			QVector<Vector3> verts = nif->getArray<Vector3>( iData, "Vertices" );
+			QModelIndex iTris = nif->getIndex( iData, "Triangles" );
 
-        drawCylinder(Vector3( nif->get<Vector4>( iShape, "Vertex A" ) ), Vector3( nif->get<Vector4>( iShape, "Vertex B" ) ), nif->get<float>( iShape, "Cylinder Radius" ) );
-    } else if ( name == "bhkNiTriStripsShape" ) {
-		glPushMatrix();
-		float s = 1.0f / 7.0f;
-		glScalef( s, s, s );
+			for ( int t = 0; t < nif->rowCount( iTris ); t++ ) {
+				Triangle tri = nif->get<Triangle>( iTris.child( t, 0 ), "Triangle" );
 
-		if ( Node::SELECTING ) {
-			int s_nodeId = ID2COLORKEY( nif->getBlockNumber( iShape ) );
-			glColor4ubv( (GLubyte *)&s_nodeId );
+				if ( tri[0] != tri[1] || tri[1] != tri[2] || tri[2] != tri[0] )
+					shape.triangles << verts.value( tri[0] ) << verts.value( tri[1] ) << verts.value( tri[2] );
+			}
 		}
+	} else if ( name == "bhkCompressedMeshShape" ) {
+		shape.type = HavokShape::MeshShape;
+		shape.triangles = cmsTriangles( nif, iShape );
+		shape.dataBlocks << nif->getLink( iShape, "Data" );
+	}
 
-		drawNiTSS( nif, iShape );
-
-		//if ( Options::getHavokState() == HAVOK_SOLID ) {
-		//	QColor c = Options::hlColor();
-		//	c.setAlphaF( 0.3 );
-		//	glColor( Color4( c ) );
-		//
-		//	drawNiTSS( nif, iShape, true );
-		//}
+	return shape;
+}
 
-		glPopMatrix();
-	} else if ( name == "bhkConvexVerticesShape" ) {
-		if ( Node::SELECTING ) {
-			int s_nodeId = ID2COLORKEY( nif->getBlockNumber( iShape ) );
-			glColor4ubv( (GLubyte *)&s_nodeId );
+//! Draws the selected parts of packed collision data
+static void drawHvkPackedSelection( const NifModel * nif, const QModelIndex & iShape, const QModelIndex & iData, const Scene * scene )
+{
+	QVector<Vector3> verts = nif->getArray<Vector3>( iData, "Vertices" );
+	QModelIndex iTris = nif->getIndex( iData, "Triangles" );
+
+	// Handle Selection of hkPackedNiTriStripsData
+	if ( scene->currentBlock == iData ) {
+		int i = -1;
+		QString n = scene->currentIndex.data( NifSkopeDisplayRole ).toString();
+		QModelIndex iParent = scene->currentIndex.parent();
+
+		if ( iParent.isValid() && iParent != iData ) {
+			n = iParent.data( NifSkopeDisplayRole ).toString();
+			i = scene->currentIndex.row();
 		}
 
-		drawConvexHull( nif, iShape, havokScale );
-
-		//if ( Options::getHavokState() == HAVOK_SOLID ) {
-		//	QColor c = Options::hlColor();
-		//	c.setAlphaF( 0.3 );
-		//	glColor( Color4( c ) );
-		//
-		//	drawConvexHull( nif, iShape, havokScale, true );
-		//}
+		if ( n == "Vertices" || n == "Normals" || n == "Vertex Colors" || n == "UV Sets" ) {
+			DrawVertexSelection( verts, i );
+		} else if ( ( n == "Faces" || n == "Triangles" ) ) {
+			if ( i == -1 ) {
+				DebugDraw::depthFunc( GL_ALWAYS );
+				glHighlightColor();
 
-	} else if ( name == "bhkMoppBvTreeShape" ) {
-		if ( !Node::SELECTING ) {
-			if ( scene->currentBlock == nif->getBlock( nif->getLink( iShape, "Shape" ) ) ) {
-				// fix: add selected visual to havok meshes
+				//for ( int t = 0; t < nif->rowCount( iTris ); t++ )
+				//	DrawTriangleIndex( verts, nif->get<Triangle>( iTris.child( t, 0 ), "Triangle" ), t );
+			} else if ( nif->isCompound( nif->getBlockType( scene->currentIndex ) ) ) {
+				Triangle tri = nif->get<Triangle>( iTris.child( i, 0 ), "Triangle" );
+				DrawTriangleSelection( verts, tri );
+				//DrawTriangleIndex( verts, tri, i );
+			} else if ( nif->getBlockName( scene->currentIndex ) == "Normal" ) {
+				Triangle tri = nif->get<Triangle>( scene->currentIndex.parent(), "Triangle" );
+				Vector3 triCentre = ( verts.value( tri.v1() ) + verts.value( tri.v2() ) + verts.value( tri.v3() ) ) /  3.0;
+				DebugDraw::lineWidth( 1.5f );
+				DebugDraw::depthFunc( GL_ALWAYS );
 				glHighlightColor();
-				glLineWidth( 1.5f ); // taken from "DrawTriangleSelection"
-			} else {
-				glLineWidth( 1.0 );
-				glColor3fv( origin_color3fv );
+				glBegin( GL_LINES );
+				glVertex( triCentre );
+				glVertex( triCentre + nif->get<Vector3>( scene->currentIndex ) );
+				glEnd();
 			}
-		}
-
-		drawHvkShape( nif, nif->getBlock( nif->getLink( iShape, "Shape" ) ), stack, scene, origin_color3fv );
-	} else if ( name == "bhkPackedNiTriStripsShape" || name == "hkPackedNiTriStripsData" ) {
-		if ( Node::SELECTING ) {
-			int s_nodeId = ID2COLORKEY( nif->getBlockNumber( iShape ) );
-			glColor4ubv( (GLubyte *)&s_nodeId );
-		}
+		} else if ( n == "Sub Shapes" ) {
+			int start_vertex = 0;
+			int end_vertex = 0;
+			int num_vertices = nif->get<int>( scene->currentIndex, "Num Vertices" );
+
+			int ct = nif->rowCount( iTris );
+			int totalVerts = 0;
+			if ( num_vertices > 0 ) {
+				QModelIndex iParent = scene->currentIndex.parent();
+				int rowCount = nif->rowCount( iParent );
+				for ( int j = 0; j < i; j++ ) {
+					totalVerts += nif->get<int>( iParent.child( j, 0 ), "Num Vertices" );
+				}
 
-		QModelIndex iData = nif->getBlock( nif->getLink( iShape, "Data" ) );
+				end_vertex += totalVerts + num_vertices;
+				start_vertex += totalVerts;
 
-		if ( iData.isValid() ) {
-			QVector<Vector3> verts = nif->getArray<Vector3>( iData, "Vertices" );
-			QModelIndex iTris = nif->getIndex( iData, "Triangles" );
+				ct = (end_vertex - start_vertex) / 3;
+			}
 
 			for ( int t = 0; t < nif->rowCount( iTris ); t++ ) {
 				Triangle tri = nif->get<Triangle>( iTris.child( t, 0 ), "Triangle" );
 
-				if ( tri[0] != tri[1] || tri[1] != tri[2] || tri[2] != tri[0] ) {
-					glBegin( GL_LINE_STRIP );
-					glVertex( verts.value( tri[0] ) );
-					glVertex( verts.value( tri[1] ) );
-					glVertex( verts.value( tri[2] ) );
-					glVertex( verts.value( tri[0] ) );
-					glEnd();
+				if ( (start_vertex <= tri[0]) && (tri[0] < end_vertex) ) {
+					if ( (start_vertex <= tri[1]) && (tri[1] < end_vertex) && (start_vertex <= tri[2]) && (tri[2] < end_vertex) ) {
+						DrawTriangleSelection( verts, tri );
+						//DrawTriangleIndex( verts, tri, t );
+					} else {
+						qDebug() << "triangle with multiple materials?" << t;
+					}
 				}
 			}
+		}
+	}
+	// Handle Selection of bhkPackedNiTriStripsShape
+	else if ( scene->currentBlock == iShape ) {
+		int i = -1;
+		QString n = scene->currentIndex.data( NifSkopeDisplayRole ).toString();
+		QModelIndex iParent = scene->currentIndex.parent();
+
+		if ( iParent.isValid() && iParent != iShape ) {
+			n = iParent.data( NifSkopeDisplayRole ).toString();
+			i = scene->currentIndex.row();
+		}
 
-			// Handle Selection of hkPackedNiTriStripsData
-			if ( scene->currentBlock == iData ) {
-				int i = -1;
-				QString n = scene->currentIndex.data( NifSkopeDisplayRole ).toString();
-				QModelIndex iParent = scene->currentIndex.parent();
-
-				if ( iParent.isValid() && iParent != iData ) {
-					n = iParent.data( NifSkopeDisplayRole ).toString();
-					i = scene->currentIndex.row();
+		//qDebug() << n;
+		// n == "Sub Shapes" if the array is selected and if an element of the array is selected
+		// iParent != iShape only for the elements of the array
+		if ( ( n == "Sub Shapes" ) && ( iParent != iShape ) ) {
+			// get subshape vertex indices
+			QModelIndex iSubShapes = iParent;
+			QModelIndex iSubShape  = scene->currentIndex;
+			int start_vertex = 0;
+			int end_vertex = 0;
+
+			for ( int subshape = 0; subshape < nif->rowCount( iSubShapes ); subshape++ ) {
+				QModelIndex iCurrentSubShape = iSubShapes.child( subshape, 0 );
+				int num_vertices = nif->get<int>( iCurrentSubShape, "Num Vertices" );
+				//qDebug() << num_vertices;
+				end_vertex += num_vertices;
+
+				if ( iCurrentSubShape == iSubShape ) {
+					break;
+				} else {
+					start_vertex += num_vertices;
 				}
+			}
 
-				if ( n == "Vertices" || n == "Normals" || n == "Vertex Colors" || n == "UV Sets" ) {
-					DrawVertexSelection( verts, i );
-				} else if ( ( n == "Faces" || n == "Triangles" ) ) {
-					if ( i == -1 ) {
-						glDepthFunc( GL_ALWAYS );
-						glHighlightColor();
-
-						//for ( int t = 0; t < nif->rowCount( iTris ); t++ )
-						//	DrawTriangleIndex( verts, nif->get<Triangle>( iTris.child( t, 0 ), "Triangle" ), t );
-					} else if ( nif->isCompound( nif->getBlockType( scene->currentIndex ) ) ) {
-						Triangle tri = nif->get<Triangle>( iTris.child( i, 0 ), "Triangle" );
-						DrawTriangleSelection( verts, tri );
-						//DrawTriangleIndex( verts, tri, i );
-					} else if ( nif->getBlockName( scene->currentIndex ) == "Normal" ) {
-						Triangle tri = nif->get<Triangle>( scene->currentIndex.parent(), "Triangle" );
-						Vector3 triCentre = ( verts.value( tri.v1() ) + verts.value( tri.v2() ) + verts.value( tri.v3() ) ) /  3.0;
-						glLineWidth( 1.5f );
-						glDepthFunc( GL_ALWAYS );
-						glHighlightColor();
-						glBegin( GL_LINES );
-						glVertex( triCentre );
-						glVertex( triCentre + nif->get<Vector3>( scene->currentIndex ) );
-						glEnd();
-					}
-				} else if ( n == "Sub Shapes" ) {
-					int start_vertex = 0;
-					int end_vertex = 0;
-					int num_vertices = nif->get<int>( scene->currentIndex, "Num Vertices" );
-
-					int ct = nif->rowCount( iTris );
-					int totalVerts = 0;
-					if ( num_vertices > 0 ) {
-						QModelIndex iParent = scene->currentIndex.parent();
-						int rowCount = nif->rowCount( iParent );
-						for ( int j = 0; j < i; j++ ) {
-							totalVerts += nif->get<int>( iParent.child( j, 0 ), "Num Vertices" );
-						}
-
-						end_vertex += totalVerts + num_vertices;
-						start_vertex += totalVerts;
-
-						ct = (end_vertex - start_vertex) / 3;
-					}
+			// highlight the triangles of the subshape
+			for ( int t = 0; t < nif->rowCount( iTris ); t++ ) {
+				Triangle tri = nif->get<Triangle>( iTris.child( t, 0 ), "Triangle" );
 
-					for ( int t = 0; t < nif->rowCount( iTris ); t++ ) {
-						Triangle tri = nif->get<Triangle>( iTris.child( t, 0 ), "Triangle" );
-
-						if ( (start_vertex <= tri[0]) && (tri[0] < end_vertex) ) {
-							if ( (start_vertex <= tri[1]) && (tri[1] < end_vertex) && (start_vertex <= tri[2]) && (tri[2] < end_vertex) ) {
-								DrawTriangleSelection( verts, tri );
-								//DrawTriangleIndex( verts, tri, t );
-							} else {
-								qDebug() << "triangle with multiple materials?" << t;
-							}
-						}
+				if ( (start_vertex <= tri[0]) && (tri[0] < end_vertex) ) {
+					if ( (start_vertex <= tri[1]) && (tri[1] < end_vertex) && (start_vertex <= tri[2]) && (tri[2] < end_vertex) ) {
+						DrawTriangleSelection( verts, tri );
+						//DrawTriangleIndex( verts, tri, t );
+					} else {
+						qDebug() << "triangle with multiple materials?" << t;
 					}
 				}
 			}
-			// Handle Selection of bhkPackedNiTriStripsShape
-			else if ( scene->currentBlock == iShape ) {
-				int i = -1;
-				QString n = scene->currentIndex.data( NifSkopeDisplayRole ).toString();
-				QModelIndex iParent = scene->currentIndex.parent();
+		}
+	}
+}
 
-				if ( iParent.isValid() && iParent != iShape ) {
-					n = iParent.data( NifSkopeDisplayRole ).toString();
-					i = scene->currentIndex.row();
-				}
+void drawHvkShape( const NifModel * nif, int block, QStack<int> & stack, Scene * scene, const float origin_color3fv[3] )
+{
+	if ( !nif || block < 0 || stack.contains( block ) )
+		return;
 
-				//qDebug() << n;
-				// n == "Sub Shapes" if the array is selected and if an element of the array is selected
-				// iParent != iShape only for the elements of the array
-				if ( ( n == "Sub Shapes" ) && ( iParent != iShape ) ) {
-					// get subshape vertex indices
-					QModelIndex iSubShapes = iParent;
-					QModelIndex iSubShape  = scene->currentIndex;
-					int start_vertex = 0;
-					int end_vertex = 0;
-
-					for ( int subshape = 0; subshape < nif->rowCount( iSubShapes ); subshape++ ) {
-						QModelIndex iCurrentSubShape = iSubShapes.child( subshape, 0 );
-						int num_vertices = nif->get<int>( iCurrentSubShape, "Num Vertices" );
-						//qDebug() << num_vertices;
-						end_vertex += num_vertices;
-
-						if ( iCurrentSubShape == iSubShape ) {
-							break;
-						} else {
-							start_vertex += num_vertices;
-						}
-					}
+	if ( !(scene->selMode & Scene::SelObject) )
+		return;
 
-					// highlight the triangles of the subshape
-					for ( int t = 0; t < nif->rowCount( iTris ); t++ ) {
-						Triangle tri = nif->get<Triangle>( iTris.child( t, 0 ), "Triangle" );
-
-						if ( (start_vertex <= tri[0]) && (tri[0] < end_vertex) ) {
-							if ( (start_vertex <= tri[1]) && (tri[1] < end_vertex) && (start_vertex <= tri[2]) && (tri[2] < end_vertex) ) {
-								DrawTriangleSelection( verts, tri );
-								//DrawTriangleIndex( verts, tri, t );
-							} else {
-								qDebug() << "triangle with multiple materials?" << t;
-							}
-						}
+	// Decode the shape once, it is dropped again when one of its blocks changes
+	HavokShape * shape = scene->findHavokShape( block );
+	if ( !shape ) {
+		QModelIndex iShape = nif->getBlock( block );
+		if ( !iShape.isValid() )
+			return;
+
+		shape = scene->addHavokShape( block, readHvkShape( nif, iShape ) );
+	}
+
+	stack.push( block );
+
+	int currentBlock = nif->getBlockNumber( scene->currentBlock );
+
+	if ( Node::SELECTING && shape->type > HavokShape::TransformShape && shape->type != HavokShape::MoppShape ) {
+		int s_nodeId = ID2COLORKEY( block );
+		DebugDraw::color( (GLubyte *)&s_nodeId );
+	}
+
+	//qDebug() << "draw shape" << block << nif->itemName( nif->getBlock( block ) );
+
+	// Drawing the sub shapes may add records and move this one
+	QVector<int> children = shape->children;
+
+	switch ( shape->type ) {
+	case HavokShape::ListShape:
+		for ( int child : children ) {
+			if ( !Node::SELECTING ) {
+				if ( currentBlock == child ) {
+					// fix: add selected visual to havok meshes
+					glHighlightColor();
+					DebugDraw::lineWidth( 2.5 );
+				} else {
+					if ( currentBlock != block ) {
+						// allow group highlighting
+						DebugDraw::lineWidth( 1.0 );
+						DebugDraw::color( Color3( origin_color3fv[0], origin_color3fv[1], origin_color3fv[2] ) );
 					}
 				}
 			}
-		}
-	} else if ( name == "bhkCompressedMeshShape" ) {
-		glPushMatrix();
-		float s = 1.0f;
-		glScalef( s, s, s );
 
-		if ( Node::SELECTING ) {
-			int s_nodeId = ID2COLORKEY( nif->getBlockNumber( iShape ) );
-			glColor4ubv( (GLubyte *)&s_nodeId );
+			drawHvkShape( nif, child, stack, scene, origin_color3fv );
+		}
+		break;
+	case HavokShape::TransformShape:
+		DebugDraw::pushMatrix();
+		DebugDraw::multMatrix( shape->transform );
+		drawHvkShape( nif, children.value( 0, -1 ), stack, scene, origin_color3fv );
+		DebugDraw::popMatrix();
+		break;
+	case HavokShape::SphereShape:
+		drawSphere( Vector3(), shape->radius );
+		break;
+	case HavokShape::MultiSphereShape:
+		for ( const Vector4 & sphere : shape->spheres )
+			drawSphere( Vector3( sphere ), sphere[3] );
+		break;
+	case HavokShape::BoxShape:
+		drawBox( shape->a, -shape->a );
+		break;
+	case HavokShape::CapsuleShape:
+		drawCapsule( shape->a, shape->b, shape->radius );
+		break;
+	case HavokShape::CylinderShape:
+		drawCylinder( shape->a, shape->b, shape->radius );
+		break;
+	case HavokShape::MeshShape:
+		drawTriangleList( scene->renderer->fn, shape->buffer, shape->triangles );
+		break;
+	case HavokShape::MoppShape:
+		if ( !Node::SELECTING ) {
+			if ( currentBlock == children.value( 0, -1 ) ) {
+				// fix: add selected visual to havok meshes
+				glHighlightColor();
+				DebugDraw::lineWidth( 1.5f ); // taken from "DrawTriangleSelection"
+			} else {
+				DebugDraw::lineWidth( 1.0 );
+				DebugDraw::color( Color3( origin_color3fv[0], origin_color3fv[1], origin_color3fv[2] ) );
+			}
 		}
 
-		drawCMS( nif, iShape );
-
-		//if ( Options::getHavokState() == HAVOK_SOLID ) {
-		//	QColor c = Options::hlColor();
-		//	c.setAlphaF( 0.3 );
-		//	glColor( Color4( c ) );
-		//
-		//	drawCMS( nif, iShape, true );
-		//}
+		drawHvkShape( nif, children.value( 0, -1 ), stack, scene, origin_color3fv );
+		break;
+	case HavokShape::PackedShape:
+		drawTriangleList( scene->renderer->fn, shape->buffer, shape->triangles );
 
-		glPopMatrix();
+		// The selection is read from the model only while part of the shape is selected
+		if ( !Node::SELECTING && shape->data >= 0 && (currentBlock == shape->data || currentBlock == block) ) {
+			QModelIndex iData = nif->getBlock( shape->data );
+			if ( iData.isValid() )
+				drawHvkPackedSelection( nif, nif->getBlock( block ), iData, scene );
+		}
+		break;
+	default:
+		break;
 	}
 
 	stack.pop();
 }
 
-void drawHvkConstraint( const NifModel * nif, const QModelIndex & iConstraint, const Scene * scene )
+void drawHvkConstraint( const NifModel * nif, const QModelIndex & iConstraint, Scene * scene )
 {
 	if ( !( nif && iConstraint.isValid() && scene && (scene->options & Scene::ShowConstraints) ) )
 		return;
@@ -1113,8 +1145,8 @@ void drawHvkConstraint( const NifModel * nif, const QModelIndex & iConstraint, c
 
 	if ( Node::SELECTING ) {
 		int s_nodeId = ID2COLORKEY( nif->getBlockNumber( iConstraint ) );
-		glColor4ubv( (GLubyte *)&s_nodeId );
-		glLineWidth( 5 ); // make hitting a line a litlle bit more easy
+		DebugDraw::color( (GLubyte *)&s_nodeId );
+		DebugDraw::lineWidth( 5 ); // make hitting a line a litlle bit more easy
 	} else {
 		if ( scene->currentBlock == nif->getBlock( iConstraint ) ) {
 			// fix: add selected visual to havok meshes
@@ -1124,11 +1156,11 @@ void drawHvkConstraint( const NifModel * nif, const QModelIndex & iConstraint, c
 		}
 	}
 
-	glPushMatrix();
-	glLoadMatrix( scene->view );
+	DebugDraw::pushMatrix();
+	DebugDraw::loadMatrix( scene->view );
 
-	glPushAttrib( GL_ENABLE_BIT );
-	glEnable( GL_DEPTH_TEST );
+	DebugDraw::pushAttrib( GL_ENABLE_BIT );
+	DebugDraw::enable( GL_DEPTH_TEST );
 
 	QString name = nif->itemName( iConstraint );
 
@@ -1162,11 +1194,11 @@ void drawHvkConstraint( const NifModel * nif, const QModelIndex & iConstraint, c
 		const float minAngle = nif->get<float>( iHinge, "Min Angle" );
 		const float maxAngle = nif->get<float>( iHinge, "Max Angle" );
 
-		glPushMatrix();
-		glMultMatrix( tBodies.value( 0 ) );
+		DebugDraw::pushMatrix();
+		DebugDraw::multMatrix( tBodies.value( 0 ) );
 
 		if ( !Node::SELECTING )
-			glColor( color_a );
+			DebugDraw::color( color_a );
 
 		glBegin( GL_POINTS ); glVertex( pivotA ); glEnd();
 		glBegin( GL_LINES ); glVertex( pivotA ); glVertex( pivotA + axleA ); glEnd();
@@ -1174,13 +1206,13 @@ void drawHvkConstraint( const NifModel * nif, const QModelIndex & iConstraint, c
 		drawDashLine( pivotA, pivotA + axleA2, 14 );
 		drawCircle( pivotA, axleA, 1.0f );
 		drawSolidArc( pivotA, axleA / 5, axleA2, axleA1, minAngle, maxAngle, 1.0f );
-		glPopMatrix();
+		DebugDraw::popMatrix();
 
-		glPushMatrix();
-		glMultMatrix( tBodies.value( 1 ) );
+		DebugDraw::pushMatrix();
+		DebugDraw::multMatrix( tBodies.value( 1 ) );
 
 		if ( !Node::SELECTING )
-			glColor( color_b );
+			DebugDraw::color( color_b );
 
 		glBegin( GL_POINTS ); glVertex( pivotB ); glEnd();
 		glBegin( GL_LINES ); glVertex( pivotB ); glVertex( pivotB + axleB ); glEnd();
@@ -1188,13 +1220,13 @@ void drawHvkConstraint( const NifModel * nif, const QModelIndex & iConstraint, c
 		drawDashLine( pivotB + Vector3::crossproduct( axleB2, axleB ), pivotB, 14 );
 		drawCircle( pivotB, axleB, 1.01f );
 		drawSolidArc( pivotB, axleB / 7, axleB2, Vector3::crossproduct( axleB2, axleB ), minAngle, maxAngle, 1.01f );
-		glPopMatrix();
+		DebugDraw::popMatrix();
 
-		glMultMatrix( tBodies.value( 0 ) );
+		DebugDraw::multMatrix( tBodies.value( 0 ) );
 		float angle = Vector3::angle( tBodies.value( 0 ).rotation * axleA2, tBodies.value( 1 ).rotation * axleB2 );
 
 		if ( !Node::SELECTING )
-			glColor( color_a );
+			DebugDraw::color( color_a );
 
 		glBegin( GL_LINES );
 		glVertex( pivotA );
@@ -1241,22 +1273,22 @@ void drawHvkConstraint( const NifModel * nif, const QModelIndex & iConstraint, c
 		const float minAngle = (float)-PI;
 		const float maxAngle = (float)+PI;
 
-		glPushMatrix();
-		glMultMatrix( tBodies.value( 0 ) );
+		DebugDraw::pushMatrix();
+		DebugDraw::multMatrix( tBodies.value( 0 ) );
 
 		if ( !Node::SELECTING )
-			glColor( color_a );
+			DebugDraw::color( color_a );
 
 		glBegin( GL_POINTS ); glVertex( pivotA ); glEnd();
 		drawDashLine( pivotA, pivotA + axleA1 );
 		drawDashLine( pivotA, pivotA + axleA2 );
 		drawSolidArc( pivotA, axleA / 5, axleA2, axleA1, minAngle, maxAngle, 1.0f, 16 );
-		glPopMatrix();
+		DebugDraw::popMatrix();
 
-		glMultMatrix( tBodies.value( 1 ) );
+		DebugDraw::multMatrix( tBodies.value( 1 ) );
 
 		if ( !Node::SELECTING )
-			glColor( color_b );
+			DebugDraw::color( color_b );
 
 		glBegin( GL_POINTS ); glVertex( pivotB ); glEnd();
 		glBegin( GL_LINES ); glVertex( pivotB ); glVertex( pivotB + axleB ); glEnd();
@@ -1271,7 +1303,7 @@ void drawHvkConstraint( const NifModel * nif, const QModelIndex & iConstraint, c
 		const float length = nif->get<float>( iSpring, "Length" );
 
 		if ( !Node::SELECTING )
-			glColor( color_b );
+			DebugDraw::color( color_b );
 
 		drawSpring( pivotA, pivotB, length );
 	} else if ( name == "bhkRagdollConstraint" ) {
@@ -1299,37 +1331,37 @@ void drawHvkConstraint( const NifModel * nif, const QModelIndex & iConstraint, c
 		const float maxTwistAngle( nif->get<float>( iRagdoll, "Twist Max Angle" ) );
 		*/
 
-		glPushMatrix();
-		glMultMatrix( tBodies.value( 0 ) );
+		DebugDraw::pushMatrix();
+		DebugDraw::multMatrix( tBodies.value( 0 ) );
 
 		if ( !Node::SELECTING )
-			glColor( color_a );
+			DebugDraw::color( color_a );
 
-		glPopMatrix();
+		DebugDraw::popMatrix();
 
-		glPushMatrix();
-		glMultMatrix( tBodies.value( 0 ) );
+		DebugDraw::pushMatrix();
+		DebugDraw::multMatrix( tBodies.value( 0 ) );
 
 		if ( !Node::SELECTING )
-			glColor( color_a );
+			DebugDraw::color( color_a );
 
 		glBegin( GL_POINTS ); glVertex( pivotA ); glEnd();
 		glBegin( GL_LINES ); glVertex( pivotA ); glVertex( pivotA + twistA ); glEnd();
 		drawDashLine( pivotA, pivotA + planeA, 14 );
 		drawRagdollCone( pivotA, twistA, planeA, coneAngle, minPlaneAngle, maxPlaneAngle );
-		glPopMatrix();
+		DebugDraw::popMatrix();
 
-		glPushMatrix();
-		glMultMatrix( tBodies.value( 1 ) );
+		DebugDraw::pushMatrix();
+		DebugDraw::multMatrix( tBodies.value( 1 ) );
 
 		if ( !Node::SELECTING )
-			glColor( color_b );
+			DebugDraw::color( color_b );
 
 		glBegin( GL_POINTS ); glVertex( pivotB ); glEnd();
 		glBegin( GL_LINES ); glVertex( pivotB ); glVertex( pivotB + twistB ); glEnd();
 		drawDashLine( pivotB + planeB, pivotB, 14 );
 		drawRagdollCone( pivotB, twistB, planeB, coneAngle, minPlaneAngle, maxPlaneAngle );
-		glPopMatrix();
+		DebugDraw::popMatrix();
 	} else if ( name == "bhkPrismaticConstraint" ) {
 		const Vector3 pivotA( nif->get<Vector4>( iConstraint, "Pivot A" ) );
 		const Vector3 pivotB( nif->get<Vector4>( iConstraint, "Pivot B" ) );
@@ -1344,11 +1376,11 @@ void drawHvkConstraint( const NifModel * nif, const QModelIndex & iConstraint, c
 		const Vector3 d2 = pivotA + slidingAxis * maxDistance;
 
 		/* draw Pivot A and Plane */
-		glPushMatrix();
-		glMultMatrix( tBodies.value( 0 ) );
+		DebugDraw::pushMatrix();
+		DebugDraw::multMatrix( tBodies.value( 0 ) );
 
 		if ( !Node::SELECTING )
-			glColor( color_a );
+			DebugDraw::color( color_a );
 
 		glBegin( GL_POINTS ); glVertex( pivotA ); glEnd();
 		glBegin( GL_LINES ); glVertex( pivotA ); glVertex( pivotA + planeNormal ); glEnd();
@@ -1369,36 +1401,36 @@ void drawHvkConstraint( const NifModel * nif, const QModelIndex & iConstraint, c
 
 		t.translation = d1;
 		t.rotation.fromEuler( 0.0f, 0.0f, angle );
-		glMultMatrix( t );
+		DebugDraw::multMatrix( t );
 
 		angle = -asinf( slidingAxis[2] / slidingAxis.length() );
 		t.translation = Vector3( 0.0f, 0.0f, 0.0f );
 		t.rotation.fromEuler( 0.0f, angle, 0.0f );
-		glMultMatrix( t );
+		DebugDraw::multMatrix( t );
 
-		drawMarker( &BumperMarker01 );
+		scene->markers.draw( scene->renderer->fn, &BumperMarker01 );
 
 		/*draw second marker*/
 		t.translation = Vector3( minDistance < maxDistance ? ( d2 - d1 ).length() : 0.0f, 0.0f, 0.0f );
 		t.rotation.fromEuler( 0.0f, 0.0f, (float)PI );
-		glMultMatrix( t );
+		DebugDraw::multMatrix( t );
 
-		drawMarker( &BumperMarker01 );
-		glPopMatrix();
+		scene->markers.draw( scene->renderer->fn, &BumperMarker01 );
+		DebugDraw::popMatrix();
 
 		/* draw Pivot B */
-		glPushMatrix();
-		glMultMatrix( tBodies.value( 1 ) );
+		DebugDraw::pushMatrix();
+		DebugDraw::multMatrix( tBodies.value( 1 ) );
 
 		if ( !Node::SELECTING )
-			glColor( color_b );
+			DebugDraw::color( color_b );
 
 		glBegin( GL_POINTS ); glVertex( pivotB ); glEnd();
-		glPopMatrix();
+		DebugDraw::popMatrix();
 	}
 
-	glPopAttrib();
-	glPopMatrix();
+	DebugDraw::popAttrib();
+	DebugDraw::popMatrix();
 }
 
 void Node::drawHavok()
@@ -1429,24 +1461,24 @@ void Node::drawHavok()
 
 		Vector3 rad = nif->get<Vector3>( iBox, "Radius" );
 
-		glPushMatrix();
-		glLoadMatrix( scene->view );
+		DebugDraw::pushMatrix();
+		DebugDraw::loadMatrix( scene->view );
 		// The Morrowind construction set seems to completely ignore the node transform
 		//glMultMatrix( worldTrans() );
-		glMultMatrix( bt );
+		DebugDraw::multMatrix( bt );
 
 		if ( Node::SELECTING ) {
 			int s_nodeId = ID2COLORKEY( nodeId );
-			glColor4ubv( (GLubyte *)&s_nodeId );
+			DebugDraw::color( (GLubyte *)&s_nodeId );
 		} else {
-			glColor( Color3( 1.0f, 0.0f, 0.0f ) );
+			DebugDraw::color( Color3( 1.0f, 0.0f, 0.0f ) );
 			glDisable( GL_LIGHTING );
 		}
 
-		glLineWidth( 1.0f );
+		DebugDraw::lineWidth( 1.0f );
 		drawBox( rad, -rad );
 
-		glPopMatrix();
+		DebugDraw::popMatrix();
 	}
 
 	// Only Bethesda support after this
@@ -1462,9 +1494,9 @@ void Node::drawHavok()
 
 			Vector3 a, b;
 
-			glPushMatrix();
-			glLoadMatrix( scene->view );
-			glMultMatrix( worldTrans() );
+			DebugDraw::pushMatrix();
+			DebugDraw::loadMatrix( scene->view );
+			DebugDraw::multMatrix( worldTrans() );
 
 			// BSMultiBoundAABB
 			if ( nif->isNiBlock( iBSMultiBoundData, "BSMultiBoundAABB" ) ) {
@@ -1487,21 +1519,21 @@ void Node::drawHavok()
 				Transform t;
 				t.rotation = matrix;
 				t.translation = center;
-				glMultMatrix( t );
+				DebugDraw::multMatrix( t );
 			}
 			
 			if ( Node::SELECTING ) {
 				int s_nodeId = ID2COLORKEY( nif->getBlockNumber( iBSMultiBoundData ) );
-				glColor4ubv( (GLubyte *)&s_nodeId );
-				glLineWidth( 5 );
+				DebugDraw::color( (GLubyte *)&s_nodeId );
+				DebugDraw::lineWidth( 5 );
 			} else {
-				glColor( Color4( 1.0f, 1.0f, 1.0f, 0.6f ) );
+				DebugDraw::color( Color4( 1.0f, 1.0f, 1.0f, 0.6f ) );
 				glDisable( GL_LIGHTING );
-				glLineWidth( 1.0f );
+				DebugDraw::lineWidth( 1.0f );
 			}
 
 			drawBox( a, b );
-			glPopMatrix();
+			DebugDraw::popMatrix();
 		}
 	}
 
@@ -1518,23 +1550,23 @@ void Node::drawHavok()
 			Vector3 center = nif->get<Vector3>( iBound, "Center" );
 			Vector3 dim = nif->get<Vector3>( iBound, "Dimensions" );
 
-			glPushMatrix();
-			glLoadMatrix( scene->view );
+			DebugDraw::pushMatrix();
+			DebugDraw::loadMatrix( scene->view );
 			// Not sure if world transform is taken into account
-			glMultMatrix( worldTrans() );
+			DebugDraw::multMatrix( worldTrans() );
 
 			if ( Node::SELECTING ) {
 				int s_nodeId = ID2COLORKEY( nif->getBlockNumber( iBound ) );
-				glColor4ubv( (GLubyte *)&s_nodeId );
+				DebugDraw::color( (GLubyte *)&s_nodeId );
 			} else {
-				glColor( Color3( 1.0f, 0.0f, 0.0f ) );
+				DebugDraw::color( Color3( 1.0f, 0.0f, 0.0f ) );
 				glDisable( GL_LIGHTING );
 			}
 
-			glLineWidth( 1.0f );
+			DebugDraw::lineWidth( 1.0f );
 			drawBox( dim + center, -dim + center );
 
-			glPopMatrix();
+			DebugDraw::popMatrix();
 		}
 	}
 
@@ -1544,28 +1576,28 @@ void Node::drawHavok()
 
 	QModelIndex iBody = nif->getBlock( nif->getLink( iObject, "Body" ) );
 
-	glPushMatrix();
-	glLoadMatrix( scene->view );
-	glMultMatrix( scene->bhkBodyTrans.value( nif->getBlockNumber( iBody ) ) );
+	DebugDraw::pushMatrix();
+	DebugDraw::loadMatrix( scene->view );
+	DebugDraw::multMatrix( scene->bhkBodyTrans.value( nif->getBlockNumber( iBody ) ) );
 
 
 	//qDebug() << "draw obj" << nif->getBlockNumber( iObject ) << nif->itemName( iObject );
 
 	if ( !Node::SELECTING ) {
-		glEnable( GL_DEPTH_TEST );
-		glDepthMask( GL_TRUE );
-		glDepthFunc( GL_LEQUAL );
+		DebugDraw::enable( GL_DEPTH_TEST );
+		DebugDraw::depthMask( GL_TRUE );
+		DebugDraw::depthFunc( GL_LEQUAL );
 		glDisable( GL_TEXTURE_2D );
 		glDisable( GL_NORMALIZE );
 		glDisable( GL_LIGHTING );
 		glDisable( GL_COLOR_MATERIAL );
-		glEnable( GL_BLEND );
+		DebugDraw::enable( GL_BLEND );
 		glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
 		glDisable( GL_ALPHA_TEST );
 	}
 
-	glPointSize( 4.5 );
-	glLineWidth( 1.0 );
+	DebugDraw::pointSize( 4.5 );
+	DebugDraw::lineWidth( 1.0 );
 
 	static const float colors[8][3] = {
 		{ 0.0f, 1.0f, 0.0f },
@@ -1579,7 +1611,7 @@ void Node::drawHavok()
 	};
 
 	int color_index = nif->get<int>( iBody, "Layer" ) & 7;
-	glColor3fv( colors[ color_index ] );
+	DebugDraw::color( Color3( colors[color_index][0], colors[color_index][1], colors[color_index][2] ) );
 
 	if ( !Node::SELECTING ) {
 		if ( scene->currentBlock == nif->getBlock( nif->getLink( iBody, "Shape" ) ) ) {
@@ -1587,17 +1619,17 @@ void Node::drawHavok()
 			glHighlightColor(); // TODO: idea: I do not recommend mimicking the Open GL API
 			                    // It confuses the one who reads the code. And the Open GL API is
 			                    // in constant development.
-			glLineWidth( 2.5 );
+			DebugDraw::lineWidth( 2.5 );
 			//glPointSize( 8.5 );
 		}
 	}
 
-	QStack<QModelIndex> shapeStack;
+	QStack<int> shapeStack;
 
 	if ( Node::SELECTING )
-		glLineWidth( 5 ); // make selection click a little more easy
+		DebugDraw::lineWidth( 5 ); // make selection click a little more easy
 
-	drawHvkShape( nif, nif->getBlock( nif->getLink( iBody, "Shape" ) ), shapeStack, scene, colors[ color_index ] );
+	drawHvkShape( nif, nif->getLink( iBody, "Shape" ), shapeStack, scene, colors[ color_index ] );
 
 
 	// Scale up for Skyrim
@@ -1605,15 +1637,15 @@ void Node::drawHavok()
 
 	if ( Node::SELECTING && scene->options & Scene::ShowAxes ) {
 		int s_nodeId = ID2COLORKEY( nif->getBlockNumber( iBody ) );
-		glColor4ubv( (GLubyte *)&s_nodeId );
-		glDepthFunc( GL_ALWAYS );
+		DebugDraw::color( (GLubyte *)&s_nodeId );
+		DebugDraw::depthFunc( GL_ALWAYS );
 		drawAxes( Vector3( nif->get<Vector4>( iBody, "Center" ) ) * havokScale, 1.0f, false );
-		glDepthFunc( GL_LEQUAL );
+		DebugDraw::depthFunc( GL_LEQUAL );
 	} else if ( scene->options & Scene::ShowAxes ) {
 		drawAxes( Vector3( nif->get<Vector4>( iBody, "Center" ) ) * havokScale, 1.0f );
 	}
 
-	glPopMatrix();
+	DebugDraw::popMatrix();
 
 	for ( const auto l : nif->getLinkArray( iBody, "Constraints" ) ) {
 		QModelIndex iConstraint = nif->getBlock( l );
@@ -1623,7 +1655,7 @@ void Node::drawHavok()
 	}
 }
 
-void drawFurnitureMarker( const NifModel * nif, const QModelIndex & iPosition )
+void drawFurnitureMarker( const NifModel * nif, const QModelIndex & iPosition, Scene * scene )
 {
 	Vector3 offs = nif->get<Vector3>( iPosition, "Offset" );
 	quint16 orient = nif->get<quint16>( iPosition, "Orientation" );
@@ -1783,26 +1815,37 @@ void drawFurnitureMarker( const NifModel * nif, const QModelIndex & iPosition )
 	if ( Node::SELECTING ) {
 		GLint id = ( nif->getBlockNumber( iPosition ) & 0xffff ) | ( ( iPosition.row() & 0xffff ) << 16 );
 		int s_nodeId = ID2COLORKEY( id );
-		glColor4ubv( (GLubyte *)&s_nodeId );
+		DebugDraw::color( (GLubyte *)&s_nodeId );
 	}
 
+	Transform t;
+	t.rotation.fromEuler( 0, 0, roll );
+	t.translation = offs;
+	t.translation[0] += xOffset;
+	t.translation[1] += yOffset;
+	t.translation[2] += zOffset;
+
+	// One pass over the buffers of each distinct marker
 	for ( int n = 0; n < i; n++ ) {
-		glPushMatrix();
+		if ( !mark[n] )
+			continue;
 
-		Transform t;
-		t.rotation.fromEuler( 0, 0, roll );
-		t.translation = offs;
-		t.translation[0] += xOffset;
-		t.translation[1] += yOffset;
-		t.translation[2] += zOffset;
+		QVector<MarkerInstance> instances;
 
-		glMultMatrix( t );
+		for ( int m = n; m < i; m++ ) {
+			if ( mark[m] != mark[n] )
+				continue;
 
-		glScale( flip[n] );
+			MarkerInstance instance;
+			instance.transform = t;
+			instance.scale = flip[m];
+			instances << instance;
 
-		drawMarker( mark[n] );
+			if ( m > n )
+				mark[m] = nullptr;
+		}
 
-		glPopMatrix();
+		scene->markers.draw( scene->renderer->fn, mark[n], instances );
 	}
 }
 
@@ -1826,25 +1869,25 @@ void Node::drawFurn()
 		return;
 
 	if ( !Node::SELECTING ) {
-		glEnable( GL_DEPTH_TEST );
-		glDepthMask( GL_FALSE );
-		glDepthFunc( GL_LEQUAL );
+		DebugDraw::enable( GL_DEPTH_TEST );
+		DebugDraw::depthMask( GL_FALSE );
+		DebugDraw::depthFunc( GL_LEQUAL );
 		glDisable( GL_TEXTURE_2D );
 		glDisable( GL_NORMALIZE );
 		glDisable( GL_LIGHTING );
 		glDisable( GL_COLOR_MATERIAL );
-		glDisable( GL_CULL_FACE );
-		glDisable( GL_BLEND );
+		DebugDraw::disable( GL_CULL_FACE );
+		DebugDraw::disable( GL_BLEND );
 		glDisable( GL_ALPHA_TEST );
-		glColor4f( 1, 1, 1, 1 );
-		glPolygonMode( GL_FRONT_AND_BACK, GL_LINE );
+		DebugDraw::color( Color4( 1, 1, 1, 1 ) );
+		DebugDraw::polygonMode( GL_LINE );
 	}
 
-	glLineWidth( 1.0 );
+	DebugDraw::lineWidth( 1.0 );
 
-	glPushMatrix();
+	DebugDraw::pushMatrix();
 
-	glMultMatrix( viewTrans() );
+	DebugDraw::multMatrix( viewTrans() );
 
 	for ( int p = 0; p < nif->rowCount( iExtraDataList ); p++ ) {
 		// DONE: never seen Furn in nifs, so there may be a need of a fix here later - saw one, fixed a bug
@@ -1866,11 +1909,11 @@ void Node::drawFurn()
 			else
 				glNormalColor();
 
-			drawFurnitureMarker( nif, iPosition );
+			drawFurnitureMarker( nif, iPosition, scene );
 		}
 	}
 
-	glPopMatrix();
+	DebugDraw::popMatrix();
 }
 
 void Node::drawShapes( NodeList * secondPass, bool presort )
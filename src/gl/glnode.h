@@ -36,6 +36,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "gl/icontrollable.h" // Inherited
 #include "gl/glproperty.h"
 
+#include <QHash>
 #include <QList>
 #include <QPersistentModelIndex>
 #include <QPointer>
@@ -67,7 +68,8 @@ public:
 	const QVector<Node *> & list() const { return nodes; }
 
 	void sort();
-	void alphaSort();
+	//! Sorts back to front; ties keep the order of @p order, which is updated to the result
+	void alphaSort( QHash<const Node *, int> * order = nullptr );
 
 protected:
 	QVector<Node *> nodes;
@@ -34,8 +34,11 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "gl/controllers.h"
 #include "gl/glscene.h"
+#include "gl/renderer.h"
 #include "model/nifmodel.h"
 
+#include <algorithm>
+#include <cstddef>
 #include <math.h>
 
 
@@ -50,6 +53,7 @@ void Particles::clear()
 	verts.clear();
 	colors.clear();
 	transVerts.clear();
+	quads.clear();
 }
 
 void Particles::update( const NifModel * nif, const QModelIndex & index )
@@ -199,32 +203,54 @@ void Particles::drawShapes( NodeList * secondPass, bool presort )
 	 */
 
 	static const Vector2 tex[4] = {
-		Vector2( 1.0, 1.0 ), Vector2( 0.0, 1.0 ), Vector2( 1.0, 0.0 ), Vector2( 0.0, 0.0 )
+		Vector2( 1.0, 1.0 ), Vector2( 0.0, 1.0 ), Vector2( 0.0, 0.0 ), Vector2( 1.0, 0.0 )
 	};
+	static const Vector3 corner[4] = {
+		Vector3( +1, +1, 0 ), Vector3( -1, +1, 0 ), Vector3( -1, -1, 0 ), Vector3( +1, -1, 0 )
+	};
+
+	int count = std::min( active, transVerts.count() );
+	if ( count <= 0 )
+		return;
+
+	bool hasColors = colors.count() >= count;
+	float scale = size * worldTrans().scale;
+
+	quads.resize( count * 4 );
+	QuadVertex * q = quads.data();
 
-	int p = 0;
-	for ( Vector3 v : transVerts ) {
-		if ( p >= active )
-			break;
+	for ( int p = 0; p < count; p++ ) {
+		GLfloat s2 = ( sizes.count() > p ? sizes[ p ] * scale : scale );
+		const Vector3 & v = transVerts[p];
+		Color4 c = hasColors ? colors[p] : Color4();
 
-		GLfloat s2 = ( sizes.count() > p ? sizes[ p ] * size : size );
-		s2 *= worldTrans().scale;
+		for ( int i = 0; i < 4; i++, q++ ) {
+			q->position = v + corner[i] * s2;
+			q->texcoord = tex[i];
+			q->color = c;
+		}
+	}
 
-		glBegin( GL_TRIANGLE_STRIP );
+	// One draw call for all particles, streamed through a buffer shared by the particle systems
+	QOpenGLFunctions * fn = scene->renderer->fn;
+	scene->particleBuffer.upload( fn, quads.constData(), quads.count() * sizeof(QuadVertex) );
 
-		if ( p < colors.count() )
-			glColor( colors[ p ] );
+	glEnableClientState( GL_VERTEX_ARRAY );
+	glVertexPointer( 3, GL_FLOAT, sizeof(QuadVertex), (const GLvoid *)offsetof( QuadVertex, position ) );
 
-		glTexCoord( tex[0] );
-		glVertex( v + Vector3( +s2, +s2, 0 ) );
-		glTexCoord( tex[1] );
-		glVertex( v + Vector3( -s2, +s2, 0 ) );
-		glTexCoord( tex[2] );
-		glVertex( v + Vector3( +s2, -s2, 0 ) );
-		glTexCoord( tex[3] );
-		glVertex( v + Vector3( -s2, -s2, 0 ) );
-		glEnd();
+	glEnableClientState( GL_TEXTURE_COORD_ARRAY );
+	glTexCoordPointer( 2, GL_FLOAT, sizeof(QuadVertex), (const GLvoid *)offsetof( QuadVertex, texcoord ) );
 
-		p++;
+	if ( hasColors ) {
+		glEnableClientState( GL_COLOR_ARRAY );
+		glColorPointer( 4, GL_FLOAT, sizeof(QuadVertex), (const GLvoid *)offsetof( QuadVertex, color ) );
 	}
+
+	glDrawArrays( GL_QUADS, 0, quads.count() );
+
+	glDisableClientState( GL_VERTEX_ARRAY );
+	glDisableClientState( GL_TEXTURE_COORD_ARRAY );
+	glDisableClientState( GL_COLOR_ARRAY );
+
+	fn->glBindBuffer( GL_ARRAY_BUFFER, 0 );
 }
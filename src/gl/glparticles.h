@@ -69,6 +69,16 @@ protected:
 	QVector<float> sizes;
 	QVector<Vector3> transVerts;
 
+	//! Corner of a particle quad as streamed to the GPU
+	struct QuadVertex
+	{
+		Vector3 position;
+		Vector2 texcoord;
+		Color4 color;
+	};
+	//! Quads of the active particles, rebuilt every frame
+	QVector<QuadVertex> quads;
+
 	int active = 0;
 	float size = 0;
 };
@@ -0,0 +1,354 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+
+#include "glpicking.h"
+
+#include <QDebug>
+#include <QVarLengthArray>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+
+
+//! Maximum number of triangles in a leaf
+static const int LEAF_SIZE = 4;
+
+void TriangleTree::update( const QVector<Vector3> & verts, const QVector<Triangle> & tris )
+{
+	if ( verts.count() != numVerts )
+		state = Rebuild;
+
+	if ( state == Rebuild )
+		build( verts, tris );
+	else if ( state == Refit )
+		refit( verts, tris );
+
+	state = Valid;
+}
+
+void TriangleTree::clear()
+{
+	nodes.clear();
+	order.clear();
+	numVerts = 0;
+	state = Rebuild;
+}
+
+void TriangleTree::build( const QVector<Vector3> & verts, const QVector<Triangle> & tris )
+{
+	nodes.clear();
+	order.clear();
+
+	numVerts = verts.count();
+	QVector<Vector3> centers( tris.count() );
+	for ( int t = 0; t < tris.count(); t++ ) {
+		const Triangle & tri = tris.at( t );
+		if ( tri[0] >= numVerts || tri[1] >= numVerts || tri[2] >= numVerts )
+			continue;
+
+		order.append( t );
+		centers[t] = ( verts.at( tri[0] ) + verts.at( tri[1] ) + verts.at( tri[2] ) ) / 3.0f;
+	}
+
+	if ( order.isEmpty() )
+		return;
+
+	nodes.reserve( 2 * order.count() / LEAF_SIZE + 1 );
+
+	// Split at the median centroid along the widest axis, top down
+	std::function<void( int, int )> split = [&]( int first, int count ) {
+		int index = nodes.count();
+		nodes.append( { Vector3(), Vector3(), first, count, -1 } );
+
+		if ( count <= LEAF_SIZE )
+			return;
+
+		Vector3 lo = centers.at( order.at( first ) );
+		Vector3 hi = lo;
+		for ( int i = first + 1; i < first + count; i++ ) {
+			lo.boundMin( centers.at( order.at( i ) ) );
+			hi.boundMax( centers.at( order.at( i ) ) );
+		}
+
+		Vector3 size = hi - lo;
+		int axis = 0;
+		if ( size[1] > size[axis] )
+			axis = 1;
+		if ( size[2] > size[axis] )
+			axis = 2;
+
+		int half = count / 2;
+		std::nth_element( order.begin() + first, order.begin() + first + half, order.begin() + first + count,
+			[&centers, axis]( int a, int b ) { return centers.at( a )[axis] < centers.at( b )[axis]; }
+		);
+
+		split( first, half );
+		int second = nodes.count();
+		split( first + half, count - half );
+		nodes[index].second = second;
+	};
+
+	split( 0, order.count() );
+
+	refit( verts, tris );
+}
+
+void TriangleTree::refit( const QVector<Vector3> & verts, const QVector<Triangle> & tris )
+{
+	// Children always follow their parent
+	for ( int i = nodes.count() - 1; i >= 0; i-- ) {
+		Node & node = nodes[i];
+
+		if ( node.second < 0 ) {
+			const Triangle & tri = tris.at( order.at( node.first ) );
+			node.lo = node.hi = verts.at( tri[0] );
+
+			for ( int t = node.first; t < node.first + node.count; t++ ) {
+				const Triangle & other = tris.at( order.at( t ) );
+				for ( int v = 0; v < 3; v++ ) {
+					node.lo.boundMin( verts.at( other[v] ) );
+					node.hi.boundMax( verts.at( other[v] ) );
+				}
+			}
+		} else {
+			const Node & a = nodes.at( i + 1 );
+			const Node & b = nodes.at( node.second );
+			node.lo = a.lo;
+			node.hi = a.hi;
+			node.lo.boundMin( b.lo );
+			node.hi.boundMax( b.hi );
+		}
+	}
+}
+
+int TriangleTree::intersect( const QVector<Vector3> & verts, const QVector<Triangle> & tris,
+							 const Vector3 & origin, const Vector3 & dir, float & distance ) const
+{
+	if ( nodes.isEmpty() )
+		return -1;
+
+	const float inf = std::numeric_limits<float>::infinity();
+	Vector3 inv;
+	for ( int a = 0; a < 3; a++ )
+		inv[a] = ( dir[a] != 0.0f ) ? 1.0f / dir[a] : inf;
+
+	// Slab test; returns false if the box is missed or lies beyond the nearest hit so far
+	auto hitsBox = [&]( const Node & node ) {
+		float tmin = 0.0f;
+		float tmax = distance;
+		for ( int a = 0; a < 3; a++ ) {
+			if ( dir[a] == 0.0f ) {
+				if ( origin[a] < node.lo[a] || origin[a] > node.hi[a] )
+					return false;
+				continue;
+			}
+
+			float t0 = ( node.lo[a] - origin[a] ) * inv[a];
+			float t1 = ( node.hi[a] - origin[a] ) * inv[a];
+			if ( t0 > t1 )
+				std::swap( t0, t1 );
+
+			tmin = std::max( tmin, t0 );
+			tmax = std::min( tmax, t1 );
+			if ( tmin > tmax )
+				return false;
+		}
+		return true;
+	};
+
+	int hit = -1;
+
+	QVarLengthArray<int, 64> stack;
+	stack.append( 0 );
+	while ( !stack.isEmpty() ) {
+		int index = stack.last();
+		stack.removeLast();
+
+		const Node & node = nodes.at( index );
+		if ( !hitsBox( node ) )
+			continue;
+
+		if ( node.second >= 0 ) {
+			stack.append( node.second );
+			stack.append( index + 1 );
+			continue;
+		}
+
+		// Moller-Trumbore, both faces
+		for ( int i = node.first; i < node.first + node.count; i++ ) {
+			int t = order.at( i );
+			const Triangle & tri = tris.at( t );
+			const Vector3 & v0 = verts.at( tri[0] );
+			Vector3 e1 = verts.at( tri[1] ) - v0;
+			Vector3 e2 = verts.at( tri[2] ) - v0;
+
+			Vector3 p = Vector3::crossproduct( dir, e2 );
+			float det = Vector3::dotproduct( e1, p );
+			if ( std::fabs( det ) < 1e-12f )
+				continue;
+
+			float invDet = 1.0f / det;
+			Vector3 s = origin - v0;
+			float u = Vector3::dotproduct( s, p ) * invDet;
+			if ( u < 0.0f || u > 1.0f )
+				continue;
+
+			Vector3 q = Vector3::crossproduct( s, e1 );
+			float v = Vector3::dotproduct( dir, q ) * invDet;
+			if ( v < 0.0f || u + v > 1.0f )
+				continue;
+
+			float d = Vector3::dotproduct( e2, q ) * invDet;
+			if ( d > 0.0f && d < distance ) {
+				distance = d;
+				hit = t;
+			}
+		}
+	}
+
+	return hit;
+}
+
+int TriangleTree::nearestVertex( const QVector<Vector3> & verts, const Triangle & tri, const Vector3 & point )
+{
+	int vertex = tri[0];
+	for ( int v = 1; v < 3; v++ ) {
+		if ( ( verts.at( tri[v] ) - point ).squaredLength() < ( verts.at( vertex ) - point ).squaredLength() )
+			vertex = tri[v];
+	}
+
+	return vertex;
+}
+
+
+/*
+ *  Self check
+ */
+
+int TriangleTree::check()
+{
+	// A grid of N by N unit squares in the XY plane, two triangles each, deep enough for several levels
+	const int N = 8;
+	const float height = 5.0f;
+	const Vector3 down( 0, 0, -1 );
+
+	auto vertexAt = []( int x, int y ) { return y * (N + 1) + x; };
+
+	QVector<Vector3> verts;
+	for ( int y = 0; y <= N; y++ ) {
+		for ( int x = 0; x <= N; x++ )
+			verts << Vector3( x, y, 0 );
+	}
+
+	// Square (x, y) has triangle 2 * (y * N + x) below its diagonal and the next one above it
+	QVector<Triangle> tris;
+	for ( int y = 0; y < N; y++ ) {
+		for ( int x = 0; x < N; x++ ) {
+			tris << Triangle( vertexAt( x, y ), vertexAt( x + 1, y ), vertexAt( x + 1, y + 1 ) );
+			tris << Triangle( vertexAt( x, y ), vertexAt( x + 1, y + 1 ), vertexAt( x, y + 1 ) );
+		}
+	}
+
+	TriangleTree tree;
+	tree.update( verts, tris );
+
+	int failed = 0;
+
+	// Casts a ray and compares the triangle, nearest vertex and distance; -1 expects a miss
+	auto expect = [&]( const QString & name, const Vector3 & origin, const Vector3 & dir, float limit,
+					   int triangle, int vertex, float distance ) {
+		float d = limit;
+		int hit = tree.intersect( verts, tris, origin, dir, d );
+		int nearest = ( hit >= 0 ) ? nearestVertex( verts, tris.at( hit ), origin + dir * d ) : -1;
+
+		if ( hit == triangle && nearest == vertex && ( hit < 0 || std::fabs( d - distance ) < 1e-4f ) )
+			return;
+
+		qWarning().noquote() << QString( "%1: hit triangle %2, vertex %3 at %4; expected triangle %5, vertex %6 at %7" )
+			.arg( name ).arg( hit ).arg( nearest ).arg( d ).arg( triangle ).arg( vertex ).arg( distance );
+		failed++;
+	};
+
+	const float inf = std::numeric_limits<float>::infinity();
+
+	// Straight down onto both triangles of every square, near the corner off the diagonal
+	for ( int y = 0; y < N; y++ ) {
+		for ( int x = 0; x < N; x++ ) {
+			int t = 2 * (y * N + x);
+			expect( QString( "Below diagonal of %1,%2" ).arg( x ).arg( y ), Vector3( x + 0.75f, y + 0.25f, height ),
+					down, inf, t, vertexAt( x + 1, y ), height );
+			expect( QString( "Above diagonal of %1,%2" ).arg( x ).arg( y ), Vector3( x + 0.25f, y + 0.75f, height ),
+					down, inf, t + 1, vertexAt( x, y + 1 ), height );
+		}
+	}
+
+	// A slanted ray; the direction is not normalized, so the distance is in multiples of it
+	expect( "Slanted", Vector3( 0.75f, 0.25f, height ), Vector3( 1, 1, -2 ), inf,
+			2 * (2 * N + 3) + 1, vertexAt( 3, 3 ), height / 2 );
+
+	expect( "Outside the grid", Vector3( -1, -1, height ), down, inf, -1, -1, 0 );
+	expect( "Facing away", Vector3( 0.75f, 0.25f, height ), -down, inf, -1, -1, 0 );
+	expect( "Beyond the limit", Vector3( 0.75f, 0.25f, height ), down, height - 1, -1, -1, 0 );
+	expect( "From below", Vector3( 0.75f, 0.25f, -height ), -down, inf, 0, vertexAt( 1, 0 ), height );
+
+	// Moved vertices refit the boxes; stale boxes would miss the grid moved aside
+	const Vector3 offset( 100, 0, -2 );
+	for ( Vector3 & v : verts )
+		v += offset;
+
+	// Lift one corner, which tilts the triangles around it
+	verts[vertexAt( 4, 4 )][2] = 3;
+
+	tree.invalidateVertices();
+	tree.update( verts, tris );
+
+	expect( "Moved", offset + Vector3( 1.75f, 1.25f, height ), down, inf,
+			2 * (N + 1), vertexAt( 2, 1 ), height );
+	expect( "Tilted", Vector3( 104.25f, 4.75f, height ), down, inf,
+			2 * (4 * N + 4) + 1, vertexAt( 4, 5 ), height + 0.75f );
+	expect( "Old position", Vector3( 1.75f, 1.25f, height ), down, inf, -1, -1, 0 );
+
+	// New triangles rebuild the tree: only the first square is left
+	tris.resize( 2 );
+	tree.invalidate();
+	tree.update( verts, tris );
+
+	expect( "Kept", offset + Vector3( 0.25f, 0.75f, height ), down, inf, 1, vertexAt( 0, 1 ), height );
+	expect( "Removed", offset + Vector3( 1.75f, 1.25f, height ), down, inf, -1, -1, 0 );
+
+	qInfo() << "TriangleTree:" << failed << "failed checks";
+
+	return failed;
+}
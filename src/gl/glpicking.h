@@ -0,0 +1,117 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+
+#ifndef GLPICKING_H
+#define GLPICKING_H
+
+#include "gl/gltools.h"
+
+#include <QVector>
+
+
+//! @file glpicking.h TriangleTree
+
+/*! Bounding volume hierarchy over the triangles of a shape, for casting rays
+ *
+ * The tree is built over axis aligned boxes of the triangles, split at the median
+ * centroid of the widest axis down to a few triangles per leaf. It does not keep the
+ * arrays it was built from; the owner passes them in and invalidates the tree when
+ * they change: new triangles rebuild the tree, while new positions for the same
+ * triangles (animation, skinning) only refit the boxes bottom up.
+ */
+class TriangleTree final
+{
+public:
+	//! Marks the tree for a rebuild, after the triangles changed
+	void invalidate() { state = Rebuild; }
+	//! Marks the boxes for a refit, after the vertices moved
+	void invalidateVertices() { if ( state == Valid ) state = Refit; }
+
+	//! Rebuilds or refits the tree if invalidated; a new vertex count rebuilds it too
+	void update( const QVector<Vector3> & verts, const QVector<Triangle> & triangles );
+	//! Drops the tree
+	void clear();
+
+	/*! Finds the nearest triangle hit by a ray
+	 *
+	 * @param verts		The vertices the tree was last updated with
+	 * @param triangles	The triangles the tree was last updated with
+	 * @param origin	The ray origin
+	 * @param dir		The ray direction; hits are measured in multiples of it
+	 * @param distance	Hits beyond it are ignored; set to the distance of the hit
+	 * @return			The index of the triangle hit, -1 if none
+	 */
+	int intersect( const QVector<Vector3> & verts, const QVector<Triangle> & triangles,
+				   const Vector3 & origin, const Vector3 & dir, float & distance ) const;
+
+	//! The vertex of a triangle nearest to a point, such as the point hit by a ray
+	static int nearestVertex( const QVector<Vector3> & verts, const Triangle & triangle, const Vector3 & point );
+
+	/*! Casts known rays against a grid of triangles and checks the results
+	 *
+	 * Checks the triangle hit, its nearest vertex and the distance, misses, and the
+	 * results after moving the vertices and refitting, and after new triangles.
+	 * Prints every failed check.
+	 *
+	 * @return			The number of failed checks
+	 */
+	static int check();
+
+private:
+	struct Node
+	{
+		Vector3 lo, hi;
+		//! Range of the node's triangles in order
+		int first, count;
+		//! Index of the second child, -1 for leaves; the first child follows its parent
+		int second;
+	};
+
+	enum State
+	{
+		Valid,
+		Refit,
+		Rebuild
+	};
+
+	void build( const QVector<Vector3> & verts, const QVector<Triangle> & tris );
+	void refit( const QVector<Vector3> & verts, const QVector<Triangle> & tris );
+
+	QVector<Node> nodes;
+	QVector<int> order;
+	//! Vertex count the tree was built for
+	int numVerts = 0;
+	State state = Rebuild;
+};
+
+#endif
@@ -0,0 +1,212 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+
+#include "glprofiler.h"
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStringList>
+
+#include <algorithm>
+
+
+//! @file glprofiler.cpp FrameProfiler
+
+//! Number of frames kept for export
+static const int MAX_FRAMES = 600;
+//! Number of frames averaged by the summary
+static const int SUMMARY_FRAMES = 60;
+//! Maximum number of events kept per frame; later stages only add to the totals
+static const int MAX_EVENTS = 4096;
+
+FrameProfiler::FrameProfiler()
+{
+	timer.start();
+}
+
+void FrameProfiler::setEnabled( bool enable )
+{
+	if ( enable && !enabled ) {
+		frames.clear();
+		next = 0;
+	}
+
+	enabled = enable;
+}
+
+void FrameProfiler::beginFrame()
+{
+	if ( !enabled )
+		return;
+
+	current = Frame();
+	current.start = timer.nsecsElapsed();
+	recording = true;
+}
+
+void FrameProfiler::endFrame()
+{
+	if ( !recording )
+		return;
+
+	recording = false;
+	current.duration = timer.nsecsElapsed() - current.start;
+
+	if ( frames.count() < MAX_FRAMES ) {
+		frames.append( current );
+	} else {
+		frames[next] = current;
+		next = (next + 1) % MAX_FRAMES;
+	}
+}
+
+void FrameProfiler::record( Stage stage, qint64 start, qint64 duration )
+{
+	current.stageTime[stage] += duration;
+
+	if ( current.events.count() < MAX_EVENTS )
+		current.events.append( { stage, start, duration } );
+}
+
+QString FrameProfiler::stageName( Stage stage )
+{
+	switch ( stage ) {
+	case Controllers:
+		return "Controllers";
+	case Transform:
+		return "Transform";
+	case Skinning:
+		return "Skinning";
+	case Sorting:
+		return "Sorting";
+	case SetupProgram:
+		return "Setup Program";
+	case Draw:
+		return "Draw";
+	case Selection:
+		return "Selection";
+	default:
+		return QString();
+	}
+}
+
+QString FrameProfiler::counterName( Counter counter )
+{
+	switch ( counter ) {
+	case DrawCalls:
+		return "Draw Calls";
+	case Vertices:
+		return "Vertices";
+	case TextureBinds:
+		return "Texture Binds";
+	case ProgramSwitches:
+		return "Program Switches";
+	default:
+		return QString();
+	}
+}
+
+QString FrameProfiler::textSummary() const
+{
+	int count = std::min( frames.count(), SUMMARY_FRAMES );
+	if ( count == 0 )
+		return QString();
+
+	double frameTime = 0;
+	double stageTime[NumStages] = {};
+	double counters[NumCounters] = {};
+
+	// The last frames, newest first
+	for ( int i = 1; i <= count; i++ ) {
+		const Frame & f = frames.at( (next - i + frames.count()) % frames.count() );
+
+		frameTime += f.duration;
+		for ( int s = 0; s < NumStages; s++ )
+			stageTime[s] += f.stageTime[s];
+		for ( int c = 0; c < NumCounters; c++ )
+			counters[c] += f.counters[c];
+	}
+
+	QStringList lines;
+	lines << QString( "Frame: %1 ms" ).arg( frameTime / count / 1e6, 0, 'f', 2 );
+
+	for ( int s = 0; s < NumStages; s++ )
+		lines << QString( "%1: %2 ms" ).arg( stageName( Stage( s ) ) ).arg( stageTime[s] / count / 1e6, 0, 'f', 2 );
+
+	for ( int c = 0; c < NumCounters; c++ )
+		lines << QString( "%1: %2" ).arg( counterName( Counter( c ) ) ).arg( qRound( counters[c] / count ) );
+
+	return lines.join( "\n" );
+}
+
+bool FrameProfiler::exportTrace( const QString & fname ) const
+{
+	QJsonArray events;
+
+	auto complete = []( const QString & name, qint64 start, qint64 duration ) {
+		return QJsonObject{
+			{ "name", name }, { "cat", "render" }, { "ph", "X" },
+			{ "ts", start / 1e3 }, { "dur", duration / 1e3 },
+			{ "pid", 1 }, { "tid", 1 }
+		};
+	};
+
+	// Oldest frame first
+	for ( int i = 0; i < frames.count(); i++ ) {
+		const Frame & f = frames.at( (next + i) % frames.count() );
+
+		events.append( complete( "Frame", f.start, f.duration ) );
+
+		for ( const Event & e : f.events )
+			events.append( complete( stageName( e.stage ), e.start, e.duration ) );
+
+		QJsonObject args;
+		for ( int c = 0; c < NumCounters; c++ )
+			args.insert( counterName( Counter( c ) ), f.counters[c] );
+
+		events.append( QJsonObject{
+			{ "name", "Counters" }, { "ph", "C" }, { "ts", f.start / 1e3 },
+			{ "pid", 1 }, { "args", args }
+		} );
+	}
+
+	QJsonObject trace{ { "traceEvents", events }, { "displayTimeUnit", "ms" } };
+
+	QFile file( fname );
+	if ( !file.open( QIODevice::WriteOnly ) )
+		return false;
+
+	return file.write( QJsonDocument( trace ).toJson( QJsonDocument::Compact ) ) > 0;
+}
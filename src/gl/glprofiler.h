@@ -0,0 +1,154 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+
+#ifndef GLPROFILER_H
+#define GLPROFILER_H
+
+#include <QElapsedTimer>
+#include <QString>
+#include <QVector>
+
+
+//! @file glprofiler.h FrameProfiler
+
+/*! CPU time and counters of the frames drawn by a scene
+ *
+ * A frame is recorded between beginFrame() and endFrame(). Within it, each
+ * FrameProfiler::Scope adds its time to a stage; stages nest, so the time of
+ * a stage includes the stages run inside it. The last frames are kept for the
+ * overlay summary and for export as a Chrome trace, which can be opened in
+ * chrome://tracing or Perfetto.
+ */
+class FrameProfiler final
+{
+public:
+	enum Stage
+	{
+		Controllers,
+		Transform,
+		Skinning,
+		Sorting,
+		SetupProgram,
+		Draw,
+		Selection,
+		NumStages
+	};
+
+	enum Counter
+	{
+		DrawCalls,
+		Vertices,
+		TextureBinds,
+		ProgramSwitches,
+		NumCounters
+	};
+
+	//! Times a stage from construction to destruction
+	class Scope final
+	{
+	public:
+		Scope( FrameProfiler & profiler, Stage stage )
+			: profiler( profiler.recording ? &profiler : nullptr ), stage( stage )
+		{
+			if ( this->profiler )
+				start = profiler.timer.nsecsElapsed();
+		}
+
+		~Scope()
+		{
+			if ( profiler )
+				profiler->record( stage, start, profiler->timer.nsecsElapsed() - start );
+		}
+
+	private:
+		FrameProfiler * profiler;
+		Stage stage;
+		qint64 start = 0;
+	};
+
+	FrameProfiler();
+
+	//! Starts or stops recording frames; starting drops the frames recorded before
+	void setEnabled( bool enable );
+	bool isEnabled() const { return enabled; }
+
+	void beginFrame();
+	void endFrame();
+
+	//! Adds to a counter of the current frame
+	void count( Counter counter, int n = 1 )
+	{
+		if ( recording )
+			current.counters[counter] += n;
+	}
+
+	//! Frame time, stage times and counters averaged over the last frames
+	QString textSummary() const;
+	//! Writes the recorded frames as Chrome trace event JSON
+	bool exportTrace( const QString & fname ) const;
+
+	static QString stageName( Stage stage );
+	static QString counterName( Counter counter );
+
+private:
+	//! A timed stage, in nanoseconds since the profiler was created
+	struct Event
+	{
+		Stage stage;
+		qint64 start;
+		qint64 duration;
+	};
+
+	struct Frame
+	{
+		qint64 start = 0;
+		qint64 duration = 0;
+		qint64 stageTime[NumStages] = {};
+		int counters[NumCounters] = {};
+		QVector<Event> events;
+	};
+
+	void record( Stage stage, qint64 start, qint64 duration );
+
+	bool enabled = false;
+	bool recording = false;
+
+	QElapsedTimer timer;
+
+	Frame current;
+	//! Ring buffer of the last frames, oldest at next once full
+	QVector<Frame> frames;
+	int next = 0;
+};
+
+#endif
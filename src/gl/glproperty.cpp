@@ -330,6 +330,10 @@ void TexturingProperty::update( const NifModel * nif, const QModelIndex & proper
 			if ( iTex.isValid() ) {
 				textures[t].iSource  = nif->getBlock( nif->getLink( iTex, "Source" ), "NiSourceTexture" );
 				textures[t].coordset = nif->get<int>( iTex, "UV Set" );
+
+				if ( textures[t].iSource.isValid() && nif->get<quint8>( textures[t].iSource, "Use External" ) != 0 )
+					scene->prefetchTexture( fileName( t ) );
+
 				int filterMode = 0, clampMode = 0;
 
 				if ( nif->checkVersion( 0, 0x14010002 ) ) {
@@ -862,6 +866,11 @@ void BSShaderLightingProperty::update( const NifModel * nif, const QModelIndex &
 			iSourceTexture = iBlock;
 
 		iWetMaterial = nif->getIndex( iBlock, "Wet Material" );
+
+		if ( iTextureSet.isValid() ) {
+			for ( const QString & tex : nif->getArray<QString>( iTextureSet, "Textures" ) )
+				scene->prefetchTexture( tex );
+		}
 	}
 }
 
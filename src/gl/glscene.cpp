@@ -44,8 +44,13 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <QAction>
 #include <QOpenGLContext>
 #include <QOpenGLFunctions>
+#include <QSet>
 #include <QSettings>
 
+#include <algorithm>
+#include <functional>
+#include <limits>
+
 
 //! \file glscene.cpp %Scene management
 
@@ -99,6 +104,11 @@ Scene::Scene( TexCache * texcache, QOpenGLContext * context, QOpenGLFunctions *
 
 Scene::~Scene()
 {
+	// Shapes release their buffer objects through the renderer
+	clear();
+
+	markers.release( renderer->fn );
+	particleBuffer.release( renderer->fn );
 	delete renderer;
 }
 
@@ -114,6 +124,17 @@ void Scene::clear( bool flushTextures )
 	properties.clear();
 	roots.clear();
 	shapes.clear();
+	alphaOrder.clear();
+	cullTree.clear();
+	cullShapes.clear();
+	for ( int block : geometry.keys() )
+		releaseGeometry( block );
+	releaseHavokShapes( -1 );
+	debugDraw.release( renderer->fn );
+	dependents.clear();
+	dependentLinks.clear();
+	dependentsValid = false;
+	invalidateNodes();
 
 	animGroups.clear();
 	animTags.clear();
@@ -135,14 +156,49 @@ void Scene::update( const NifModel * nif, const QModelIndex & index )
 		if ( !block.isValid() )
 			return;
 
-		for ( Property * prop : properties.list() ) {
-			prop->update( nif, block );
-		}
+		int blockNumber = nif->getBlockNumber( block );
+		releaseGeometry( blockNumber );
+		releaseHavokShapes( blockNumber );
 
-		for ( Node * node : nodes.list() ) {
-			node->update( nif, block );
+		if ( !dependentsValid )
+			buildDependents( nif );
+
+		auto it = dependents.constFind( blockNumber );
+		if ( it != dependents.constEnd() ) {
+			// Only the nodes and properties linking to the block read it
+			const Dependents deps = it.value();
+			int nodeCount = nodes.list().count();
+			int propertyCount = properties.list().count();
+
+			for ( Property * prop : deps.properties ) {
+				prop->update( nif, block );
+			}
+
+			for ( Node * node : deps.nodes ) {
+				node->update( nif, block );
+			}
+
+			// Unchanged links cannot have reparented or created anything
+			if ( nif->getChildLinks( blockNumber ) == dependentLinks.value( blockNumber )
+				&& nodes.list().count() == nodeCount && properties.list().count() == propertyCount )
+			{
+				timeBoundsValid = false;
+				return;
+			}
+		} else {
+			for ( Property * prop : properties.list() ) {
+				prop->update( nif, block );
+			}
+
+			for ( Node * node : nodes.list() ) {
+				node->update( nif, block );
+			}
 		}
 	} else {
+		for ( int block : geometry.keys() )
+			releaseGeometry( block );
+		releaseHavokShapes( -1 );
+
 		properties.validate();
 		nodes.validate();
 
@@ -169,6 +225,10 @@ void Scene::update( const NifModel * nif, const QModelIndex & index )
 		}
 	}
 
+	// Node::update() may have reparented or replaced any node
+	invalidateNodes();
+	dependentsValid = false;
+
 	timeBoundsValid = false;
 }
 
@@ -268,11 +328,81 @@ Node * Scene::getNode( const NifModel * nif, const QModelIndex & iNode )
 	if ( node ) {
 		nodes.add( node );
 		node->update( nif, iNode );
+		invalidateNodes();
 	}
 
 	return node;
 }
 
+Node * Scene::findNode( int id ) const
+{
+	if ( !nodeIdsValid ) {
+		nodeIds.clear();
+		for ( Node * node : nodes.list() )
+			nodeIds.insert( node->id(), node );
+
+		nodeIdsValid = true;
+	}
+
+	return nodeIds.value( id );
+}
+
+void Scene::invalidateNodes()
+{
+	nodeIdsValid = false;
+	revision++;
+}
+
+void Scene::buildDependents( const NifModel * nif )
+{
+	dependents.clear();
+	dependentLinks.clear();
+
+	QHash<int, bool> isObject;
+	QVector<int> stack;
+	QSet<int> visited;
+
+	// Collects the blocks an object reads: its own and the ones it links to, short of other objects
+	auto collect = [&]( const QModelIndex & iBlock, std::function<void( Dependents & )> add ) {
+		int root = nif->getBlockNumber( iBlock );
+		if ( root < 0 )
+			return;
+
+		visited.clear();
+		stack.append( root );
+		while ( !stack.isEmpty() ) {
+			int b = stack.takeLast();
+			if ( visited.contains( b ) )
+				continue;
+
+			visited.insert( b );
+
+			if ( b != root ) {
+				auto o = isObject.constFind( b );
+				if ( o == isObject.constEnd() )
+					o = isObject.insert( b, nif->inherits( nif->getBlock( b ), "NiAVObject" ) );
+				if ( o.value() )
+					continue;
+			}
+
+			add( dependents[b] );
+
+			QList<int> links = nif->getChildLinks( b );
+			dependentLinks.insert( b, links );
+			for ( int l : links )
+				stack.append( l );
+		}
+	};
+
+	for ( Property * prop : properties.list() )
+		collect( prop->index(), [prop]( Dependents & d ) { d.properties.append( prop ); } );
+
+	for ( Node * node : nodes.list() )
+		collect( node->index(), [node]( Dependents & d ) { d.nodes.append( node ); } );
+
+	dependentsValid = true;
+}
+
 Property * Scene::getProperty( const NifModel * nif, const QModelIndex & iProperty )
 {
 	Property * prop = properties.get( iProperty );
@@ -304,6 +434,8 @@ void Scene::setSequence( const QString & seqname )
 
 void Scene::transform( const Transform & trans, float time )
 {
+	FrameProfiler::Scope scope( profiler, FrameProfiler::Transform );
+
 	view = trans;
 	this->time = time;
 
@@ -321,6 +453,8 @@ void Scene::transform( const Transform & trans, float time )
 		node->transformShapes();
 	}
 
+	refitCullTree();
+
 	sceneBoundsValid = false;
 
 	// TODO: purge unused textures
@@ -328,8 +462,13 @@ void Scene::transform( const Transform & trans, float time )
 
 void Scene::draw()
 {
+	FrameProfiler::Scope scope( profiler, FrameProfiler::Draw );
+
 	drawShapes();
 
+	// Debug primitives are flushed before the selection so its highlights stay on top
+	debugDraw.begin();
+
 	if ( options & ShowNodes )
 		drawNodes();
 	if ( options & ShowCollision )
@@ -337,22 +476,49 @@ void Scene::draw()
 	if ( options & ShowMarkers )
 		drawFurn();
 
-	drawSelection();
+	debugDraw.end( renderer->fn );
+
+	{
+		FrameProfiler::Scope selection( profiler, FrameProfiler::Selection );
+		debugDraw.begin();
+		drawSelection();
+		debugDraw.end( renderer->fn );
+	}
+
+	profiler.count( FrameProfiler::TextureBinds, textures->bindCount );
+	profiler.count( FrameProfiler::ProgramSwitches, renderer->stats.programSwitches );
 }
 
 void Scene::drawShapes()
 {
+	renderer->stats = Renderer::Stats();
+	textures->bindCount = 0;
+	textures->uploadLoaded();
+
+	cull();
+
 	if ( options & DoBlending ) {
 		NodeList secondPass;
 
+		queueing = true;
 		for ( Node * node : roots.list() ) {
 			node->drawShapes( &secondPass );
 		}
+		queueing = false;
+
+		drawQueue();
 
-		if ( secondPass.list().count() > 0 )
+		if ( secondPass.list().count() > 0 ) {
+			FrameProfiler::Scope selection( profiler, FrameProfiler::Selection );
+			debugDraw.begin();
 			drawSelection(); // for transparency pass
+			debugDraw.end( renderer->fn );
+		}
 
-		secondPass.alphaSort();
+		{
+			FrameProfiler::Scope sorting( profiler, FrameProfiler::Sorting );
+			secondPass.alphaSort( &alphaOrder );
+		}
 
 		for ( Node * node : secondPass.list() ) {
 			node->drawShapes();
@@ -364,6 +530,315 @@ void Scene::drawShapes()
 	}
 }
 
+bool Scene::enqueue( Shape * shape )
+{
+	if ( !queueing )
+		return false;
+
+	opaqueQueue.append( shape );
+	return true;
+}
+
+void Scene::drawQueue()
+{
+	struct DrawItem
+	{
+		Shape * shape;
+		const Property * material;
+		float depth;
+	};
+
+	QVector<DrawItem> items;
+	items.reserve( opaqueQueue.count() );
+	for ( Shape * shape : opaqueQueue ) {
+		const Property * material = shape->bssp;
+		if ( !material )
+			material = shape->findProperty<TexturingProperty>();
+
+		items.append( { shape, material, shape->viewDepth() } );
+	}
+	opaqueQueue.clear();
+
+	// Group by the program and textures of the last frame, then front to back
+	{
+		FrameProfiler::Scope sorting( profiler, FrameProfiler::Sorting );
+
+		std::stable_sort( items.begin(), items.end(), []( const DrawItem & a, const DrawItem & b ) {
+			if ( a.shape->shader != b.shape->shader )
+				return a.shape->shader < b.shape->shader;
+			if ( a.material != b.material )
+				return a.material < b.material;
+
+			return a.depth > b.depth;
+		} );
+	}
+
+	// Vertex selection draws points with the fixed function pipeline after each shape
+	bool batch = !Node::SELECTING && !(selMode & SelVertex);
+	if ( batch )
+		renderer->beginBatch();
+
+	for ( const DrawItem & item : items )
+		item.shape->drawShapes();
+
+	if ( batch )
+		renderer->endBatch();
+
+	renderer->stats.drawItems += items.count();
+}
+
+const SharedGeometry * Scene::findGeometry( int block ) const
+{
+	auto it = geometry.constFind( block );
+	if ( it == geometry.constEnd() )
+		return nullptr;
+
+	return &it.value();
+}
+
+const SharedGeometry * Scene::addGeometry( int block, const SharedGeometry & shared )
+{
+	releaseGeometry( block );
+
+	SharedGeometry & g = geometry[block];
+	g = shared;
+	g.coordBuffers.resize( g.coords.count() );
+
+	return &g;
+}
+
+void Scene::releaseGeometry( int block )
+{
+	auto it = geometry.find( block );
+	if ( it == geometry.end() )
+		return;
+
+	// Shapes still holding the buffer objects delete them when they release theirs
+	QOpenGLFunctions * fn = renderer->fn;
+	SharedGeometry & g = it.value();
+	g.vertBuffer.release( fn );
+	g.normBuffer.release( fn );
+	g.colorBuffer.release( fn );
+	g.tangentBuffer.release( fn );
+	g.bitangentBuffer.release( fn );
+	for ( auto & b : g.coordBuffers )
+		b.release( fn );
+	g.triangleBuffer.release( fn );
+
+	geometry.erase( it );
+}
+
+HavokShape * Scene::findHavokShape( int block )
+{
+	auto it = havokShapes.find( block );
+	if ( it == havokShapes.end() )
+		return nullptr;
+
+	return &it.value();
+}
+
+HavokShape * Scene::addHavokShape( int block, const HavokShape & shape )
+{
+	releaseHavokShapes( block );
+
+	HavokShape & s = havokShapes[block];
+	s = shape;
+
+	return &s;
+}
+
+void Scene::releaseHavokShapes( int block )
+{
+	for ( auto it = havokShapes.begin(); it != havokShapes.end(); ) {
+		if ( block < 0 || it.key() == block || it.value().dataBlocks.contains( block ) ) {
+			it.value().buffer.release( renderer->fn );
+			it = havokShapes.erase( it );
+		} else {
+			++it;
+		}
+	}
+}
+
+void Scene::buildCullTree()
+{
+	struct Item
+	{
+		Vector3 center;
+		Shape * shape;
+	};
+
+	std::vector<Item> items;
+	items.reserve( shapes.count() );
+	for ( Shape * shape : shapes )
+		items.push_back( { shape->bounds().center, shape } );
+
+	cullTree.clear();
+	cullTree.reserve( 2 * shapes.count() );
+
+	// Split at the median center along the widest axis, top down
+	std::function<int( int, int )> build = [&]( int first, int count ) {
+		int index = cullTree.count();
+		cullTree.append( { BoundSphere(), first, count, -1 } );
+
+		if ( count > 1 ) {
+			Vector3 lo = items[first].center;
+			Vector3 hi = lo;
+			for ( int i = first + 1; i < first + count; i++ ) {
+				lo.boundMin( items[i].center );
+				hi.boundMax( items[i].center );
+			}
+
+			Vector3 size = hi - lo;
+			int axis = 0;
+			if ( size[1] > size[axis] )
+				axis = 1;
+			if ( size[2] > size[axis] )
+				axis = 2;
+
+			int half = count / 2;
+			std::nth_element( items.begin() + first, items.begin() + first + half, items.begin() + first + count,
+				[axis]( const Item & a, const Item & b ) { return a.center[axis] < b.center[axis]; }
+			);
+
+			build( first, half );
+			int second = build( first + half, count - half );
+			cullTree[index].second = second;
+		}
+
+		return index;
+	};
+
+	if ( !items.empty() )
+		build( 0, int( items.size() ) );
+
+	cullShapes.clear();
+	cullShapes.reserve( int( items.size() ) );
+	for ( const Item & item : items )
+		cullShapes.append( item.shape );
+
+	cullRevision = revision;
+}
+
+void Scene::refitCullTree()
+{
+	if ( cullRevision != revision )
+		buildCullTree();
+
+	// Children always follow their parent
+	for ( int i = cullTree.count() - 1; i >= 0; i-- ) {
+		CullNode & node = cullTree[i];
+
+		if ( node.count == 1 ) {
+			node.bounds = cullShapes[node.first]->bounds();
+			continue;
+		}
+
+		const BoundSphere & a = cullTree[i + 1].bounds;
+		const BoundSphere & b = cullTree[node.second].bounds;
+
+		// Shapes without bounds are never culled, so neither are their parents
+		if ( a.radius < 0 || b.radius < 0 ) {
+			node.bounds = BoundSphere();
+		} else {
+			node.bounds = a;
+			node.bounds |= b;
+		}
+	}
+}
+
+void Scene::cull()
+{
+	for ( Shape * shape : shapes )
+		shape->culled = false;
+
+	// The hierarchy is refit by transform(); skip culling until then
+	if ( cullRevision != revision || cullTree.isEmpty() )
+		return;
+
+	Frustum frustum = Frustum::fromProjection( view, Node::SELECTING ? pickWindow : QRect() );
+
+	QVector<int> stack;
+	stack.append( 0 );
+	while ( !stack.isEmpty() ) {
+		int index = stack.takeLast();
+		const CullNode & node = cullTree.at( index );
+
+		switch ( frustum.contains( node.bounds ) ) {
+		case Frustum::Outside:
+			for ( int i = node.first; i < node.first + node.count; i++ )
+				cullShapes[i]->culled = true;
+
+			renderer->stats.culledShapes += node.count;
+			break;
+		case Frustum::Intersects:
+			if ( node.count > 1 ) {
+				stack.append( node.second );
+				stack.append( index + 1 );
+			}
+			break;
+		case Frustum::Inside:
+			break;
+		}
+	}
+}
+
+Scene::Hit Scene::pick( const Vector3 & origin, const Vector3 & dir )
+{
+	Hit hit;
+	hit.distance = std::numeric_limits<float>::max();
+
+	if ( view.scale == 0.0f )
+		return hit;
+
+	auto castRay = [&]( Shape * shape ) {
+		if ( shape->isHidden() )
+			return;
+		if ( !(options & ShowMarkers) && shape->name.contains( "EditorMarker" ) )
+			return;
+
+		if ( shape->castRay( origin, dir, hit.distance, hit.triangle, hit.vertex ) )
+			hit.shape = shape;
+	};
+
+	// The hierarchy is refit by transform(); test every shape until then
+	if ( cullRevision != revision || cullTree.isEmpty() ) {
+		for ( Shape * shape : shapes )
+			castRay( shape );
+
+		return hit;
+	}
+
+	// Distances along the ray are the same in world space
+	Matrix r = view.rotation.inverted();
+	Vector3 o = r * ( origin - view.translation ) / view.scale;
+	Vector3 d = r * dir / view.scale;
+	float dd = Vector3::dotproduct( d, d );
+
+	QVector<int> stack;
+	stack.append( 0 );
+	while ( !stack.isEmpty() ) {
+		int index = stack.takeLast();
+		const CullNode & node = cullTree.at( index );
+
+		// Skip spheres the ray misses before the nearest hit so far
+		if ( node.bounds.radius >= 0 && dd > 0 ) {
+			float t = Vector3::dotproduct( node.bounds.center - o, d ) / dd;
+			t = std::max( 0.0f, std::min( t, hit.distance ) );
+			if ( ( o + d * t - node.bounds.center ).squaredLength() > node.bounds.radius * node.bounds.radius )
+				continue;
+		}
+
+		if ( node.count > 1 ) {
+			stack.append( node.second );
+			stack.append( index + 1 );
+		} else {
+			castRay( cullShapes.at( node.first ) );
+		}
+	}
+
+	return hit;
+}
+
 void Scene::drawNodes()
 {
 	for ( Node * node : roots.list() ) {
@@ -462,6 +937,12 @@ QString Scene::textStats()
 	return QString();
 }
 
+void Scene::prefetchTexture( const QString & fname )
+{
+	if ( (options & DoTexturing) && !fname.isEmpty() )
+		textures->prefetch( fname );
+}
+
 int Scene::bindTexture( const QString & fname )
 {
 	if ( !(options & DoTexturing) || fname.isEmpty() )
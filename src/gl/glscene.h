@@ -33,7 +33,9 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #ifndef GLSCENE_H
 #define GLSCENE_H
 
+#include "glmarker.h"
 #include "glnode.h"
+#include "glprofiler.h"
 #include "glproperty.h"
 #include "gltools.h"
 
@@ -56,6 +58,57 @@ class QAction;
 class QOpenGLContext;
 class QOpenGLFunctions;
 
+//! Geometry of a data block, loaded once and shared by every shape linking to it
+struct SharedGeometry final
+{
+	QVector<Vector3> verts;
+	QVector<Vector3> norms;
+	QVector<Color4> colors;
+	QVector<Vector3> tangents;
+	QVector<Vector3> bitangents;
+	QVector<QVector<Vector2>> coords;
+	QVector<Triangle> triangles;
+	QVector<QVector<quint16>> tristrips;
+	bool hasVertexColors = false;
+
+	//! Buffer objects drawn by the shapes while they use the arrays unchanged
+	GLBuffer<Vector3> vertBuffer;
+	GLBuffer<Vector3> normBuffer;
+	GLBuffer<Color4> colorBuffer;
+	GLBuffer<Vector3> tangentBuffer;
+	GLBuffer<Vector3> bitangentBuffer;
+	QVector<GLBuffer<Vector2>> coordBuffers;
+	GLBuffer<Triangle> triangleBuffer = GLBuffer<Triangle>( GL_ELEMENT_ARRAY_BUFFER );
+};
+
+//! A Havok collision shape decoded from its block, kept until one of its blocks changes
+struct HavokShape final
+{
+	enum Type
+	{
+		Unknown, ListShape, TransformShape, SphereShape, MultiSphereShape, BoxShape,
+		CapsuleShape, CylinderShape, MeshShape, PackedShape, MoppShape
+	};
+
+	Type type = Unknown;
+	//! Block numbers of the sub shapes
+	QVector<int> children;
+	//! Transform of a transform shape, translation already in Havok scale
+	Transform transform;
+	//! Box extents, capsule and cylinder end points
+	Vector3 a, b;
+	float radius = 0;
+	//! Center and radius of each sphere of a multi sphere shape
+	QVector<Vector4> spheres;
+	//! Mesh shape triangles, three vertices each
+	QVector<Vector3> triangles;
+	GLBuffer<Vector3> buffer;
+	//! Block number of the packed or compressed data, -1 if none
+	int data = -1;
+	//! Blocks read besides the shape block
+	QVector<int> dataBlocks;
+};
+
 class Scene final : public QObject
 {
 	Q_OBJECT
@@ -65,31 +118,67 @@ public:
 
 	void updateShaders();
 
+	//! Drops the scene; deletes GL objects, so the context must be current
 	void clear( bool flushTextures = true );
 	void make( NifModel * nif, bool flushTextures = false );
 	void make( NifModel * nif, int blockNumber, QStack<int> & nodestack );
 
+	//! Rebuilds the items reading a block; deletes their GL objects, so the context must be current
 	void update( const NifModel * nif, const QModelIndex & index );
 
 	void transform( const Transform & trans, float time = 0.0 );
 
 	void draw();
 	void drawShapes();
+	//! Queues an opaque shape of the first pass; returns false if it should be drawn now
+	bool enqueue( Shape * shape );
 	void drawNodes();
 	void drawHavok();
 	void drawFurn();
 	void drawSelection() const;
 
+	//! The nearest shape hit by a ray
+	struct Hit
+	{
+		Shape * shape = nullptr;
+		//! Triangle of the shape, counting strip triangles after the plain ones
+		int triangle = -1;
+		//! Vertex of the triangle nearest to the hit
+		int vertex = -1;
+		//! Distance of the hit in multiples of the ray direction
+		float distance = 0;
+	};
+
+	//! Casts a ray given in eye space at the shapes drawn by drawShapes()
+	Hit pick( const Vector3 & origin, const Vector3 & dir );
+
 	void setSequence( const QString & seqname );
 
 	QString textStats();
 
+	//! Start reading a texture while the scene is still being built
+	void prefetchTexture( const QString & fname );
 	int bindTexture( const QString & fname );
 	int bindTexture( const QModelIndex & index );
 
 	Node * getNode( const NifModel * nif, const QModelIndex & iNode );
 	Property * getProperty( const NifModel * nif, const QModelIndex & iProperty );
 
+	//! Finds the node of a block number without creating it
+	Node * findNode( int id ) const;
+	//! Changes whenever nodes are added, removed or reparented
+	int nodeRevision() const { return revision; }
+
+	//! Finds the geometry of a data block, nullptr if it was not loaded since it last changed
+	const SharedGeometry * findGeometry( int block ) const;
+	//! Stores the geometry of a data block for the other shapes linking to it
+	const SharedGeometry * addGeometry( int block, const SharedGeometry & geometry );
+
+	//! Finds the decoded collision shape of a block, nullptr if it was not decoded since it last changed
+	HavokShape * findHavokShape( int block );
+	//! Stores the decoded collision shape of a block
+	HavokShape * addHavokShape( int block, const HavokShape & shape );
+
 	enum SceneOption
 	{
 		None = 0x0,
@@ -152,6 +241,15 @@ public:
 	
 	Renderer * renderer;
 
+	//! Times the stages of the frames drawn by GLView
+	FrameProfiler profiler;
+	//! Batches the debug primitives of the markers, collision shapes and selection
+	DebugDraw debugDraw;
+	//! Buffers of the furniture and constraint marker meshes, kept for the lifetime of the scene
+	MarkerBuffers markers;
+	//! Buffer the particle systems stream their quads through
+	StreamBuffer particleBuffer;
+
 	NodeList nodes;
 	PropertyList properties;
 
@@ -162,6 +260,8 @@ public:
 	mutable QHash<int, Transform> bhkBodyTrans;
 
 	Transform view;
+	//! Window around the cursor in viewport pixels while picking, shapes outside of it are culled
+	QRect pickWindow;
 
 	bool animate;
 
@@ -197,6 +297,73 @@ protected:
 	mutable float tMin = 0, tMax = 0;
 
 	void updateTimeBounds() const;
+
+	//! Marks the node hierarchy and block number map as changed
+	void invalidateNodes();
+	//! Drops the shared geometry of a data block
+	void releaseGeometry( int block );
+	//! Drops the collision shapes reading a block, or all of them for -1, and deletes their buffers
+	void releaseHavokShapes( int block );
+	//! Indexes the nodes and properties reading each block
+	void buildDependents( const NifModel * nif );
+
+	//! Draws the queued opaque shapes sorted by render state
+	void drawQueue();
+
+	//! Rebuilds the bounding volume hierarchy over the shapes
+	void buildCullTree();
+	//! Updates the bounds of the hierarchy bottom up after the shapes moved
+	void refitCullTree();
+	//! Flags the shapes outside of the view frustum of the current projection
+	void cull();
+
+	//! Opaque shapes of the first pass
+	QVector<Shape *> opaqueQueue;
+	//! Second pass order of the previous frame
+	QHash<const Node *, int> alphaOrder;
+	//! Are opaque shapes being queued?
+	bool queueing = false;
+
+	//! A node of the bounding volume hierarchy over the shapes
+	struct CullNode
+	{
+		//! World bounds of the node's shapes
+		BoundSphere bounds;
+		//! Range of the node's shapes in cullShapes
+		int first, count;
+		//! Index of the second child; the first child directly follows its parent
+		int second;
+	};
+
+	//! Bounding volume hierarchy in depth first order
+	QVector<CullNode> cullTree;
+	//! Shapes ordered by the leaves of the hierarchy
+	QVector<Shape *> cullShapes;
+	//! Node revision the hierarchy was built at
+	int cullRevision = -1;
+
+	//! Shared geometry by data block number
+	QHash<int, SharedGeometry> geometry;
+	//! Decoded collision shapes by shape block number
+	QHash<int, HavokShape> havokShapes;
+
+	//! The nodes and properties reading a block
+	struct Dependents
+	{
+		QVector<Property *> properties;
+		QVector<Node *> nodes;
+	};
+
+	//! Dependents by block number
+	QHash<int, Dependents> dependents;
+	//! Child links of the indexed blocks at the time they were indexed
+	QHash<int, QList<int>> dependentLinks;
+	bool dependentsValid = false;
+
+	//! Block number to node map, rebuilt on demand
+	mutable QHash<int, Node *> nodeIds;
+	mutable bool nodeIdsValid = false;
+	int revision = 0;
 };
 
 Q_DECLARE_OPERATORS_FOR_FLAGS( Scene::SceneOptions )
@@ -0,0 +1,450 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+#include "glskinning.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QRunnable>
+#include <QThreadPool>
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SKIN_SSE2
+#include <emmintrin.h>
+#endif
+
+
+//! @file glskinning.cpp SkinKernel implementation
+
+//! Minimum number of vertices given to one thread
+static const int SKIN_RANGE_SIZE = 4096;
+
+//! Threads used by SkinKernel::skin(); kept apart so waiting does not block on other work
+static QThreadPool * skinPool()
+{
+	static QThreadPool pool;
+	return &pool;
+}
+
+//! Thread pool task skinning one vertex range
+class SkinTask final : public QRunnable
+{
+public:
+	SkinTask( const SkinKernel * k, const SkinKernel::Streams & s, int b, int e )
+		: kernel( k ), streams( s ), begin( b ), end( e ) {}
+
+	void run() override final
+	{
+		kernel->skinRange( streams, begin, end );
+	}
+
+private:
+	const SkinKernel * kernel;
+	SkinKernel::Streams streams;
+	int begin;
+	int end;
+};
+
+void SkinKernel::resetInfluences( int vertices, int w )
+{
+	numVerts = std::max( vertices, 0 );
+	width = std::max( w, 0 );
+
+	boneIndex.fill( 0, numVerts * width );
+	boneWeight.fill( 0.0f, numVerts * width );
+	used.fill( 0, numVerts );
+}
+
+bool SkinKernel::addInfluence( int vertex, int bone, float weight )
+{
+	if ( vertex < 0 || vertex >= numVerts || used[vertex] >= width )
+		return false;
+
+	int slot = vertex * width + used[vertex]++;
+	boneIndex[slot] = bone;
+	boneWeight[slot] = weight;
+	return true;
+}
+
+bool SkinKernel::exportInfluences( int bones, QVector<Vector4> & indices, QVector<Vector4> & weights ) const
+{
+	indices.fill( Vector4(), numVerts );
+	weights.fill( Vector4(), numVerts );
+
+	bool fits = (width <= 4);
+	for ( int v = 0; v < numVerts && fits; v++ ) {
+		for ( int k = 0; k < width; k++ ) {
+			int slot = v * width + k;
+			if ( boneIndex[slot] < 0 || boneIndex[slot] >= bones ) {
+				fits = false;
+				break;
+			}
+
+			indices[v][k] = boneIndex[slot];
+			weights[v][k] = boneWeight[slot];
+		}
+	}
+
+	if ( !fits ) {
+		indices.clear();
+		weights.clear();
+	}
+
+	return fits;
+}
+
+void SkinKernel::setBoneCount( int count )
+{
+	int prev = transforms.count();
+
+	transforms.resize( count );
+	active.resize( count );
+	positions.resize( count );
+	rotations.resize( count );
+
+	for ( int b = prev; b < count; b++ )
+		clearBone( b );
+}
+
+void SkinKernel::setBone( int bone, const Transform & t )
+{
+	Transform r;
+	r.rotation = t.rotation;
+
+	transforms[bone] = t;
+	active[bone] = true;
+	positions[bone] = t.toMatrix4();
+	rotations[bone] = r.toMatrix4();
+}
+
+void SkinKernel::clearBone( int bone )
+{
+	Matrix4 zero;
+	for ( int c = 0; c < 4; c++ )
+		for ( int d = 0; d < 4; d++ )
+			zero( c, d ) = 0.0;
+
+	transforms[bone] = Transform();
+	active[bone] = false;
+	positions[bone] = zero;
+	rotations[bone] = zero;
+}
+
+BoundSphere SkinKernel::bounds( const BoundSphere & bind ) const
+{
+	BoundSphere bs;
+	for ( int b = 0; b < transforms.count(); b++ ) {
+		if ( active[b] )
+			bs |= transforms[b] * bind;
+	}
+
+	return bs;
+}
+
+void SkinKernel::skin( const QVector<Vector3> & verts, const QVector<Vector3> & norms,
+					   const QVector<Vector3> & tangents, const QVector<Vector3> & bitangents,
+					   QVector<Vector3> & transVerts, QVector<Vector3> & transNorms,
+					   QVector<Vector3> & transTangents, QVector<Vector3> & transBitangents ) const
+{
+	int vcnt = verts.count();
+	const QVector<Vector3> * in[4] = { &verts, &norms, &tangents, &bitangents };
+	QVector<Vector3> * out[4] = { &transVerts, &transNorms, &transTangents, &transBitangents };
+
+	// Vertices without influences, or past the end of an attribute, are zero
+	int n = std::min( vcnt, numVerts );
+
+	Streams s;
+	for ( int a = 0; a < 4; a++ ) {
+		out[a]->resize( vcnt );
+
+		s.in[a] = in[a]->constData();
+		s.out[a] = out[a]->data();
+		s.count[a] = std::min( in[a]->count(), n );
+
+		std::fill( out[a]->begin() + s.count[a], out[a]->end(), Vector3() );
+	}
+
+	int tasks = std::min( n / SKIN_RANGE_SIZE, skinPool()->maxThreadCount() );
+	if ( tasks <= 1 ) {
+		skinRange( s, 0, n );
+		return;
+	}
+
+	// The calling thread takes the first range
+	int size = (n + tasks - 1) / tasks;
+	for ( int begin = size; begin < n; begin += size )
+		skinPool()->start( new SkinTask( this, s, begin, std::min( begin + size, n ) ) );
+
+	skinRange( s, 0, size );
+	skinPool()->waitForDone();
+}
+
+#ifdef SKIN_SSE2
+
+//! Transforms @p v by the columns of a matrix, without translation
+static inline __m128 transformColumns( __m128 c0, __m128 c1, __m128 c2, const Vector3 & v )
+{
+	__m128 r = _mm_mul_ps( c0, _mm_set1_ps( v[0] ) );
+	r = _mm_add_ps( r, _mm_mul_ps( c1, _mm_set1_ps( v[1] ) ) );
+	return _mm_add_ps( r, _mm_mul_ps( c2, _mm_set1_ps( v[2] ) ) );
+}
+
+static inline Vector3 toVector3( __m128 x, bool normalize )
+{
+	float f[4];
+	_mm_storeu_ps( f, x );
+
+	Vector3 v( f[0], f[1], f[2] );
+	if ( normalize )
+		v.normalize();
+
+	return v;
+}
+
+void SkinKernel::skinRange( const Streams & s, int begin, int end ) const
+{
+	const Matrix4 * pos = positions.constData();
+	const Matrix4 * rot = rotations.constData();
+	int nbones = positions.count();
+
+	for ( int v = begin; v < end; v++ ) {
+		const int * bi = boneIndex.constData() + v * width;
+		const float * bw = boneWeight.constData() + v * width;
+
+		// Blend the bone matrices once for all attributes of the vertex
+		__m128 p0 = _mm_setzero_ps(), p1 = p0, p2 = p0, p3 = p0;
+		__m128 r0 = p0, r1 = p0, r2 = p0;
+		for ( int k = 0; k < width; k++ ) {
+			int b = bi[k];
+			if ( bw[k] == 0.0f || b < 0 || b >= nbones )
+				continue;
+
+			__m128 w = _mm_set1_ps( bw[k] );
+			const float * pm = pos[b].data();
+			const float * rm = rot[b].data();
+
+			p0 = _mm_add_ps( p0, _mm_mul_ps( _mm_loadu_ps( pm ), w ) );
+			p1 = _mm_add_ps( p1, _mm_mul_ps( _mm_loadu_ps( pm + 4 ), w ) );
+			p2 = _mm_add_ps( p2, _mm_mul_ps( _mm_loadu_ps( pm + 8 ), w ) );
+			p3 = _mm_add_ps( p3, _mm_mul_ps( _mm_loadu_ps( pm + 12 ), w ) );
+			r0 = _mm_add_ps( r0, _mm_mul_ps( _mm_loadu_ps( rm ), w ) );
+			r1 = _mm_add_ps( r1, _mm_mul_ps( _mm_loadu_ps( rm + 4 ), w ) );
+			r2 = _mm_add_ps( r2, _mm_mul_ps( _mm_loadu_ps( rm + 8 ), w ) );
+		}
+
+		if ( v < s.count[0] )
+			s.out[0][v] = toVector3( _mm_add_ps( transformColumns( p0, p1, p2, s.in[0][v] ), p3 ), false );
+
+		for ( int a = 1; a < 4; a++ ) {
+			if ( v < s.count[a] )
+				s.out[a][v] = toVector3( transformColumns( r0, r1, r2, s.in[a][v] ), true );
+		}
+	}
+}
+
+#else
+
+void SkinKernel::skinRange( const Streams & s, int begin, int end ) const
+{
+	const Matrix4 * pos = positions.constData();
+	const Matrix4 * rot = rotations.constData();
+	int nbones = positions.count();
+
+	for ( int v = begin; v < end; v++ ) {
+		const int * bi = boneIndex.constData() + v * width;
+		const float * bw = boneWeight.constData() + v * width;
+
+		// Blend the bone matrices once for all attributes of the vertex
+		float p[16] = {};
+		float r[12] = {};
+		for ( int k = 0; k < width; k++ ) {
+			int b = bi[k];
+			if ( bw[k] == 0.0f || b < 0 || b >= nbones )
+				continue;
+
+			const float * pm = pos[b].data();
+			const float * rm = rot[b].data();
+			for ( int i = 0; i < 16; i++ )
+				p[i] += pm[i] * bw[k];
+			for ( int i = 0; i < 12; i++ )
+				r[i] += rm[i] * bw[k];
+		}
+
+		if ( v < s.count[0] ) {
+			const Vector3 & x = s.in[0][v];
+			s.out[0][v] = Vector3( p[0] * x[0] + p[4] * x[1] + p[8] * x[2] + p[12],
+								   p[1] * x[0] + p[5] * x[1] + p[9] * x[2] + p[13],
+								   p[2] * x[0] + p[6] * x[1] + p[10] * x[2] + p[14] );
+		}
+
+		for ( int a = 1; a < 4; a++ ) {
+			if ( v < s.count[a] ) {
+				const Vector3 & x = s.in[a][v];
+				s.out[a][v] = Vector3( r[0] * x[0] + r[4] * x[1] + r[8] * x[2],
+									   r[1] * x[0] + r[5] * x[1] + r[9] * x[2],
+									   r[2] * x[0] + r[6] * x[1] + r[10] * x[2] );
+				s.out[a][v].normalize();
+			}
+		}
+	}
+}
+
+#endif
+
+
+/*
+ *  Benchmark
+ */
+
+//! Per-influence skinning loop that SkinKernel replaced, the reference of SkinKernel::benchmark()
+static void skinReference( const QVector<Transform> & palette, const QVector<QVector<QPair<int, float>>> & influences,
+						   const QVector<Vector3> & verts, const QVector<Vector3> & norms,
+						   QVector<Vector3> & transVerts, QVector<Vector3> & transNorms )
+{
+	int vcnt = verts.count();
+
+	transVerts.fill( Vector3(), vcnt );
+	transNorms.fill( Vector3(), vcnt );
+
+	for ( int b = 0; b < palette.count(); b++ ) {
+		const Transform & trans = palette[b];
+
+		for ( const QPair<int, float> & vw : influences[b] ) {
+			transVerts[vw.first] += trans * verts[vw.first] * vw.second;
+			transNorms[vw.first] += trans.rotation * norms[vw.first] * vw.second;
+		}
+	}
+
+	for ( int n = 0; n < transNorms.count(); n++ )
+		transNorms[n].normalize();
+}
+
+void SkinKernel::benchmark( int vertices, int influences, int bones, int frames )
+{
+	vertices = std::max( vertices, 1 );
+	influences = std::max( influences, 1 );
+	bones = std::max( bones, 1 );
+	frames = std::max( frames, 1 );
+
+	// Same pseudo random sequence on every run
+	quint32 seed = 1;
+	auto next = [&seed]() {
+		seed = seed * 1664525u + 1013904223u;
+		return seed >> 8;
+	};
+	auto unit = [&next]() { return float( next() & 0xFFFF ) / 65535.0f; };
+
+	// Bind pose on a sphere, with the normals pointing out
+	QVector<Vector3> verts( vertices );
+	QVector<Vector3> norms( vertices );
+	for ( int v = 0; v < vertices; v++ ) {
+		Vector3 n( unit() - 0.5f, unit() - 0.5f, unit() - 0.5f );
+		n.normalize();
+		norms[v] = n;
+		verts[v] = n * 50.0f;
+	}
+
+	// Influences with normalized weights, as a skin partition stores them
+	SkinKernel kernel;
+	kernel.resetInfluences( vertices, influences );
+
+	QVector<QVector<QPair<int, float>>> boneInfluences( bones );
+	for ( int v = 0; v < vertices; v++ ) {
+		float w[8];
+		float total = 0.0f;
+		int n = std::min( influences, 8 );
+		for ( int k = 0; k < n; k++ ) {
+			w[k] = 1.0f + unit();
+			total += w[k];
+		}
+
+		int first = next() % bones;
+		for ( int k = 0; k < n; k++ ) {
+			int b = (first + k) % bones;
+			kernel.addInfluence( v, b, w[k] / total );
+			boneInfluences[b] << QPair<int, float>( v, w[k] / total );
+		}
+	}
+
+	// Palettes recorded for every frame before timing
+	QVector<QVector<Transform>> palettes( frames );
+	for ( int f = 0; f < frames; f++ ) {
+		palettes[f].resize( bones );
+		for ( int b = 0; b < bones; b++ ) {
+			Transform & t = palettes[f][b];
+			t.rotation.fromEuler( unit() * PI, unit() * PI, unit() * PI );
+			t.translation = Vector3( unit(), unit(), unit() ) * 10.0f;
+			t.scale = 1.0f;
+		}
+	}
+
+	QVector<Vector3> none;
+	QVector<Vector3> refVerts, refNorms, outVerts, outNorms, outTangents, outBitangents;
+
+	QElapsedTimer timer;
+	timer.start();
+	for ( int f = 0; f < frames; f++ )
+		skinReference( palettes[f], boneInfluences, verts, norms, refVerts, refNorms );
+	qint64 reference = timer.nsecsElapsed();
+
+	kernel.setBoneCount( bones );
+
+	timer.restart();
+	for ( int f = 0; f < frames; f++ ) {
+		for ( int b = 0; b < bones; b++ )
+			kernel.setBone( b, palettes[f][b] );
+
+		kernel.skin( verts, norms, none, none, outVerts, outNorms, outTangents, outBitangents );
+	}
+	qint64 blended = timer.nsecsElapsed();
+
+	// Both loops skinned the last frame
+	float error = 0.0f;
+	for ( int v = 0; v < vertices; v++ ) {
+		error = std::max( error, (refVerts[v] - outVerts[v]).length() );
+		error = std::max( error, (refNorms[v] - outNorms[v]).length() );
+	}
+
+	qInfo().noquote() << QString( "%1 vertices, %2 influences, %3 bones, %4 frames" )
+		.arg( vertices ).arg( influences ).arg( bones ).arg( frames );
+	qInfo().noquote() << QString( "Per-influence loop: %1 ms per frame" ).arg( reference / 1e6 / frames, 0, 'f', 3 );
+#ifdef SKIN_SSE2
+	qInfo().noquote() << QString( "SkinKernel (SSE2, %1 threads): %2 ms per frame" )
+#else
+	qInfo().noquote() << QString( "SkinKernel (scalar, %1 threads): %2 ms per frame" )
+#endif
+		.arg( skinPool()->maxThreadCount() ).arg( blended / 1e6 / frames, 0, 'f', 3 );
+	qInfo().noquote() << QString( "Largest difference: %1" ).arg( error );
+}
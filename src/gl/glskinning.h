@@ -0,0 +1,132 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+#ifndef GLSKINNING_H
+#define GLSKINNING_H
+
+#include "gl/gltools.h"
+
+#include <QVector>
+
+
+//! @file glskinning.h SkinKernel
+
+/*! CPU skinning of a vertex array by a bone palette
+ *
+ * The influences are stored as a fixed number of bone index and weight slots per
+ * vertex, in two separate arrays. Each bone keeps its position and rotation
+ * matrices in the column order of Matrix4, so the palette can be passed on to
+ * the skinning shader programs as is.
+ *
+ * For every vertex the influencing matrices are blended first, then the vertex
+ * attributes are transformed once and the directions normalized in the same pass.
+ * Large meshes are split into vertex ranges over a thread pool.
+ */
+class SkinKernel final
+{
+public:
+	//! Clears the influences of @p vertices vertices, with @p width slots each
+	void resetInfluences( int vertices, int width );
+	//! Adds an influence to a vertex; returns false if its slots are full
+	bool addInfluence( int vertex, int bone, float weight );
+
+	//! Number of vertices with influences
+	int vertexCount() const { return numVerts; }
+	//! Number of influence slots per vertex
+	int influenceWidth() const { return width; }
+
+	//! Copies the influences into 4 slot arrays; returns false if they do not fit or refer past @p bones
+	bool exportInfluences( int bones, QVector<Vector4> & indices, QVector<Vector4> & weights ) const;
+
+	//! Resizes the bone palette, new bones do not contribute
+	void setBoneCount( int count );
+	//! Sets the transform of a bone
+	void setBone( int bone, const Transform & t );
+	//! Makes a bone not contribute
+	void clearBone( int bone );
+
+	//! Number of bones in the palette
+	int boneCount() const { return transforms.count(); }
+	//! Position matrices of the palette
+	const QVector<Matrix4> & boneMatrices() const { return positions; }
+
+	//! Union of @p bind transformed by every contributing bone
+	BoundSphere bounds( const BoundSphere & bind ) const;
+
+	/*! Skins the vertex attributes into the output arrays
+	 *
+	 * Each output is resized to the vertex count. Attributes shorter than the
+	 * vertex array are skinned as far as they go and zero after that.
+	 */
+	void skin( const QVector<Vector3> & verts, const QVector<Vector3> & norms,
+			   const QVector<Vector3> & tangents, const QVector<Vector3> & bitangents,
+			   QVector<Vector3> & transVerts, QVector<Vector3> & transNorms,
+			   QVector<Vector3> & transTangents, QVector<Vector3> & transBitangents ) const;
+
+	//! Vertex attribute pointers for one call of skin()
+	struct Streams
+	{
+		const Vector3 * in[4];
+		Vector3 * out[4];
+		int count[4];
+	};
+
+	//! Skins the vertices in [begin, end)
+	void skinRange( const Streams & s, int begin, int end ) const;
+
+	/*! Times skin() against the per-influence loop it replaced
+	 *
+	 * Both skin the same bind pose by the same palettes, recorded for every frame
+	 * before timing. Prints the time per frame of each and their largest difference.
+	 */
+	static void benchmark( int vertices, int influences, int bones, int frames );
+
+private:
+	int numVerts = 0;
+	int width = 0;
+
+	//! Bone index per vertex and slot
+	QVector<int> boneIndex;
+	//! Bone weight per vertex and slot, 0 for unused slots
+	QVector<float> boneWeight;
+	//! Number of used slots per vertex
+	QVector<int> used;
+
+	QVector<Transform> transforms;
+	QVector<bool> active;
+	//! Scaled rotation and translation per bone
+	QVector<Matrix4> positions;
+	//! Rotation per bone
+	QVector<Matrix4> rotations;
+};
+
+#endif // GLSKINNING_H
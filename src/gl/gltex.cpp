@@ -44,9 +44,13 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <QDir>
 #include <QFileSystemWatcher>
 #include <QListView>
+#include <QMutex>
 #include <QOpenGLContext>
 #include <QOpenGLFunctions>
+#include <QQueue>
+#include <QRunnable>
 #include <QSettings>
+#include <QThreadPool>
 
 #include <algorithm>
 
@@ -144,15 +148,80 @@ void resetTextureUnits( int numTex )
  *  TexCache
  */
 
+//! Bytes of texture data uploaded per frame when streaming
+static const qint64 UPLOAD_BUDGET = 32 * 1024 * 1024;
+
+//! A texture read by a LoadTask, handed to the GUI thread for upload
+struct LoadedTex
+{
+	QString filename;
+	QString filepath;
+	QByteArray data;
+	gli::texture texture;
+	QString status;
+	int generation = 0;
+};
+
+struct TexCache::LoadQueue
+{
+	QMutex mutex;
+	QQueue<LoadedTex> textures;
+};
+
+class TexCache::LoadTask final : public QRunnable
+{
+public:
+	LoadTask( TexCache * cache, const QString & filename, const QString & nifFolder )
+		: cache( cache ), filename( filename ), nifFolder( nifFolder ), generation( cache->generation ) {}
+
+	void run() override final
+	{
+		LoadedTex tex;
+		tex.filename = filename;
+		tex.generation = generation;
+
+		try
+		{
+			tex.filepath = TexCache::find( filename, nifFolder, tex.data );
+			texDecode( tex.filepath, tex.data, tex.texture );
+		}
+		catch ( QString & e )
+		{
+			tex.status = e;
+		}
+
+		{
+			QMutexLocker lock( &cache->loaded->mutex );
+			cache->loaded->textures.enqueue( tex );
+		}
+
+		// Repaint, so that the texture is uploaded
+		QMetaObject::invokeMethod( cache, "sigRefresh", Qt::QueuedConnection );
+	}
+
+private:
+	TexCache * cache;
+	QString filename;
+	QString nifFolder;
+	int generation;
+};
+
 TexCache::TexCache( QObject * parent ) : QObject( parent )
 {
 	watcher = new QFileSystemWatcher( this );
 	connect( watcher, &QFileSystemWatcher::fileChanged, this, &TexCache::fileChanged );
+
+	pool = new QThreadPool( this );
+	loaded = new LoadQueue;
 }
 
 TexCache::~TexCache()
 {
 	//flush();
+
+	// The tasks write to the queue until they are done
+	pool->waitForDone();
+	delete loaded;
 }
 
 QString TexCache::find( const QString & file, const QString & nifdir )
@@ -359,7 +428,7 @@ void TexCache::fileChanged( const QString & filepath )
 	}
 }
 
-int TexCache::bind( const QString & fname )
+TexCache::Tex * TexCache::request( const QString & fname )
 {
 	Tex * tx = textures.value( fname );
 	if ( !tx ) {
@@ -372,34 +441,98 @@ int TexCache::bind( const QString & fname )
 
 		textures.insert( tx->filename, tx );
 
-		if ( !isSupported( fname ) )
+		if ( !isSupported( fname ) ) {
 			tx->id = 0xFFFFFFFF;
+			return tx;
+		}
+
+		tx->pending = true;
+	} else if ( tx->reload && !tx->pending ) {
+		// The old texture stays bound until the new one is uploaded
+		tx->reload = false;
+		tx->pending = true;
+	} else {
+		return tx;
 	}
 
-	if ( tx->id == 0xFFFFFFFF )
-		return 0;
+	pool->start( new LoadTask( this, fname, nifFolder ) );
 
-	QByteArray outData;
+	return tx;
+}
 
-	if ( tx->filepath.isEmpty() || tx->reload )
-		tx->filepath = find( tx->filename, nifFolder, outData );
+void TexCache::prefetch( const QString & fname )
+{
+	if ( !fname.isEmpty() )
+		request( fname );
+}
 
-	if ( !outData.isEmpty() || tx->reload ) {
-		tx->data = outData;
-	}
+void TexCache::uploadLoaded()
+{
+	qint64 budget = UPLOAD_BUDGET;
+
+	while ( true ) {
+		LoadedTex ltx;
+		{
+			QMutexLocker lock( &loaded->mutex );
+			if ( loaded->textures.isEmpty() )
+				break;
+
+			if ( streaming && budget <= 0 ) {
+				// Leave the rest to the next frames
+				QMetaObject::invokeMethod( this, "sigRefresh", Qt::QueuedConnection );
+				break;
+			}
+
+			ltx = loaded->textures.dequeue();
+		}
+
+		Tex * tx = textures.value( ltx.filename );
+		if ( ltx.generation != generation || !tx || !tx->pending )
+			continue;
+
+		budget -= ltx.data.size() + (ltx.texture.empty() ? 0 : qint64( ltx.texture.size() ));
+
+		tx->pending = false;
+		tx->filepath = ltx.filepath;
 
-	if ( !tx->id || tx->reload ) {
 		if ( QFile::exists( tx->filepath ) && QFileInfo( tx->filepath ).isWritable()
 			 && ( !watcher->files().contains( tx->filepath ) ) )
 			watcher->addPath( tx->filepath );
 
-		tx->load();
-	} else {
-		if ( !tx->target )
-			tx->target = GL_TEXTURE_2D;
+		if ( ltx.status.isEmpty() ) {
+			tx->data = ltx.data;
+			tx->load( ltx.texture );
+		} else {
+			if ( !tx->id )
+				glGenTextures( 1, &tx->id );
 
-		glBindTexture( tx->target, tx->id );
+			tx->width = tx->height = tx->mipmaps = 0;
+			tx->status = ltx.status;
+		}
 	}
+}
+
+int TexCache::bind( const QString & fname )
+{
+	Tex * tx = request( fname );
+
+	if ( tx->id == 0xFFFFFFFF )
+		return 0;
+
+	if ( tx->pending && !streaming ) {
+		pool->waitForDone();
+		uploadLoaded();
+	}
+
+	// Not uploaded yet
+	if ( !tx->id )
+		return 0;
+
+	if ( !tx->target )
+		tx->target = GL_TEXTURE_2D;
+
+	glBindTexture( tx->target, tx->id );
+	bindCount++;
 
 	return tx->mipmaps;
 }
@@ -431,6 +564,7 @@ int TexCache::bind( const QModelIndex & iSource )
 					}
 				} else {
 					glBindTexture( GL_TEXTURE_2D, tx->id );
+					bindCount++;
 				}
 
 				return tx->mipmaps;
@@ -445,6 +579,13 @@ int TexCache::bind( const QModelIndex & iSource )
 
 void TexCache::flush()
 {
+	// Drop the textures still being read
+	generation++;
+	{
+		QMutexLocker lock( &loaded->mutex );
+		loaded->textures.clear();
+	}
+
 	for ( Tex * tx : textures ) {
 		if ( tx->id )
 			glDeleteTextures( 1, &tx->id );
@@ -538,7 +679,7 @@ bool TexCache::importFile( NifModel * nif, const QModelIndex & iSource, QModelIn
 *  TexCache::Tex
 */
 
-void TexCache::Tex::load()
+void TexCache::Tex::load( gli::texture & texture )
 {
 	if ( !id )
 		glGenTextures( 1, &id );
@@ -552,7 +693,7 @@ void TexCache::Tex::load()
 
 	try
 	{
-		texLoad( filepath, format, target, width, height, mipmaps, data, id );
+		texLoad( filepath, format, target, width, height, mipmaps, data, texture, id );
 	}
 	catch ( QString & e )
 	{
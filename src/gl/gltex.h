@@ -45,6 +45,12 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 class NifModel;
 class QFileSystemWatcher;
 class QOpenGLContext;
+class QThreadPool;
+
+namespace gli
+{
+class texture;
+}
 
 typedef unsigned int GLuint;
 typedef unsigned int GLenum;
@@ -78,13 +84,15 @@ class TexCache final : public QObject
 		GLuint mipmaps = 0;
 		//! Determine whether the texture needs reloading
 		bool reload = false;
+		//! Determine whether a worker thread is reading the texture
+		bool pending = false;
 		//! Format of the texture
 		QString format;
 		//! Status messages
 		QString status;
 
-		//! Load the texture
-		void load();
+		//! Load the texture, from the decoded texture if there is one
+		void load( gli::texture & texture );
 
 		//! Save the texture as a file
 		bool saveAsFile( const QModelIndex & index, QString & savepath );
@@ -92,6 +100,11 @@ class TexCache final : public QObject
 		bool savePixelData( NifModel * nif, const QModelIndex & iSource, QModelIndex & iData );
 	};
 
+	//! Textures read by the worker threads, waiting for upload
+	struct LoadQueue;
+	//! Thread pool task reading one texture
+	class LoadTask;
+
 public:
 	TexCache( QObject * parent = nullptr );
 	~TexCache();
@@ -101,9 +114,24 @@ public:
 	//! Bind a texture from pixel data
 	int bind( const QModelIndex & iSource );
 
+	//! Start reading a texture from filename, without binding it
+	void prefetch( const QString & fname );
+	//! Upload the textures read by the worker threads, a limited amount per frame when streaming
+	void uploadLoaded();
+
+	/*! Read textures in the background
+	 *
+	 * When set, bind() returns 0 until a texture has been read and uploaded,
+	 * so that the caller falls back to its placeholder. Otherwise bind() waits for it.
+	 */
+	bool streaming = false;
+
 	//! Debug function for getting info about a texture
 	QString info( const QModelIndex & iSource );
 
+	//! Number of textures bound, reset every frame by the scene
+	int bindCount = 0;
+
 	//! Export pixel data to a file
 	bool exportFile( const QModelIndex & iSource, QString & filepath );
 	//! Import pixel data from a file (not implemented yet)
@@ -136,10 +164,18 @@ protected slots:
 	void fileChanged( const QString & filepath );
 
 protected:
+	//! Find or create the texture from filename, and start reading it if needed
+	Tex * request( const QString & fname );
+
 	QHash<QString, Tex *> textures;
 	QHash<QModelIndex, Tex *> embedTextures;
 	QFileSystemWatcher * watcher;
 
+	QThreadPool * pool;
+	LoadQueue * loaded;
+	//! Incremented by flush(), so that the textures read before it are dropped
+	int generation = 0;
+
 	QString nifFolder;
 };
 
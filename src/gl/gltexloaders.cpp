@@ -623,17 +623,13 @@ GLuint texLoadBMP( QIODevice & f, QString & texformat, GLenum & target, GLuint &
 	return 0;
 }
 
-GLuint texLoadDDS( const QString & filepath, QString & format, GLenum & target, GLuint & width, GLuint & height, GLuint & mipmaps, QByteArray & data, GLuint & id )
+GLuint texLoadDDS( const QString & filepath, QString & format, GLenum & target, GLuint & width, GLuint & height, GLuint & mipmaps, gli::texture & texture, GLuint & id )
 {
 	GLuint result = 0;
-	gli::texture texture;
-	if ( extStorageSupported ) {
-		texture = load_if_valid( data.constData(), data.size() );
-		if ( !texture.empty() )
+	if ( !texture.empty() ) {
+		if ( extStorageSupported )
 			result = GLI_create_texture( texture, target, id );
-	} else if ( glCompressedTexImage2D ) {
-		texture = load_if_valid( data.constData(), data.size() );
-		if ( !texture.empty() )
+		else if ( glCompressedTexImage2D )
 			result = GLI_create_texture_fallback( texture, target, id );
 	}
 
@@ -807,8 +803,9 @@ bool texLoad( const QModelIndex & iData, QString & texformat, GLenum & target, G
 			buf.buffer().prepend( QByteArray::fromRawData( dds, sizeof( hdr ) ) );
 			buf.buffer().prepend( QByteArray::fromStdString( "DDS " ) );
 
+			gli::texture texture = load_if_valid( buf.buffer().constData(), buf.buffer().size() );
 			mipmaps = texLoadDDS( QString( "[%1] NiPixelData" ).arg( nif->getBlockNumber( iData ) ), 
-								  texformat, target, width, height, mipmaps, buf.buffer(), id );
+								  texformat, target, width, height, mipmaps, texture, id );
 
 			ok = (mipmaps > 0);
 		}
@@ -1119,10 +1116,16 @@ bool texLoad( const QString & filepath, QString & format, GLenum & target, GLuin
 }
 
 bool texLoad( const QString & filepath, QString & format, GLenum & target, GLuint & width, GLuint & height, GLuint & mipmaps, QByteArray & data, GLuint & id )
+{
+	gli::texture texture;
+	return texLoad( filepath, format, target, width, height, mipmaps, data, texture, id );
+}
+
+bool texLoad( const QString & filepath, QString & format, GLenum & target, GLuint & width, GLuint & height, GLuint & mipmaps, QByteArray & data, gli::texture & texture, GLuint & id )
 {
 	width = height = mipmaps = 0;
 
-	if ( data.isEmpty() ) {
+	if ( data.isEmpty() && texture.empty() ) {
 		QFile tmpF( filepath );
 
 		if ( !tmpF.open( QIODevice::ReadOnly ) )
@@ -1141,9 +1144,12 @@ bool texLoad( const QString & filepath, QString & format, GLenum & target, GLuin
 		throw QString( "could not open buffer" );
 
 	bool isSupported = true;
-	if ( filepath.endsWith( ".dds", Qt::CaseInsensitive ) )
-		mipmaps = texLoadDDS( filepath, format, target, width, height, mipmaps, data, id );
-	else if ( filepath.endsWith( ".tga", Qt::CaseInsensitive ) )
+	if ( filepath.endsWith( ".dds", Qt::CaseInsensitive ) ) {
+		if ( texture.empty() )
+			texture = load_if_valid( data.constData(), data.size() );
+
+		mipmaps = texLoadDDS( filepath, format, target, width, height, mipmaps, texture, id );
+	} else if ( filepath.endsWith( ".tga", Qt::CaseInsensitive ) )
 		mipmaps = texLoadTGA( f, format, target, width, height, id );
 	else if ( filepath.endsWith( ".bmp", Qt::CaseInsensitive ) )
 		mipmaps = texLoadBMP( f, format, target, width, height, id );
@@ -1184,6 +1190,27 @@ bool texLoad( const QString & filepath, QString & format, GLenum & target, GLuin
 	return isSupported;
 }
 
+void texDecode( const QString & filepath, QByteArray & data, gli::texture & texture )
+{
+	if ( data.isEmpty() ) {
+		QFile tmpF( filepath );
+
+		if ( !tmpF.open( QIODevice::ReadOnly ) )
+			throw QString( "could not open file" );
+
+		data = tmpF.readAll();
+	}
+
+	// The other formats are written into the GL texture while they are decoded
+	if ( filepath.endsWith( ".dds", Qt::CaseInsensitive ) && !data.isEmpty() ) {
+		texture = load_if_valid( data.constData(), data.size() );
+
+		// Keep the file data for texLoad to report the error
+		if ( !texture.empty() )
+			data.clear();
+	}
+}
+
 bool texIsSupported( const QString & filepath )
 {
 	return (filepath.endsWith( ".dds", Qt::CaseInsensitive )
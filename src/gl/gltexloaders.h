@@ -78,6 +78,19 @@ extern gli::texture load_if_valid( const char * data, unsigned int size );
  */
 extern bool texLoad( const QString & filepath, QString & format, GLenum & target, GLuint & width, GLuint & height, GLuint & mipmaps, GLuint & id );
 extern bool texLoad( const QString & filepath, QString & format, GLenum & target, GLuint & width, GLuint & height, GLuint & mipmaps, QByteArray & data, GLuint & id );
+extern bool texLoad( const QString & filepath, QString & format, GLenum & target, GLuint & width, GLuint & height, GLuint & mipmaps, QByteArray & data, gli::texture & texture, GLuint & id );
+
+/*! A function for reading textures without an OpenGL context.
+ *
+ * Reads the file pointed to by filepath into data, unless data is already filled,
+ * and decodes DDS textures into texture. The result is handed to texLoad() for upload.
+ * Does not touch OpenGL, and may be called from any thread. Throws a QString on failure.
+ *
+ * @param filepath	The full path to the texture that must be read.
+ * @param data		Contains the file contents, or is emptied once they are decoded.
+ * @param texture	Contains the decoded texture, if the format can be decoded ahead of the upload.
+ */
+extern void texDecode( const QString & filepath, QByteArray & data, gli::texture & texture );
 
 /*! A function for loading textures.
  *
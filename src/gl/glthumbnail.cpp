@@ -0,0 +1,389 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+
+#include "glthumbnail.h"
+
+#include "gl/glscene.h"
+#include "gl/gltex.h"
+#include "model/nifmodel.h"
+
+#include <QAtomicInt>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include <QQueue>
+#include <QRunnable>
+#include <QSettings>
+#include <QTextStream>
+#include <QThreadPool>
+#include <QWaitCondition>
+
+#include <algorithm>
+#include <cmath>
+
+
+//! @file glthumbnail.cpp ThumbnailRenderer, batch thumbnail tasks
+
+//! Samples per pixel of the thumbnail framebuffer
+static const int THUMBNAIL_SAMPLES = 4;
+
+//! Orientation of the thumbnail camera in degrees; the front view turned a little to the side
+static const float THUMBNAIL_ROTATION[3] = { -90.0f, 0.0f, 150.0f };
+
+ThumbnailRenderer::ThumbnailRenderer()
+{
+}
+
+ThumbnailRenderer::~ThumbnailRenderer()
+{
+	if ( context && context->makeCurrent( surface ) ) {
+		delete scene;
+		delete textures;
+		delete fbo;
+		context->doneCurrent();
+	}
+
+	delete context;
+	delete surface;
+}
+
+bool ThumbnailRenderer::initialize()
+{
+	QSurfaceFormat fmt;
+	fmt.setVersion( 2, 1 );
+	fmt.setProfile( QSurfaceFormat::CompatibilityProfile );
+
+	surface = new QOffscreenSurface;
+	surface->setFormat( fmt );
+	surface->create();
+
+	context = new QOpenGLContext;
+	context->setFormat( fmt );
+
+	if ( !surface->isValid() || !context->create() || !context->makeCurrent( surface ) )
+		return false;
+
+	fn = context->functions();
+	fn->initializeOpenGLFunctions();
+
+	initializeTextureUnits( context );
+
+	textures = new TexCache;
+	scene = new Scene( textures, context, fn );
+
+	// Only the model is drawn
+	scene->options &= ~(Scene::ShowAxes | Scene::ShowGrid | Scene::ShowNodes | Scene::ShowCollision
+	                    | Scene::ShowConstraints | Scene::ShowMarkers);
+	scene->animate = false;
+
+	if ( scene->renderer->initialize() )
+		scene->updateShaders();
+
+	return true;
+}
+
+QImage ThumbnailRenderer::render( NifModel * nif, const QString & folder, const QSize & size )
+{
+	if ( !scene || !context->makeCurrent( surface ) )
+		return QImage();
+
+	if ( !fbo || fbo->size() != size ) {
+		delete fbo;
+
+		QOpenGLFramebufferObjectFormat fboFmt;
+		fboFmt.setTextureTarget( GL_TEXTURE_2D );
+		fboFmt.setMipmap( false );
+		fboFmt.setAttachment( QOpenGLFramebufferObject::CombinedDepthStencil );
+		fboFmt.setSamples( THUMBNAIL_SAMPLES );
+
+		fbo = new QOpenGLFramebufferObject( size, fboFmt );
+	}
+
+	if ( !fbo->bind() )
+		return QImage();
+
+	QSettings settings;
+	settings.beginGroup( "Settings/Render" );
+	QColor background = settings.value( "Colors/Background", QColor( 46, 46, 46 ) ).value<QColor>();
+	float fov = settings.value( "General/Camera/Field Of View", 45.0 ).toFloat();
+	if ( fov <= 0.0 )
+		fov = 45.0;
+	settings.endGroup();
+
+	glPushAttrib( GL_ALL_ATTRIB_BITS );
+
+	glViewport( 0, 0, size.width(), size.height() );
+	glClearColor( background.redF(), background.greenF(), background.blueF(), 1.0 );
+	glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT );
+
+	// Compile the model
+	textures->setNifFolder( folder );
+	scene->make( nif );
+	scene->transform( Transform(), scene->timeMin() );
+
+	// Frame the whole model, as GLView::setCenter
+	BoundSphere bs = scene->bounds();
+	if ( bs.radius < 1 )
+		bs.radius = 1024.0;
+
+	Transform viewTrans;
+	viewTrans.rotation.fromEuler( THUMBNAIL_ROTATION[0] / 180.0 * PI, THUMBNAIL_ROTATION[1] / 180.0 * PI,
+	                              THUMBNAIL_ROTATION[2] / 180.0 * PI );
+	viewTrans.translation = viewTrans.rotation * -bs.center;
+	viewTrans.translation[2] -= bs.radius * 1.2 * 2;
+
+	scene->transform( viewTrans, scene->timeMin() );
+
+	// Perspective projection, as GLView::glProjection
+	glMatrixMode( GL_PROJECTION );
+	glLoadIdentity();
+
+	BoundSphere vs = scene->view * scene->bounds();
+	float bounds = (vs.radius > 1024.0) ? vs.radius : 1024.0;
+
+	GLdouble nr = std::max( fabs( vs.center[2] ) - bounds * 1.5, 1.0 );
+	GLdouble fr = std::max( fabs( vs.center[2] ) + bounds * 1.5, nr + 1.0 );
+	GLdouble h2 = tan( fov / 360 * PI ) * nr;
+	GLdouble w2 = h2 * size.width() / size.height();
+	glFrustum( -w2, +w2, -h2, +h2, nr, fr );
+
+	glMatrixMode( GL_MODELVIEW );
+	glLoadIdentity();
+
+	// Frontal light
+	GLfloat mat_amb[] = { 0.375f, 0.375f, 0.375f, 1.0f };
+	GLfloat mat_diff[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	Vector4 lightDir( 0.0, 0.0, 1.0, 0.0 );
+
+	glShadeModel( GL_SMOOTH );
+	glEnable( GL_LIGHT0 );
+	glLightfv( GL_LIGHT0, GL_AMBIENT, mat_amb );
+	glLightfv( GL_LIGHT0, GL_DIFFUSE, mat_diff );
+	glLightfv( GL_LIGHT0, GL_SPECULAR, mat_diff );
+	glLightfv( GL_LIGHT0, GL_POSITION, lightDir.data() );
+
+	if ( scene->options & Scene::DoMultisampling )
+		glEnable( GL_MULTISAMPLE_ARB );
+
+	Node::SELECTING = 0;
+	scene->draw();
+
+	glPopAttrib();
+
+	fbo->release();
+	QImage image = fbo->toImage();
+
+	// Drop the scene before the model goes away
+	scene->clear();
+
+	context->doneCurrent();
+
+	return image;
+}
+
+
+namespace
+{
+//! A NIF read by a LoadTask, handed to the rendering thread
+struct LoadedFile
+{
+	int index;
+	NifModel * nif;
+};
+
+//! NIFs read by the worker threads, waiting to be rendered
+struct LoadQueue
+{
+	QMutex mutex;
+	QWaitCondition ready;
+	QQueue<LoadedFile> files;
+};
+
+//! Thread pool task reading one NIF
+class LoadTask final : public QRunnable
+{
+public:
+	LoadTask( LoadQueue * queue, int index, const QString & file ) : queue( queue ), index( index ), file( file ) {}
+
+	void run() override final
+	{
+		NifModel * nif = new NifModel;
+
+		if ( nif->loadFromFile( file ) ) {
+			// Hand the model over to the rendering thread
+			nif->moveToThread( QCoreApplication::instance()->thread() );
+		} else {
+			delete nif;
+			nif = nullptr;
+		}
+
+		QMutexLocker lock( &queue->mutex );
+		queue->files.enqueue( { index, nif } );
+		queue->ready.wakeOne();
+	}
+
+private:
+	LoadQueue * queue;
+	int index;
+	QString file;
+};
+
+//! Thread pool task encoding and writing one PNG
+class SaveTask final : public QRunnable
+{
+public:
+	SaveTask( const QImage & image, const QString & file, QAtomicInt * written )
+		: image( image ), file( file ), written( written ) {}
+
+	void run() override final
+	{
+		QDir().mkpath( QFileInfo( file ).absolutePath() );
+
+		if ( image.save( file, "PNG" ) )
+			written->ref();
+		else
+			qWarning() << "Could not save" << file;
+	}
+
+private:
+	QImage image;
+	QString file;
+	QAtomicInt * written;
+};
+}
+
+int ThumbnailRenderer::renderFiles( const QStringList & inputs, const QString & output, const QSize & size, int threads )
+{
+	static const QStringList filters = { "*.nif", "*.nifcache", "*.btr", "*.bto" };
+
+	// Collect the files and where their images go
+	QStringList files;
+	QStringList images;
+
+	auto addFile = [&files, &images]( const QString & file, const QString & image ) {
+		files << file;
+		images << QFileInfo( image ).path() + "/" + QFileInfo( image ).completeBaseName() + ".png";
+	};
+
+	for ( const QString & input : inputs ) {
+		QFileInfo info( input );
+
+		if ( info.isDir() ) {
+			QDir root( info.absoluteFilePath() );
+			QDirIterator it( root.path(), filters, QDir::Files, QDirIterator::Subdirectories );
+
+			while ( it.hasNext() ) {
+				QString file = it.next();
+				addFile( file, output.isEmpty() ? file : QDir( output ).filePath( root.relativeFilePath( file ) ) );
+			}
+		} else if ( info.isFile() ) {
+			QString file = info.absoluteFilePath();
+			addFile( file, output.isEmpty() ? file : QDir( output ).filePath( info.fileName() ) );
+		} else {
+			qWarning() << "Could not find" << input;
+		}
+	}
+
+	ThumbnailRenderer renderer;
+	if ( !renderer.initialize() ) {
+		qCritical() << "Could not create an OpenGL context";
+		return -1;
+	}
+
+	QElapsedTimer timer;
+	timer.start();
+
+	QThreadPool pool;
+	pool.setMaxThreadCount( std::max( threads, 1 ) );
+
+	LoadQueue queue;
+	QAtomicInt written;
+
+	// Read ahead by a few files per thread, so models do not pile up in memory
+	int next = 0;
+	int pending = 0;
+	auto readAhead = [&]() {
+		while ( next < files.count() && pending < pool.maxThreadCount() * 2 ) {
+			pool.start( new LoadTask( &queue, next, files.at( next ) ) );
+			next++;
+			pending++;
+		}
+	};
+
+	readAhead();
+
+	for ( int i = 0; i < files.count(); i++ ) {
+		LoadedFile loaded;
+		{
+			QMutexLocker lock( &queue.mutex );
+			while ( queue.files.isEmpty() )
+				queue.ready.wait( &queue.mutex );
+			loaded = queue.files.dequeue();
+		}
+
+		pending--;
+		readAhead();
+
+		if ( !loaded.nif ) {
+			qWarning() << "Could not load" << files.at( loaded.index );
+			continue;
+		}
+
+		QImage image = renderer.render( loaded.nif, QFileInfo( files.at( loaded.index ) ).absolutePath(), size );
+		delete loaded.nif;
+
+		if ( image.isNull() ) {
+			qWarning() << "Could not render" << files.at( loaded.index );
+			continue;
+		}
+
+		pool.start( new SaveTask( image, images.at( loaded.index ), &written ) );
+	}
+
+	pool.waitForDone();
+
+	double seconds = timer.elapsed() / 1000.0;
+	int count = written.load();
+
+	QTextStream( stdout ) << QString( "%1 of %2 thumbnails in %3 s, %4 thumbnails/s" )
+		.arg( count ).arg( files.count() ).arg( seconds, 0, 'f', 2 )
+		.arg( (seconds > 0.0) ? count / seconds : 0.0, 0, 'f', 2 ) << endl;
+
+	return count;
+}
@@ -0,0 +1,92 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+
+#ifndef GLTHUMBNAIL_H
+#define GLTHUMBNAIL_H
+
+#include <QImage>
+#include <QSize>
+#include <QStringList>
+
+
+//! @file glthumbnail.h ThumbnailRenderer
+
+class NifModel;
+class Scene;
+class TexCache;
+class QOffscreenSurface;
+class QOpenGLContext;
+class QOpenGLFramebufferObject;
+class QOpenGLFunctions;
+
+/*! Renders NIF files to images without a window
+ *
+ * Draws into a framebuffer object of an offscreen surface, so it runs on any
+ * platform plugin with OpenGL 2.1, including the offscreen plugin on top of a
+ * software rasterizer such as Mesa llvmpipe. The scene is framed by its bounds
+ * and lit from the front, like the default view of GLView.
+ */
+class ThumbnailRenderer final
+{
+public:
+	ThumbnailRenderer();
+	~ThumbnailRenderer();
+
+	//! Creates the OpenGL context and the scene; returns false if OpenGL is not available
+	bool initialize();
+
+	//! Renders @p nif with textures searched from @p folder
+	QImage render( NifModel * nif, const QString & folder, const QSize & size );
+
+	/*! Renders every NIF in @p inputs to a PNG of @p size
+	 *
+	 * The inputs are files or folders, which are searched recursively. The images are
+	 * written next to the NIFs, or mirrored into @p output if it is not empty.
+	 * Files are read and PNGs written by @p threads worker threads while the main
+	 * thread renders. Throughput is printed to the standard output.
+	 *
+	 * @return The number of thumbnails written, or -1 if OpenGL is not available
+	 */
+	static int renderFiles( const QStringList & inputs, const QString & output, const QSize & size, int threads );
+
+private:
+	QOffscreenSurface * surface = nullptr;
+	QOpenGLContext * context = nullptr;
+	QOpenGLFunctions * fn = nullptr;
+	QOpenGLFramebufferObject * fbo = nullptr;
+
+	TexCache * textures = nullptr;
+	Scene * scene = nullptr;
+};
+
+#endif
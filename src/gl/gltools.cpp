@@ -34,6 +34,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "model/nifmodel.h"
 
+#include <QHash>
 #include <QMap>
 #include <QStack>
 #include <QVector>
@@ -41,6 +42,8 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <stack>
 #include <map>
 #include <algorithm>
+#include <cstddef>
+#include <cstring>
 #include <functional>
 
 
@@ -249,55 +252,640 @@ BoundSphere operator*( const Transform & t, const BoundSphere & sphere )
 	return bs.apply( t );
 }
 
+Frustum Frustum::fromProjection( const Transform & view, const QRect & window )
+{
+	GLfloat p[16];
+	glGetFloatv( GL_PROJECTION_MATRIX, p );
+
+	if ( view.scale == 0.0f )
+		return Frustum();
+
+	if ( window.isValid() ) {
+		GLint vp[4];
+		glGetIntegerv( GL_VIEWPORT, vp );
+
+		// Premultiply the pick matrix of gluPickMatrix, which maps the window to the whole viewport
+		float sx = float( vp[2] ) / window.width();
+		float sy = float( vp[3] ) / window.height();
+		float tx = (vp[2] - 2.0f * (window.x() + window.width() / 2.0f - vp[0])) / window.width();
+		float ty = (vp[3] - 2.0f * (window.y() + window.height() / 2.0f - vp[1])) / window.height();
+
+		for ( int c = 0; c < 4; c++ ) {
+			p[c * 4 + 0] = sx * p[c * 4 + 0] + tx * p[c * 4 + 3];
+			p[c * 4 + 1] = sy * p[c * 4 + 1] + ty * p[c * 4 + 3];
+		}
+	}
+
+	Frustum f;
+
+	// The clip planes are the last row of the projection matrix plus or minus one of the others
+	for ( int i = 0; i < 6; i++ ) {
+		int row = i / 2;
+		float sign = (i % 2) ? -1.0f : 1.0f;
+
+		Vector3 n( p[3] + sign * p[row], p[7] + sign * p[4 + row], p[11] + sign * p[8 + row] );
+		float d = p[15] + sign * p[12 + row];
+
+		// Eye space is view.rotation * p * view.scale + view.translation
+		Vector3 w;
+		for ( int j = 0; j < 3; j++ )
+			w[j] = view.rotation( 0, j ) * n[0] + view.rotation( 1, j ) * n[1] + view.rotation( 2, j ) * n[2];
+
+		w *= view.scale;
+		d += Vector3::dotproduct( n, view.translation );
+
+		float len = w.length();
+		if ( len == 0.0f )
+			return Frustum();
+
+		f.normal[i] = w / len;
+		f.distance[i] = d / len;
+	}
+
+	f.valid = true;
+	return f;
+}
+
+Frustum::Containment Frustum::contains( const BoundSphere & sphere ) const
+{
+	if ( !valid )
+		return Inside;
+	if ( sphere.radius < 0 )
+		return Intersects;
+
+	Containment result = Inside;
+	for ( int i = 0; i < 6; i++ ) {
+		float d = Vector3::dotproduct( normal[i], sphere.center ) + distance[i];
+		if ( d < -sphere.radius )
+			return Outside;
+		if ( d < sphere.radius )
+			result = Intersects;
+	}
+
+	return result;
+}
+
 
 /*
- * draw primitives
+ * stream buffers
  */
 
-void drawAxes( const Vector3 & c, float axis, bool color )
+void StreamBuffer::upload( QOpenGLFunctions * fn, const void * data, int size )
+{
+	if ( !id )
+		fn->glGenBuffers( 1, &id );
+
+	fn->glBindBuffer( target, id );
+
+	// Orphan the storage of the last upload instead of waiting for the draws reading it
+	if ( size > capacity )
+		capacity = std::max( size, capacity * 2 );
+
+	fn->glBufferData( target, capacity, nullptr, GL_STREAM_DRAW );
+	fn->glBufferSubData( target, 0, size, data );
+}
+
+void StreamBuffer::release( QOpenGLFunctions * fn )
+{
+	if ( id )
+		fn->glDeleteBuffers( 1, &id );
+
+	id = 0;
+	capacity = 0;
+}
+
+
+/*
+ * debug draw batching
+ */
+
+DebugDraw * DebugDraw::active = nullptr;
+
+void DebugDraw::begin()
+{
+	if ( depth++ == 0 && !active ) {
+		active = this;
+		capture();
+	}
+}
+
+//! Converts a matrix read from GL, which is column major like the data of Matrix4
+static Matrix4 fromGLMatrix( const GLfloat * m )
+{
+	Matrix4 matrix;
+	for ( int c = 0; c < 4; c++ ) {
+		for ( int r = 0; r < 4; r++ )
+			matrix( c, r ) = m[c * 4 + r];
+	}
+
+	return matrix;
+}
+
+void DebugDraw::capture()
+{
+	glGetFloatv( GL_CURRENT_COLOR, current.color );
+	glGetFloatv( GL_LINE_WIDTH, &current.lineWidth );
+	glGetFloatv( GL_POINT_SIZE, &current.pointSize );
+	glGetIntegerv( GL_DEPTH_FUNC, &current.depthFunc );
+
+	GLint polygonMode[2];
+	glGetIntegerv( GL_POLYGON_MODE, polygonMode );
+	current.polygonMode = polygonMode[0];
+
+	GLboolean depthMask;
+	glGetBooleanv( GL_DEPTH_WRITEMASK, &depthMask );
+
+	current.state = 0;
+	if ( glIsEnabled( GL_DEPTH_TEST ) )
+		current.state |= DepthTest;
+	if ( depthMask )
+		current.state |= DepthWrite;
+	if ( glIsEnabled( GL_BLEND ) )
+		current.state |= Blend;
+	if ( glIsEnabled( GL_CULL_FACE ) )
+		current.state |= Cull;
+
+	GLfloat m[16];
+	glGetFloatv( GL_MODELVIEW_MATRIX, m );
+	modelview = { fromGLMatrix( m ) };
+	glGetFloatv( GL_PROJECTION_MATRIX, m );
+	projection = fromGLMatrix( m );
+
+	savedStates.resize( 0 );
+}
+
+void DebugDraw::end( QOpenGLFunctions * fn )
 {
+	if ( depth == 0 || --depth > 0 )
+		return;
+
+	if ( active == this )
+		active = nullptr;
+
+	if ( runs.isEmpty() )
+		return;
+
+	buffer.upload( fn, vertices.constData(), vertices.count() * sizeof(Vertex) );
+
+	glPushAttrib( GL_ENABLE_BIT | GL_CURRENT_BIT | GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT | GL_LINE_BIT | GL_POINT_BIT | GL_POLYGON_BIT );
+	glPushClientAttrib( GL_CLIENT_VERTEX_ARRAY_BIT );
+
+	// The vertices are in clip space already
+	glMatrixMode( GL_PROJECTION );
 	glPushMatrix();
-	glTranslate( c );
-	GLfloat arrow = axis / 36.0;
-	glBegin( GL_LINES );
-	if ( color )
-		glColor3f( 1.0, 0.0, 0.0 );
-	glVertex3f( -axis, 0, 0 );
-	glVertex3f( +axis, 0, 0 );
-	glVertex3f( +axis, 0, 0 );
-	glVertex3f( +axis - 3 * arrow, +arrow, +arrow );
-	glVertex3f( +axis, 0, 0 );
-	glVertex3f( +axis - 3 * arrow, -arrow, +arrow );
-	glVertex3f( +axis, 0, 0 );
-	glVertex3f( +axis - 3 * arrow, +arrow, -arrow );
-	glVertex3f( +axis, 0, 0 );
-	glVertex3f( +axis - 3 * arrow, -arrow, -arrow );
-	if ( color )
-		glColor3f( 0.0, 1.0, 0.0 );
-	glVertex3f( 0, -axis, 0 );
-	glVertex3f( 0, +axis, 0 );
-	glVertex3f( 0, +axis, 0 );
-	glVertex3f( +arrow, +axis - 3 * arrow, +arrow );
-	glVertex3f( 0, +axis, 0 );
-	glVertex3f( -arrow, +axis - 3 * arrow, +arrow );
-	glVertex3f( 0, +axis, 0 );
-	glVertex3f( +arrow, +axis - 3 * arrow, -arrow );
-	glVertex3f( 0, +axis, 0 );
-	glVertex3f( -arrow, +axis - 3 * arrow, -arrow );
-	if ( color )
-		glColor3f( 0.0, 0.0, 1.0 );
-	glVertex3f( 0, 0, -axis );
-	glVertex3f( 0, 0, +axis );
-	glVertex3f( 0, 0, +axis );
-	glVertex3f( +arrow, +arrow, +axis - 3 * arrow );
-	glVertex3f( 0, 0, +axis );
-	glVertex3f( -arrow, +arrow, +axis - 3 * arrow );
-	glVertex3f( 0, 0, +axis );
-	glVertex3f( +arrow, -arrow, +axis - 3 * arrow );
-	glVertex3f( 0, 0, +axis );
-	glVertex3f( -arrow, -arrow, +axis - 3 * arrow );
+	glLoadIdentity();
+	glMatrixMode( GL_MODELVIEW );
+	glPushMatrix();
+	glLoadIdentity();
+
+	glDisable( GL_LIGHTING );
+	glDisable( GL_TEXTURE_2D );
+	glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+
+	glDisableClientState( GL_NORMAL_ARRAY );
+	glDisableClientState( GL_TEXTURE_COORD_ARRAY );
+	glEnableClientState( GL_VERTEX_ARRAY );
+	glEnableClientState( GL_COLOR_ARRAY );
+	glVertexPointer( 4, GL_FLOAT, sizeof(Vertex), (const GLvoid *)offsetof( Vertex, pos ) );
+	glColorPointer( 4, GL_FLOAT, sizeof(Vertex), (const GLvoid *)offsetof( Vertex, color ) );
+
+	for ( const Run & run : runs ) {
+		if ( run.state & DepthTest )
+			glEnable( GL_DEPTH_TEST );
+		else
+			glDisable( GL_DEPTH_TEST );
+
+		if ( run.state & Blend )
+			glEnable( GL_BLEND );
+		else
+			glDisable( GL_BLEND );
+
+		if ( run.state & Cull )
+			glEnable( GL_CULL_FACE );
+		else
+			glDisable( GL_CULL_FACE );
+
+		glDepthMask( (run.state & DepthWrite) ? GL_TRUE : GL_FALSE );
+		glDepthFunc( run.depthFunc );
+
+		if ( run.mode == GL_POINTS )
+			glPointSize( run.size );
+		else if ( run.mode == GL_LINES )
+			glLineWidth( run.size );
+		else
+			glPolygonMode( GL_FRONT_AND_BACK, run.polygonMode );
+
+		glDrawArrays( run.mode, run.first, run.count );
+	}
+
+	glMatrixMode( GL_PROJECTION );
+	glPopMatrix();
+	glMatrixMode( GL_MODELVIEW );
+	glPopMatrix();
+
+	glPopClientAttrib();
+	glPopAttrib();
+
+	fn->glBindBuffer( GL_ARRAY_BUFFER, 0 );
+
+	vertices.resize( 0 );
+	runs.resize( 0 );
+}
+
+void DebugDraw::release( QOpenGLFunctions * fn )
+{
+	buffer.release( fn );
+	vertices.clear();
+	runs.clear();
+}
+
+void DebugDraw::draw( GLenum mode, const QVector<Vector3> & verts, const QVector<Color4> & colors, int flags )
+{
+	if ( verts.isEmpty() )
+		return;
+
+	if ( active ) {
+		active->add( mode, verts, colors, flags );
+		return;
+	}
+
+	bool cull = (flags & NoCull) && glIsEnabled( GL_CULL_FACE );
+	if ( cull )
+		glDisable( GL_CULL_FACE );
+
+	glBegin( mode );
+
+	for ( int i = 0; i < verts.count(); i++ ) {
+		if ( i < colors.count() )
+			glColor4f( colors[i][0], colors[i][1], colors[i][2], colors[i][3] );
+
+		glVertex3fv( verts[i].data() );
+	}
+
 	glEnd();
+
+	if ( cull )
+		glEnable( GL_CULL_FACE );
+}
+
+void DebugDraw::add( GLenum mode, const QVector<Vector3> & verts, const QVector<Color4> & colors, int flags )
+{
+	Run run;
+	run.mode = mode;
+	run.size = 0;
+	run.polygonMode = GL_FILL;
+
+	if ( mode == GL_POINTS )
+		run.size = current.pointSize;
+	else if ( mode == GL_LINES )
+		run.size = current.lineWidth;
+
+	if ( mode == GL_TRIANGLES )
+		run.polygonMode = current.polygonMode;
+
+	run.depthFunc = current.depthFunc;
+	run.state = current.state;
+	if ( flags & NoCull )
+		run.state &= ~Cull;
+
+	run.first = vertices.count();
+	run.count = verts.count();
+
+	// Continue the last run if nothing changed in between
+	if ( !runs.isEmpty() ) {
+		Run & last = runs.last();
+		if ( last.mode == run.mode && last.size == run.size && last.depthFunc == run.depthFunc
+			&& last.polygonMode == run.polygonMode && last.state == run.state )
+		{
+			last.count += run.count;
+			run.count = 0;
+		}
+	}
+
+	if ( run.count )
+		runs.append( run );
+
+	// Clip space transform, column major
+	Matrix4 clip = modelview.last() * projection;
+	const GLfloat * m = clip.data();
+
+	int first = vertices.count();
+	vertices.resize( first + verts.count() );
+	Vertex * out = vertices.data() + first;
+
+	for ( int i = 0; i < verts.count(); i++, out++ ) {
+		const Vector3 & v = verts[i];
+		for ( int r = 0; r < 4; r++ )
+			out->pos[r] = m[r] * v[0] + m[4 + r] * v[1] + m[8 + r] * v[2] + m[12 + r];
+
+		if ( i < colors.count() ) {
+			for ( int c = 0; c < 4; c++ )
+				out->color[c] = colors[i][c];
+		} else {
+			memcpy( out->color, current.color, sizeof(current.color) );
+		}
+	}
+}
+
+void DebugDraw::color( const Color3 & c )
+{
+	color( Color4( c ) );
+}
+
+void DebugDraw::color( const Color4 & c )
+{
+	glColor4fv( c.data() );
+
+	if ( active )
+		memcpy( active->current.color, c.data(), sizeof(active->current.color) );
+}
+
+void DebugDraw::color( const GLubyte * rgba )
+{
+	glColor4ubv( rgba );
+
+	if ( active ) {
+		for ( int c = 0; c < 4; c++ )
+			active->current.color[c] = rgba[c] / 255.0f;
+	}
+}
+
+void DebugDraw::lineWidth( GLfloat width )
+{
+	glLineWidth( width );
+
+	if ( active )
+		active->current.lineWidth = width;
+}
+
+void DebugDraw::pointSize( GLfloat size )
+{
+	glPointSize( size );
+
+	if ( active )
+		active->current.pointSize = size;
+}
+
+void DebugDraw::polygonMode( GLenum mode )
+{
+	glPolygonMode( GL_FRONT_AND_BACK, mode );
+
+	if ( active )
+		active->current.polygonMode = mode;
+}
+
+void DebugDraw::depthFunc( GLenum func )
+{
+	glDepthFunc( func );
+
+	if ( active )
+		active->current.depthFunc = func;
+}
+
+void DebugDraw::depthMask( GLboolean write )
+{
+	glDepthMask( write );
+
+	if ( active ) {
+		if ( write )
+			active->current.state |= DepthWrite;
+		else
+			active->current.state &= ~DepthWrite;
+	}
+}
+
+void DebugDraw::enable( GLenum cap )
+{
+	glEnable( cap );
+
+	if ( active )
+		active->current.state |= stateFlag( cap );
+}
+
+void DebugDraw::disable( GLenum cap )
+{
+	glDisable( cap );
+
+	if ( active )
+		active->current.state &= ~stateFlag( cap );
+}
+
+int DebugDraw::stateFlag( GLenum cap )
+{
+	switch ( cap ) {
+	case GL_DEPTH_TEST:
+		return DepthTest;
+	case GL_BLEND:
+		return Blend;
+	case GL_CULL_FACE:
+		return Cull;
+	default:
+		return 0;
+	}
+}
+
+void DebugDraw::pushAttrib( GLbitfield mask )
+{
+	glPushAttrib( mask );
+
+	if ( active ) {
+		SavedState saved = { mask, active->current };
+		active->savedStates.append( saved );
+	}
+}
+
+void DebugDraw::popAttrib()
+{
+	glPopAttrib();
+
+	if ( !active || active->savedStates.isEmpty() )
+		return;
+
+	SavedState saved = active->savedStates.takeLast();
+	DrawState & state = active->current;
+
+	// Restore what the attribute groups of the mask cover
+	int flags = 0;
+
+	if ( saved.mask & GL_CURRENT_BIT )
+		memcpy( state.color, saved.state.color, sizeof(state.color) );
+	if ( saved.mask & GL_LINE_BIT )
+		state.lineWidth = saved.state.lineWidth;
+	if ( saved.mask & GL_POINT_BIT )
+		state.pointSize = saved.state.pointSize;
+	if ( saved.mask & GL_ENABLE_BIT )
+		flags |= DepthTest | Blend | Cull;
+	if ( saved.mask & GL_COLOR_BUFFER_BIT )
+		flags |= Blend;
+
+	if ( saved.mask & GL_DEPTH_BUFFER_BIT ) {
+		flags |= DepthTest | DepthWrite;
+		state.depthFunc = saved.state.depthFunc;
+	}
+
+	if ( saved.mask & GL_POLYGON_BIT ) {
+		flags |= Cull;
+		state.polygonMode = saved.state.polygonMode;
+	}
+
+	state.state = (state.state & ~flags) | (saved.state.state & flags);
+}
+
+void DebugDraw::pushMatrix()
+{
+	glPushMatrix();
+
+	if ( active )
+		active->modelview.append( active->modelview.last() );
+}
+
+void DebugDraw::popMatrix()
+{
 	glPopMatrix();
+
+	if ( active && active->modelview.count() > 1 )
+		active->modelview.removeLast();
+}
+
+void DebugDraw::loadMatrix( const Matrix4 & m )
+{
+	glLoadMatrix( m );
+
+	if ( active )
+		active->modelview.last() = m;
+}
+
+void DebugDraw::loadMatrix( const Transform & t )
+{
+	loadMatrix( t.toMatrix4() );
+}
+
+void DebugDraw::multMatrix( const Matrix4 & m )
+{
+	glMultMatrix( m );
+
+	// Matrix4 holds the transpose of the GL matrix, so the product is reversed
+	if ( active )
+		active->modelview.last() = m * active->modelview.last();
+}
+
+void DebugDraw::multMatrix( const Transform & t )
+{
+	multMatrix( t.toMatrix4() );
+}
+
+
+/*
+ * draw primitives
+ */
+
+//! Appends the segments of a line strip as line pairs
+static void appendStrip( QVector<Vector3> & lines, const QVector<Vector3> & strip )
+{
+	for ( int i = 1; i < strip.count(); i++ )
+		lines << strip[i - 1] << strip[i];
+}
+
+//! Appends the triangles of a fan around @p center
+static void appendFan( QVector<Vector3> & tris, const Vector3 & center, const QVector<Vector3> & rim )
+{
+	for ( int i = 1; i < rim.count(); i++ )
+		tris << center << rim[i - 1] << rim[i];
+}
+
+//! Sine and cosine of the full turn in 2 * sd steps, computed once per subdivision
+static const QVector<Vector2> & unitCircle( int sd )
+{
+	static QHash<int, QVector<Vector2>> circles;
+
+	auto it = circles.find( sd );
+	if ( it == circles.end() ) {
+		QVector<Vector2> circle;
+		circle.reserve( sd * 2 + 1 );
+
+		for ( int i = 0; i <= sd * 2; i++ )
+			circle << Vector2( sin( PI / sd * i ), cos( PI / sd * i ) );
+
+		it = circles.insert( sd, circle );
+	}
+
+	return it.value();
+}
+
+//! Line pairs of a sphere of radius 1 around the origin, computed once per subdivision
+static const QVector<Vector3> & unitSphere( int sd )
+{
+	static QHash<int, QVector<Vector3>> spheres;
+
+	auto it = spheres.find( sd );
+	if ( it == spheres.end() ) {
+		const QVector<Vector2> & circle = unitCircle( sd );
+		QVector<Vector3> lines;
+
+		for ( int axis = 0; axis < 3; axis++ ) {
+			for ( int j = -sd; j <= sd; j++ ) {
+				float f = PI * float(j) / float(sd);
+				float o = cos( f );
+				float rj = sin( f );
+
+				QVector<Vector3> strip;
+				for ( const Vector2 & p : circle ) {
+					if ( axis == 0 )
+						strip << Vector3( p[0] * rj, p[1] * rj, o );
+					else if ( axis == 1 )
+						strip << Vector3( p[0] * rj, o, p[1] * rj );
+					else
+						strip << Vector3( o, p[0] * rj, p[1] * rj );
+				}
+
+				appendStrip( lines, strip );
+			}
+		}
+
+		it = spheres.insert( sd, lines );
+	}
+
+	return it.value();
+}
+
+void drawAxes( const Vector3 & c, float axis, bool color )
+{
+	GLfloat arrow = axis / 36.0;
+
+	QVector<Vector3> lines;
+	lines.reserve( 30 );
+
+	for ( int a = 0; a < 3; a++ ) {
+		// Tip of the arrow and the two other axes
+		int u = (a + 1) % 3;
+		int v = (a + 2) % 3;
+		Vector3 tip;
+		tip[a] = axis;
+
+		Vector3 back = tip;
+		back[a] -= 3 * arrow;
+
+		Vector3 base;
+		base[a] = -axis;
+
+		lines << c + base << c + tip;
+
+		for ( int s = 0; s < 4; s++ ) {
+			Vector3 barb = back;
+			barb[u] = (s & 1) ? -arrow : +arrow;
+			barb[v] = (s & 2) ? -arrow : +arrow;
+			lines << c + tip << c + barb;
+		}
+	}
+
+	QVector<Color4> colors;
+	if ( color ) {
+		const Color4 axisColors[3] = { Color4( 1, 0, 0, 1 ), Color4( 0, 1, 0, 1 ), Color4( 0, 0, 1, 1 ) };
+		for ( int a = 0; a < 3; a++ )
+			colors << QVector<Color4>( 10, axisColors[a] );
+	}
+
+	DebugDraw::draw( GL_LINES, lines, colors );
 }
 
 QVector<int> sortAxes( QVector<float> axesDots )
@@ -321,99 +909,63 @@ QVector<int> sortAxes( QVector<float> axesDots )
 
 void drawAxesOverlay( const Vector3 & c, float axis, QVector<int> axesOrder )
 {
-	glPushMatrix();
-	glTranslate( c );
 	GLfloat arrow = axis / 36.0;
 
 	glDisable( GL_LIGHTING );
 	glDepthFunc( GL_ALWAYS );
 	glLineWidth( 2.0f );
-	glBegin( GL_LINES );
-
-	// Render the X axis
-	std::function<void()> xAxis = [axis, arrow]() {
-		glColor3f( 1.0, 0.0, 0.0 );
-		glVertex3f( 0, 0, 0 );
-		glVertex3f( +axis, 0, 0 );
-		glVertex3f( +axis, 0, 0 );
-		glVertex3f( +axis - 3 * arrow, +arrow, +arrow );
-		glVertex3f( +axis, 0, 0 );
-		glVertex3f( +axis - 3 * arrow, -arrow, +arrow );
-		glVertex3f( +axis, 0, 0 );
-		glVertex3f( +axis - 3 * arrow, +arrow, -arrow );
-		glVertex3f( +axis, 0, 0 );
-		glVertex3f( +axis - 3 * arrow, -arrow, -arrow );
-	};
-
-	// Render the Y axis
-	std::function<void()> yAxis = [axis, arrow]() {
-		glColor3f( 0.0, 1.0, 0.0 );
-		glVertex3f( 0, 0, 0 );
-		glVertex3f( 0, +axis, 0 );
-		glVertex3f( 0, +axis, 0 );
-		glVertex3f( +arrow, +axis - 3 * arrow, +arrow );
-		glVertex3f( 0, +axis, 0 );
-		glVertex3f( -arrow, +axis - 3 * arrow, +arrow );
-		glVertex3f( 0, +axis, 0 );
-		glVertex3f( +arrow, +axis - 3 * arrow, -arrow );
-		glVertex3f( 0, +axis, 0 );
-		glVertex3f( -arrow, +axis - 3 * arrow, -arrow );
-	};
-
-	// Render the Z axis
-	std::function<void()> zAxis = [axis, arrow]() {
-		glColor3f( 0.0, 0.0, 1.0 );
-		glVertex3f( 0, 0, 0 );
-		glVertex3f( 0, 0, +axis );
-		glVertex3f( 0, 0, +axis );
-		glVertex3f( +arrow, +arrow, +axis - 3 * arrow );
-		glVertex3f( 0, 0, +axis );
-		glVertex3f( -arrow, +arrow, +axis - 3 * arrow );
-		glVertex3f( 0, 0, +axis );
-		glVertex3f( +arrow, -arrow, +axis - 3 * arrow );
-		glVertex3f( 0, 0, +axis );
-		glVertex3f( -arrow, -arrow, +axis - 3 * arrow );
-	};
-
-	// List of the lambdas
-	QVector<std::function<void()>> axes = { xAxis, yAxis, zAxis };
+
+	QVector<Vector3> lines;
+	QVector<Color4> colors;
 
 	// Render the axes in the given order
-	//	e.g. {2, 1, 0} = zAxis(); yAxis(); xAxis();
-	for ( auto i : axesOrder ) {
-		axes[i]();
+	//	e.g. {2, 1, 0} = Z, Y, X
+	for ( auto a : axesOrder ) {
+		int u = (a + 1) % 3;
+		int v = (a + 2) % 3;
+		Vector3 tip;
+		tip[a] = axis;
+
+		Vector3 back = tip;
+		back[a] -= 3 * arrow;
+
+		lines << c << c + tip;
+
+		for ( int s = 0; s < 4; s++ ) {
+			Vector3 barb = back;
+			barb[u] = (s & 1) ? -arrow : +arrow;
+			barb[v] = (s & 2) ? -arrow : +arrow;
+			lines << c + tip << c + barb;
+		}
+
+		Color4 color( 0, 0, 0, 1 );
+		color[a] = 1.0;
+		colors << QVector<Color4>( 10, color );
 	}
 
-	glEnd();
-	glPopMatrix();
+	DebugDraw::draw( GL_LINES, lines, colors );
 }
 
 void drawBox( const Vector3 & a, const Vector3 & b )
 {
-	glBegin( GL_LINE_STRIP );
-	glVertex3f( a[0], a[1], a[2] );
-	glVertex3f( a[0], b[1], a[2] );
-	glVertex3f( a[0], b[1], b[2] );
-	glVertex3f( a[0], a[1], b[2] );
-	glVertex3f( a[0], a[1], a[2] );
-	glEnd();
-	glBegin( GL_LINE_STRIP );
-	glVertex3f( b[0], a[1], a[2] );
-	glVertex3f( b[0], b[1], a[2] );
-	glVertex3f( b[0], b[1], b[2] );
-	glVertex3f( b[0], a[1], b[2] );
-	glVertex3f( b[0], a[1], a[2] );
-	glEnd();
-	glBegin( GL_LINES );
-	glVertex3f( a[0], a[1], a[2] );
-	glVertex3f( b[0], a[1], a[2] );
-	glVertex3f( a[0], b[1], a[2] );
-	glVertex3f( b[0], b[1], a[2] );
-	glVertex3f( a[0], b[1], b[2] );
-	glVertex3f( b[0], b[1], b[2] );
-	glVertex3f( a[0], a[1], b[2] );
-	glVertex3f( b[0], a[1], b[2] );
-	glEnd();
+	QVector<Vector3> lines;
+	lines.reserve( 24 );
+
+	appendStrip( lines, {
+		Vector3( a[0], a[1], a[2] ), Vector3( a[0], b[1], a[2] ), Vector3( a[0], b[1], b[2] ),
+		Vector3( a[0], a[1], b[2] ), Vector3( a[0], a[1], a[2] )
+	} );
+	appendStrip( lines, {
+		Vector3( b[0], a[1], a[2] ), Vector3( b[0], b[1], a[2] ), Vector3( b[0], b[1], b[2] ),
+		Vector3( b[0], a[1], b[2] ), Vector3( b[0], a[1], a[2] )
+	} );
+
+	lines << Vector3( a[0], a[1], a[2] ) << Vector3( b[0], a[1], a[2] )
+	      << Vector3( a[0], b[1], a[2] ) << Vector3( b[0], b[1], a[2] )
+	      << Vector3( a[0], b[1], b[2] ) << Vector3( b[0], b[1], b[2] )
+	      << Vector3( a[0], a[1], b[2] ) << Vector3( b[0], a[1], b[2] );
+
+	DebugDraw::draw( GL_LINES, lines );
 }
 
 void drawGrid( int s /* grid size */, int line /* line spacing */, int sub /* # subdivisions */ )
@@ -423,25 +975,24 @@ void drawGrid( int s /* grid size */, int line /* line spacing */, int sub /* #
 	glLineWidth( 1.0f );
 	glColor4f( 1.0f, 1.0f, 1.0f, 0.2f );
 
-	glBegin( GL_LINES );
+	QVector<Vector3> lines;
 	for ( int i = -s; i <= s; i += line ) {
-		glVertex3f( i, -s, 0.0f );
-		glVertex3f( i, s, 0.0f );
-		glVertex3f( -s, i, 0.0f );
-		glVertex3f( s, i, 0.0f );
+		lines << Vector3( i, -s, 0.0f ) << Vector3( i, s, 0.0f );
+		lines << Vector3( -s, i, 0.0f ) << Vector3( s, i, 0.0f );
 	}
-	glEnd();
+
+	DebugDraw::draw( GL_LINES, lines );
 
 	glColor4f( 1.0f, 1.0f, 1.0f, 0.1f );
 	glLineWidth( 0.25f );
-	glBegin( GL_LINES );
+
+	lines.resize( 0 );
 	for ( int i = -s; i <= s; i += line/sub ) {
-		glVertex3f( i, -s, 0.0f );
-		glVertex3f( i, s, 0.0f );
-		glVertex3f( -s, i, 0.0f );
-		glVertex3f( s, i, 0.0f );
+		lines << Vector3( i, -s, 0.0f ) << Vector3( i, s, 0.0f );
+		lines << Vector3( -s, i, 0.0f ) << Vector3( s, i, 0.0f );
 	}
-	glEnd();
+
+	DebugDraw::draw( GL_LINES, lines );
 	glDisable( GL_BLEND );
 }
 
@@ -454,15 +1005,18 @@ void drawCircle( const Vector3 & c, const Vector3 & n, float r, int sd )
 
 void drawArc( const Vector3 & c, const Vector3 & x, const Vector3 & y, float an, float ax, int sd )
 {
-	glBegin( GL_LINE_STRIP );
+	QVector<Vector3> strip;
+	strip.reserve( sd + 1 );
 
 	for ( int j = 0; j <= sd; j++ ) {
 		float f = ( ax - an ) * float(j) / float(sd) + an;
 
-		glVertex( c + x * sin( f ) + y * cos( f ) );
+		strip << c + x * sin( f ) + y * cos( f );
 	}
 
-	glEnd();
+	QVector<Vector3> lines;
+	appendStrip( lines, strip );
+	DebugDraw::draw( GL_LINES, lines );
 }
 
 void drawCone( const Vector3 & c, Vector3 n, float a, int sd )
@@ -474,29 +1028,20 @@ void drawCone( const Vector3 & c, Vector3 n, float a, int sd )
 	y = y * sin( a );
 	n = n * cos( a );
 
-	glBegin( GL_TRIANGLE_FAN );
-	glVertex( c );
-
-	for ( int i = 0; i <= sd; i++ ) {
-		float f = ( 2 * PI * float(i) / float(sd) );
-
-		glVertex( c + n + x * sin( f ) + y * cos( f ) );
-	}
-
-	glEnd();
-
-	// double-sided, please
-
-	glBegin( GL_TRIANGLE_FAN );
-	glVertex( c );
+	QVector<Vector3> front, back;
 
 	for ( int i = 0; i <= sd; i++ ) {
 		float f = ( 2 * PI * float(i) / float(sd) );
 
-		glVertex( c + n + x * sin( -f ) + y * cos( -f ) );
+		front << c + n + x * sin( f ) + y * cos( f );
+		// double-sided, please
+		back << c + n + x * sin( -f ) + y * cos( -f );
 	}
 
-	glEnd();
+	QVector<Vector3> tris;
+	appendFan( tris, c, front );
+	appendFan( tris, c, back );
+	DebugDraw::draw( GL_TRIANGLES, tris );
 }
 
 void drawRagdollCone( const Vector3 & pivot, const Vector3 & twist, const Vector3 & plane, float coneAngle, float minPlaneAngle, float maxPlaneAngle, int sd )
@@ -507,41 +1052,30 @@ void drawRagdollCone( const Vector3 & pivot, const Vector3 & twist, const Vector
 
 	x = x * sin( coneAngle );
 
-	glBegin( GL_TRIANGLE_FAN );
-	glVertex( pivot );
+	QVector<Vector3> front, back;
 
 	for ( int i = 0; i <= sd; i++ ) {
 		float f = ( 2.0f * PI * float(i) / float(sd) );
 
 		Vector3 xy = x * sin( f ) + y * sin( f <= PI / 2 || f >= 3 * PI / 2 ? maxPlaneAngle : -minPlaneAngle ) * cos( f );
 
-		glVertex( pivot + z * sqrt( 1 - xy.length() * xy.length() ) + xy );
-	}
-
-	glEnd();
-
-	// double-sided, please
-
-	glBegin( GL_TRIANGLE_FAN );
-	glVertex( pivot );
-
-	for ( int i = 0; i <= sd; i++ ) {
-		float f = ( 2.0f * PI * float(i) / float(sd) );
+		front << pivot + z * sqrt( 1 - xy.length() * xy.length() ) + xy;
 
-		Vector3 xy = x * sin( -f ) + y * sin( -f <= PI / 2 || -f >= 3 * PI / 2 ? maxPlaneAngle : -minPlaneAngle ) * cos( -f );
+		// double-sided, please
+		xy = x * sin( -f ) + y * sin( -f <= PI / 2 || -f >= 3 * PI / 2 ? maxPlaneAngle : -minPlaneAngle ) * cos( -f );
 
-		glVertex( pivot + z * sqrt( 1 - xy.length() * xy.length() ) + xy );
+		back << pivot + z * sqrt( 1 - xy.length() * xy.length() ) + xy;
 	}
 
-	glEnd();
+	QVector<Vector3> tris;
+	appendFan( tris, pivot, front );
+	appendFan( tris, pivot, back );
+	DebugDraw::draw( GL_TRIANGLES, tris );
 }
 
 void drawSpring( const Vector3 & a, const Vector3 & b, float stiffness, int sd, bool solid )
 {
 	// draw a spring with stiffness turns
-	bool cull = glIsEnabled( GL_CULL_FACE );
-	glDisable( GL_CULL_FACE );
-
 	Vector3 h = b - a;
 
 	float r = h.length() / 5;
@@ -558,30 +1092,31 @@ void drawSpring( const Vector3 & a, const Vector3 & b, float stiffness, int sd,
 	x *= r;
 	y *= r;
 
-	glBegin( GL_LINES );
-	glVertex( a );
-	glVertex( a + x * sinf( 0 ) + y * cosf( 0 ) );
-	glEnd();
-	glBegin( solid ? GL_QUAD_STRIP : GL_LINE_STRIP );
 	int m = int(stiffness * sd);
 
+	QVector<Vector3> lines, tris, outer, inner;
+	lines << a << a + x * sinf( 0 ) + y * cosf( 0 );
+
 	for ( int i = 0; i <= m; i++ ) {
 		float f = 2 * PI * float(i) / float(sd);
 
-		glVertex( a + h * i / m + x * sinf( f ) + y * cosf( f ) );
+		outer << a + h * i / m + x * sinf( f ) + y * cosf( f );
 
 		if ( solid )
-			glVertex( a + h * i / m + x * 0.8f * sinf( f ) + y * 0.8f * cosf( f ) );
+			inner << a + h * i / m + x * 0.8f * sinf( f ) + y * 0.8f * cosf( f );
 	}
 
-	glEnd();
-	glBegin( GL_LINES );
-	glVertex( b + x * sinf( 2 * PI * float(m) / float(sd) ) + y * cosf( 2 * PI * float(m) / float(sd) ) );
-	glVertex( b );
-	glEnd();
+	if ( solid ) {
+		for ( int i = 1; i < outer.count(); i++ )
+			tris << outer[i - 1] << inner[i - 1] << outer[i] << outer[i] << inner[i - 1] << inner[i];
+	} else {
+		appendStrip( lines, outer );
+	}
 
-	if ( cull )
-		glEnable( GL_CULL_FACE );
+	lines << b + x * sinf( 2 * PI * float(m) / float(sd) ) + y * cosf( 2 * PI * float(m) / float(sd) ) << b;
+
+	DebugDraw::draw( GL_LINES, lines );
+	DebugDraw::draw( GL_TRIANGLES, tris, QVector<Color4>(), DebugDraw::NoCull );
 }
 
 void drawRail( const Vector3 & a, const Vector3 & b )
@@ -598,50 +1133,41 @@ void drawRail( const Vector3 & a, const Vector3 & b )
 
 	x.normalize();
 
-	glBegin( GL_POINTS );
-	glVertex( a );
-	glVertex( b );
-	glEnd();
+	DebugDraw::draw( GL_POINTS, { a, b } );
 
 	/* draw the rail */
-	glBegin( GL_LINES );
-	glVertex( a + x );
-	glVertex( b + x );
-	glVertex( a - x );
-	glVertex( b - x );
-	glEnd();
+	QVector<Vector3> lines;
+	lines << a + x << b + x << a - x << b - x;
 
 	int len = int( off.length() );
 
 	/* draw the logs */
-	glBegin( GL_LINES );
-
 	for ( int i = 0; i <= len; i++ ) {
 		float rel_off = ( 1.0f * i ) / len;
-		glVertex( a + off * rel_off + x * 1.3f );
-		glVertex( a + off * rel_off - x * 1.3f );
+		lines << a + off * rel_off + x * 1.3f << a + off * rel_off - x * 1.3f;
 	}
 
-	glEnd();
+	DebugDraw::draw( GL_LINES, lines );
 }
 
 void drawSolidArc( const Vector3 & c, const Vector3 & n, const Vector3 & x, const Vector3 & y, float an, float ax, float r, int sd )
 {
-	bool cull = glIsEnabled( GL_CULL_FACE );
-	glDisable( GL_CULL_FACE );
-	glBegin( GL_QUAD_STRIP );
+	QVector<Vector3> tris;
+	tris.reserve( sd * 6 );
+
+	Vector3 prev;
 
 	for ( int j = 0; j <= sd; j++ ) {
 		float f = ( ax - an ) * float(j) / float(sd) + an;
+		Vector3 p = c + x * r * sin( f ) + y * r * cos( f );
 
-		glVertex( c + x * r * sin( f ) + y * r * cos( f ) + n );
-		glVertex( c + x * r * sin( f ) + y * r * cos( f ) - n );
-	}
+		if ( j > 0 )
+			tris << prev + n << prev - n << p + n << p + n << prev - n << p - n;
 
-	glEnd();
+		prev = p;
+	}
 
-	if ( cull )
-		glEnable( GL_CULL_FACE );
+	DebugDraw::draw( GL_TRIANGLES, tris, QVector<Color4>(), DebugDraw::NoCull );
 }
 
 void drawSphereSimple( const Vector3 & c, float r, int sd )
@@ -653,44 +1179,13 @@ void drawSphereSimple( const Vector3 & c, float r, int sd )
 
 void drawSphere( const Vector3 & c, float r, int sd )
 {
-	for ( int j = -sd; j <= sd; j++ ) {
-		float f = PI * float(j) / float(sd);
-		Vector3 cj = c + Vector3( 0, 0, r * cos( f ) );
-		float rj = r * sin( f );
-
-		glBegin( GL_LINE_STRIP );
-
-		for ( int i = 0; i <= sd * 2; i++ )
-			glVertex( Vector3( sin( PI / sd * i ), cos( PI / sd * i ), 0 ) * rj + cj );
-
-		glEnd();
-	}
-
-	for ( int j = -sd; j <= sd; j++ ) {
-		float f = PI * float(j) / float(sd);
-		Vector3 cj = c + Vector3( 0, r * cos( f ), 0 );
-		float rj = r * sin( f );
-
-		glBegin( GL_LINE_STRIP );
-
-		for ( int i = 0; i <= sd * 2; i++ )
-			glVertex( Vector3( sin( PI / sd * i ), 0, cos( PI / sd * i ) ) * rj + cj );
-
-		glEnd();
-	}
-
-	for ( int j = -sd; j <= sd; j++ ) {
-		float f = PI * float(j) / float(sd);
-		Vector3 cj = c + Vector3( r * cos( f ), 0, 0 );
-		float rj = r * sin( f );
-
-		glBegin( GL_LINE_STRIP );
+	const QVector<Vector3> & unit = unitSphere( sd );
 
-		for ( int i = 0; i <= sd * 2; i++ )
-			glVertex( Vector3( 0, sin( PI / sd * i ), cos( PI / sd * i ) ) * rj + cj );
+	QVector<Vector3> lines( unit.count() );
+	for ( int i = 0; i < unit.count(); i++ )
+		lines[i] = unit[i] * r + c;
 
-		glEnd();
-	}
+	DebugDraw::draw( GL_LINES, lines );
 }
 
 void drawCapsule( const Vector3 & a, const Vector3 & b, float r, int sd )
@@ -712,108 +1207,107 @@ void drawCapsule( const Vector3 & a, const Vector3 & b, float r, int sd )
 	x *= r;
 	y *= r;
 
-	glBegin( GL_LINE_STRIP );
+	const QVector<Vector2> & circle = unitCircle( sd );
 
-	for ( int i = 0; i <= sd * 2; i++ )
-		glVertex( a + d / 2 + x * sin( PI / sd * i ) + y * cos( PI / sd * i ) );
+	QVector<Vector3> lines, strip;
+	lines.reserve( circle.count() * (4 * sd + 6) );
 
-	glEnd();
-	glBegin( GL_LINES );
+	for ( const Vector2 & p : circle )
+		strip << a + d / 2 + x * p[0] + y * p[1];
 
-	for ( int i = 0; i <= sd * 2; i++ ) {
-		glVertex( a + x * sin( PI / sd * i ) + y * cos( PI / sd * i ) );
-		glVertex( b + x * sin( PI / sd * i ) + y * cos( PI / sd * i ) );
-	}
+	appendStrip( lines, strip );
 
-	glEnd();
+	for ( const Vector2 & p : circle )
+		lines << a + x * p[0] + y * p[1] << b + x * p[0] + y * p[1];
 
 	for ( int j = 0; j <= sd; j++ ) {
 		float f = PI * float(j) / float(sd * 2);
 		Vector3 dj = n * r * cos( f );
 		float rj = sin( f );
 
-		glBegin( GL_LINE_STRIP );
-
-		for ( int i = 0; i <= sd * 2; i++ )
-			glVertex( a - dj + x * sin( PI / sd * i ) * rj + y * cos( PI / sd * i ) * rj );
+		strip.resize( 0 );
+		for ( const Vector2 & p : circle )
+			strip << a - dj + x * p[0] * rj + y * p[1] * rj;
 
-		glEnd();
-		glBegin( GL_LINE_STRIP );
+		appendStrip( lines, strip );
 
-		for ( int i = 0; i <= sd * 2; i++ )
-			glVertex( b + dj + x * sin( PI / sd * i ) * rj + y * cos( PI / sd * i ) * rj );
+		strip.resize( 0 );
+		for ( const Vector2 & p : circle )
+			strip << b + dj + x * p[0] * rj + y * p[1] * rj;
 
-		glEnd();
+		appendStrip( lines, strip );
 	}
+
+	DebugDraw::draw( GL_LINES, lines );
 }
 
 
 void drawCylinder( const Vector3 & a, const Vector3 & b, float r, int sd )
 {
-    Vector3 d = b - a;
-
-    if ( d.length() < 0.001 ) {
-        drawSphere( a, r );
-        return;
-    }
+	Vector3 d = b - a;
 
-    Vector3 n = d;
-    n.normalize();
+	if ( d.length() < 0.001 ) {
+		drawSphere( a, r );
+		return;
+	}
 
-    Vector3 x( n[ 1 ], n[ 2 ], n[ 0 ] );
-    Vector3 y = Vector3::crossproduct( n, x );
-    x = Vector3::crossproduct( n, y );
+	Vector3 n = d;
+	n.normalize();
 
-    x *= r;
-    y *= r;
+	Vector3 x( n[ 1 ], n[ 2 ], n[ 0 ] );
+	Vector3 y = Vector3::crossproduct( n, x );
+	x = Vector3::crossproduct( n, y );
 
-    //Render mid-line
-    glBegin( GL_LINE_STRIP );
+	x *= r;
+	y *= r;
 
-    for ( int i = 0; i <= sd * 2; i++ )
-        glVertex( a + d / 2 + x * sin( PI / sd * i ) + y * cos( PI / sd * i ) );
+	const QVector<Vector2> & circle = unitCircle( sd );
 
-    glEnd();
-    //Render connecting lines
-    glBegin( GL_LINES );
+	QVector<Vector3> lines, strip;
 
-    for ( int i = 0; i <= sd * 2; i++ ) {
-        glVertex( a + x * sin( PI / sd * i ) + y * cos( PI / sd * i ) );
-        glVertex( b + x * sin( PI / sd * i ) + y * cos( PI / sd * i ) );
-    }
+	//Render mid-line
+	for ( const Vector2 & p : circle )
+		strip << a + d / 2 + x * p[0] + y * p[1];
 
-    glEnd();
+	appendStrip( lines, strip );
 
-    //Render end lines
-    for ( int j = 0; j <= sd; j++ ) {
-        //float f = PI * float( j ) / float( sd * 2 );
+	//Render connecting lines
+	for ( const Vector2 & p : circle )
+		lines << a + x * p[0] + y * p[1] << b + x * p[0] + y * p[1];
 
-        glBegin( GL_LINE_STRIP );
+	//Render end lines
+	strip.resize( 0 );
+	for ( const Vector2 & p : circle )
+		strip << a + x * p[0] + y * p[1];
 
-        for ( int i = 0; i <= sd * 2; i++ )
-            glVertex( a  + x * sin( PI / sd * i ) + y * cos( PI / sd * i ) );
+	appendStrip( lines, strip );
 
-        glEnd();
-        //Render rear face
-        glBegin( GL_LINE_STRIP );
+	//Render rear face
+	strip.resize( 0 );
+	for ( const Vector2 & p : circle )
+		strip << b + x * p[0] + y * p[1];
 
-        for ( int i = 0; i <= sd * 2; i++ )
-            glVertex( b + x * sin( PI / sd * i ) + y * cos( PI / sd * i ) );
+	appendStrip( lines, strip );
 
-        glEnd();
-    }
+	DebugDraw::draw( GL_LINES, lines );
 }
 
 void drawDashLine( const Vector3 & a, const Vector3 & b, int sd )
 {
 	Vector3 d = ( b - a ) / float(sd);
-	glBegin( GL_LINES );
+
+	QVector<Vector3> lines;
+	lines.reserve( sd + 1 );
 
 	for ( int c = 0; c <= sd; c++ ) {
-		glVertex( a + d * c );
+		lines << a + d * c;
 	}
 
-	glEnd();
+	// An odd vertex count leaves the last dash out, like GL_LINES did
+	if ( lines.count() % 2 )
+		lines.removeLast();
+
+	DebugDraw::draw( GL_LINES, lines );
 }
 
 //! Find the dot product of two vectors
@@ -827,8 +1321,7 @@ static Vector3 crossproduct( const Vector3 & a, const Vector3 & b )
 	return Vector3( a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0] );
 }
 
-//! Generate triangles for convex hull
-static QVector<Vector3> generateTris( const NifModel * nif, const QModelIndex & iShape, float scale )
+QVector<Vector3> convexHullTriangles( const NifModel * nif, const QModelIndex & iShape, float scale )
 {
 	QVector<Vector4> vertices = nif->getArray<Vector4>( iShape, "Vertices" );
 	//QVector<Vector4> normals = nif->getArray<Vector4>( iShape, "Normals" );
@@ -894,46 +1387,16 @@ static QVector<Vector3> generateTris( const NifModel * nif, const QModelIndex &
 	return tris;
 }
 
-void drawConvexHull( const NifModel * nif, const QModelIndex & iShape, float scale, bool solid )
+QVector<Vector3> niTSSTriangles( const NifModel * nif, const QModelIndex & iShape )
 {
-	static QMap<QModelIndex, QVector<Vector3>> shapes;
-	QVector<Vector3> shape;
-
-	shape = shapes[iShape];
-
-	if ( shape.empty() ) {
-		shape = generateTris( nif, iShape, scale );
-		shapes[iShape] = shape;
-	}
-
-	glPolygonMode( GL_FRONT_AND_BACK, solid ? GL_FILL : GL_LINE );
-	glDisable( GL_CULL_FACE );
-	glBegin( GL_TRIANGLES );
-
-	for ( int i = 0; i < shape.count(); i += 3 ) {
-		// DRAW ABC
-		glVertex( shape[i] );
-		glVertex( shape[i+1] );
-		glVertex( shape[i+2] );
-	}
-
-	glEnd();
-	glPolygonMode( GL_FRONT_AND_BACK, solid ? GL_LINE : GL_FILL );
-	glEnable( GL_CULL_FACE );
-}
+	QVector<Vector3> tris;
 
-void drawNiTSS( const NifModel * nif, const QModelIndex & iShape, bool solid )
-{
 	QModelIndex iStrips = nif->getIndex( iShape, "Strips Data" );
 	for ( int r = 0; r < nif->rowCount( iStrips ); r++ ) {
 		QModelIndex iStripData = nif->getBlock( nif->getLink( iStrips.child( r, 0 ) ), "NiTriStripsData" );
 		if ( iStripData.isValid() ) {
 			QVector<Vector3> verts = nif->getArray<Vector3>( iStripData, "Vertices" );
 
-			glPolygonMode( GL_FRONT_AND_BACK, solid ? GL_FILL : GL_LINE );
-			glDisable( GL_CULL_FACE );
-			glBegin( GL_TRIANGLES );
-
 			QModelIndex iPoints = nif->getIndex( iStripData, "Points" );
 			for ( int r = 0; r < nif->rowCount( iPoints ); r++ ) {	// draw the strips like they appear in the tescs
 				// (use the unstich strips spell to avoid the spider web effect)
@@ -944,24 +1407,22 @@ void drawNiTSS( const NifModel * nif, const QModelIndex & iShape, bool solid )
 
 					for ( int x = 2; x < strip.size(); x++ ) {
 						quint16 c = strip[x];
-						glVertex( verts.value( a ) );
-						glVertex( verts.value( b ) );
-						glVertex( verts.value( c ) );
+						tris << verts.value( a ) << verts.value( b ) << verts.value( c );
 						a = b;
 						b = c;
 					}
 				}
 			}
-
-			glEnd();
-			glEnable( GL_CULL_FACE );
-			glPolygonMode( GL_FRONT_AND_BACK, solid ? GL_LINE : GL_FILL );
 		}
 	}
+
+	return tris;
 }
 
-void drawCMS( const NifModel * nif, const QModelIndex & iShape, bool solid )
+QVector<Vector3> cmsTriangles( const NifModel * nif, const QModelIndex & iShape )
 {
+	QVector<Vector3> tris;
+
 	// Scale up for Skyrim
 	float havokScale = (nif->checkVersion( 0x14020007, 0x14020007 ) && nif->getUserVersion() >= 12) ? 10.0f : 1.0f;
 
@@ -976,26 +1437,15 @@ void drawCMS( const NifModel * nif, const QModelIndex & iShape, bool solid )
 
 		QVector<Vector4> verts = nif->getArray<Vector4>( iBigVerts );
 
-		glPolygonMode( GL_FRONT_AND_BACK, solid ? GL_FILL : GL_LINE );
-		glDisable( GL_CULL_FACE );
-
 		for ( int r = 0; r < nif->rowCount( iBigTris ); r++ ) {
 			quint16 a = nif->get<quint16>( iBigTris.child( r, 0 ), "Triangle 1" );
 			quint16 b = nif->get<quint16>( iBigTris.child( r, 0 ), "Triangle 2" );
 			quint16 c = nif->get<quint16>( iBigTris.child( r, 0 ), "Triangle 3" );
 
-			glBegin( GL_TRIANGLES );
-
-			glVertex( verts[a] * havokScale );
-			glVertex( verts[b] * havokScale );
-			glVertex( verts[c] * havokScale );
-
-			glEnd();
+			tris << Vector3( verts.value( a ) * havokScale ) << Vector3( verts.value( b ) * havokScale )
+			     << Vector3( verts.value( c ) * havokScale );
 		}
 
-		glPolygonMode( GL_FRONT_AND_BACK, solid ? GL_LINE : GL_FILL );
-		glEnable( GL_CULL_FACE );
-
 		QModelIndex iChunks = nif->getIndex( iData, "Chunks" );
 		for ( int r = 0; r < nif->rowCount( iChunks ); r++ ) {
 			Vector4 chunkOrigin = nif->get<Vector4>( iChunks.child( r, 0 ), "Translation" );
@@ -1026,9 +1476,6 @@ void drawCMS( const NifModel * nif, const QModelIndex & iShape, bool solid )
 				vertices[n] *= havokScale;
 			}
 
-			glPolygonMode( GL_FRONT_AND_BACK, solid ? GL_FILL : GL_LINE );
-			glDisable( GL_CULL_FACE );
-
 			Transform trans;
 			trans.rotation.fromQuat( chunkRotation );
 
@@ -1036,15 +1483,9 @@ void drawCMS( const NifModel * nif, const QModelIndex & iShape, bool solid )
 			for ( int s = 0; s < (int)numStrips; s++ ) {
 
 				for ( int idx = 0; idx < strips[s] - 2; idx++ ) {
-
-					glBegin( GL_TRIANGLES );
-
-					glVertex( trans.rotation * Vector3( vertices[indices[offset + idx]] ) );
-					glVertex( trans.rotation * Vector3( vertices[indices[offset + idx + 1]] ) );
-					glVertex( trans.rotation * Vector3( vertices[indices[offset + idx + 2]] ) );
-
-					glEnd();
-
+					tris << trans.rotation * Vector3( vertices[indices[offset + idx]] )
+					     << trans.rotation * Vector3( vertices[indices[offset + idx + 1]] )
+					     << trans.rotation * Vector3( vertices[indices[offset + idx + 2]] );
 				}
 
 				offset += strips[s];
@@ -1053,21 +1494,33 @@ void drawCMS( const NifModel * nif, const QModelIndex & iShape, bool solid )
 
 			// Non-stripped tris
 			for ( int f = 0; f < (int)(numIndices - offset); f += 3 ) {
-				glBegin( GL_TRIANGLES );
+				tris << trans.rotation * Vector3( vertices[indices[offset + f]] )
+				     << trans.rotation * Vector3( vertices[indices[offset + f + 1]] )
+				     << trans.rotation * Vector3( vertices[indices[offset + f + 2]] );
+			}
+		}
+	}
 
-				glVertex( trans.rotation * Vector3( vertices[indices[offset + f]] ) );
-				glVertex( trans.rotation * Vector3( vertices[indices[offset + f + 1]] ) );
-				glVertex( trans.rotation * Vector3( vertices[indices[offset + f + 2]] ) );
+	return tris;
+}
 
-				glEnd();
+void drawTriangleList( QOpenGLFunctions * fn, GLBuffer<Vector3> & buffer, const QVector<Vector3> & tris, bool solid )
+{
+	if ( !buffer.bind( fn, tris ) )
+		return;
 
-			}
+	DebugDraw::polygonMode( solid ? GL_FILL : GL_LINE );
+	DebugDraw::disable( GL_CULL_FACE );
 
-			glPolygonMode( GL_FRONT_AND_BACK, solid ? GL_LINE : GL_FILL );
-			glEnable( GL_CULL_FACE );
+	glEnableClientState( GL_VERTEX_ARRAY );
+	glVertexPointer( 3, GL_FLOAT, 0, nullptr );
+	glDrawArrays( GL_TRIANGLES, 0, tris.count() );
+	glDisableClientState( GL_VERTEX_ARRAY );
 
-		}
-	}
+	fn->glBindBuffer( GL_ARRAY_BUFFER, 0 );
+
+	DebugDraw::polygonMode( GL_FILL );
+	DebugDraw::enable( GL_CULL_FACE );
 }
 
 // Renders text using the font initialized in the primary view class
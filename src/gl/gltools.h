@@ -36,9 +36,13 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "data/niftypes.h"
 
 #include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QRect>
 
+#include <memory>
 
-//! @file gltools.h BoundSphere, VertexWeight, BoneWeights, SkinPartition
+
+//! @file gltools.h BoundSphere, Frustum, VertexWeight, BoneWeights, SkinPartition, GLBuffer, StreamBuffer, DebugDraw
 
 //! A bounding sphere for an object, typically a Mesh
 class BoundSphere final
@@ -64,6 +68,33 @@ public:
 	friend BoundSphere operator*( const Transform & t, const BoundSphere & s );
 };
 
+//! The planes of a view frustum in world space
+class Frustum final
+{
+public:
+	//! Creates a frustum that contains everything
+	Frustum() {}
+
+	//! Creates the frustum of the current GL projection matrix looking through @p view, narrowed to @p window in viewport pixels if it is valid
+	static Frustum fromProjection( const Transform & view, const QRect & window = QRect() );
+
+	enum Containment
+	{
+		Outside,
+		Intersects,
+		Inside
+	};
+
+	//! Tests a sphere against the planes; spheres without bounds always intersect
+	Containment contains( const BoundSphere & sphere ) const;
+
+protected:
+	//! Inward plane normals; a point p is inside a plane if dot( normal, p ) + distance >= 0
+	Vector3 normal[6];
+	float distance[6];
+	bool valid = false;
+};
+
 //! A vertex, weight pair
 class VertexWeight final
 {
@@ -114,6 +145,231 @@ public:
 	QVector<QVector<quint16> > tristrips;
 };
 
+/*! A GPU buffer object mirroring a QVector
+ *
+ * The array is not kept. Code that rewrites the array calls invalidate(), and the
+ * next bind() uploads it; an array of another length is uploaded in any case.
+ * Arrays rewritten every frame are invalidated as GL_STREAM_DRAW, which orphans
+ * the storage the draws of the previous frame may still read.
+ *
+ * Copies share the buffer object until one of them is invalidated, which moves
+ * that copy onto a buffer object of its own.
+ */
+template <typename T> class GLBuffer final
+{
+public:
+	GLBuffer( GLenum t = GL_ARRAY_BUFFER ) : target( t ), d( std::make_shared<Storage>() ) {}
+
+	//! Marks the array as rewritten; @p usage is GL_STREAM_DRAW for arrays rewritten every frame
+	void invalidate( GLenum usage = GL_STATIC_DRAW );
+	//! Binds the buffer, uploading the array first if it was invalidated. Returns false if the array is empty.
+	bool bind( QOpenGLFunctions * fn, const QVector<T> & data );
+	//! Drops this copy, deleting the buffer object if no other copy uses it
+	void release( QOpenGLFunctions * fn );
+
+	//! Buffer object name, 0 if not created
+	GLuint id() const { return d->id; }
+
+private:
+	struct Storage
+	{
+		GLuint id = 0;
+		//! Length of the uploaded array
+		int count = 0;
+		//! Does the array need uploading?
+		bool dirty = true;
+		//! Usage of the next upload, and of the allocated storage
+		GLenum usage = GL_STATIC_DRAW;
+		GLenum allocated = 0;
+	};
+
+	GLenum target;
+	std::shared_ptr<Storage> d;
+};
+
+template <typename T> inline void GLBuffer<T>::invalidate( GLenum usage )
+{
+	// Leave the contents of a shared buffer object to the copies which still draw them
+	if ( d.use_count() > 1 )
+		d = std::make_shared<Storage>();
+
+	d->dirty = true;
+	d->usage = usage;
+}
+
+template <typename T> inline bool GLBuffer<T>::bind( QOpenGLFunctions * fn, const QVector<T> & data )
+{
+	if ( data.isEmpty() )
+		return false;
+
+	if ( !d->id )
+		fn->glGenBuffers( 1, &d->id );
+
+	fn->glBindBuffer( target, d->id );
+
+	if ( d->dirty || data.count() != d->count ) {
+		int size = data.count() * sizeof(T);
+		if ( data.count() != d->count || d->usage != d->allocated || d->usage == GL_STREAM_DRAW )
+			fn->glBufferData( target, size, data.constData(), d->usage );
+		else
+			fn->glBufferSubData( target, 0, size, data.constData() );
+
+		d->count = data.count();
+		d->allocated = d->usage;
+		d->dirty = false;
+	}
+
+	return true;
+}
+
+template <typename T> inline void GLBuffer<T>::release( QOpenGLFunctions * fn )
+{
+	if ( d->id && d.use_count() == 1 )
+		fn->glDeleteBuffers( 1, &d->id );
+
+	d = std::make_shared<Storage>();
+}
+
+//! A buffer object refilled every frame, orphaning the storage the previous draws may still read
+class StreamBuffer final
+{
+public:
+	StreamBuffer( GLenum t = GL_ARRAY_BUFFER ) : target( t ) {}
+
+	//! Binds the buffer and replaces its contents with @p size bytes of @p data
+	void upload( QOpenGLFunctions * fn, const void * data, int size );
+	//! Deletes the buffer object
+	void release( QOpenGLFunctions * fn );
+
+private:
+	GLenum target;
+	GLuint id = 0;
+	int capacity = 0;
+};
+
+/*! Batches the debug primitives drawn by the functions below
+ *
+ * While a batch is active, each primitive is transformed into clip space with the current
+ * matrices and appended to one vertex array together with the current color and the state
+ * it depends on. end() uploads the array into a single stream buffer and draws each run of
+ * primitives sharing the same state with one call, in the order they were submitted.
+ *
+ * Without an active batch the primitives are drawn right away in immediate mode.
+ */
+class DebugDraw final
+{
+public:
+	enum Flag
+	{
+		NoCull = 0x1 //!< Draw triangles from both sides
+	};
+
+	//! Starts collecting primitives; nested calls collect into the outermost batch
+	void begin();
+	//! Draws the primitives collected since the outermost begin()
+	void end( QOpenGLFunctions * fn );
+	//! Deletes the vertex buffer
+	void release( QOpenGLFunctions * fn );
+
+	//! Draws GL_POINTS, GL_LINES or GL_TRIANGLES in the current state, colored by @p colors if not empty
+	static void draw( GLenum mode, const QVector<Vector3> & verts, const QVector<Color4> & colors = QVector<Color4>(), int flags = 0 );
+
+	/*
+	 * Draw state
+	 *
+	 * These set the GL state like the GL functions of the same name and track it for the active batch,
+	 * which reads it from the CPU instead of querying GL for every primitive. Code that may draw inside
+	 * a batch changes the state through these, or restores it with glPopAttrib before drawing again.
+	 */
+
+	static void color( const Color3 & c );
+	static void color( const Color4 & c );
+	static void color( const GLubyte * rgba );
+	static void lineWidth( GLfloat width );
+	static void pointSize( GLfloat size );
+	//! Sets the polygon mode of front and back faces
+	static void polygonMode( GLenum mode );
+	static void depthFunc( GLenum func );
+	static void depthMask( GLboolean write );
+	static void enable( GLenum cap );
+	static void disable( GLenum cap );
+	static void pushAttrib( GLbitfield mask );
+	static void popAttrib();
+	//! Matrix stack functions; the matrix mode must be GL_MODELVIEW
+	static void pushMatrix();
+	static void popMatrix();
+	static void loadMatrix( const Matrix4 & m );
+	static void loadMatrix( const Transform & t );
+	static void multMatrix( const Matrix4 & m );
+	static void multMatrix( const Transform & t );
+
+private:
+	struct Vertex
+	{
+		GLfloat pos[4];
+		GLfloat color[4];
+	};
+
+	//! Consecutive primitives drawn with the same state
+	struct Run
+	{
+		GLenum mode;
+		GLfloat size;
+		GLint depthFunc;
+		GLint polygonMode;
+		int state;
+		int first;
+		int count;
+	};
+
+	enum State
+	{
+		DepthTest = 0x1,
+		DepthWrite = 0x2,
+		Blend = 0x4,
+		Cull = 0x8
+	};
+
+	//! The state tracked between begin() and end()
+	struct DrawState
+	{
+		GLfloat color[4];
+		GLfloat lineWidth;
+		GLfloat pointSize;
+		GLint depthFunc;
+		GLint polygonMode;
+		int state;
+	};
+
+	//! A pushAttrib() call
+	struct SavedState
+	{
+		GLbitfield mask;
+		DrawState state;
+	};
+
+	//! Queries the state once when the batch starts
+	void capture();
+	//! The State flag of an enable cap, 0 if not tracked
+	static int stateFlag( GLenum cap );
+	void add( GLenum mode, const QVector<Vector3> & verts, const QVector<Color4> & colors, int flags );
+
+	QVector<Vertex> vertices;
+	QVector<Run> runs;
+	int depth = 0;
+
+	DrawState current;
+	QVector<SavedState> savedStates;
+	//! The modelview matrix stack, the current matrix last
+	QVector<Matrix4> modelview;
+	Matrix4 projection;
+
+	StreamBuffer buffer;
+
+	//! The batch collecting primitives, nullptr if none
+	static DebugDraw * active;
+};
+
 QVector<int> sortAxes( QVector<float> axesDots );
 
 void drawAxes( const Vector3 & c, float axis, bool color = true );
@@ -130,9 +386,14 @@ void drawSphere( const Vector3 & c, float r, int sd = 8 );
 void drawCapsule( const Vector3 & a, const Vector3 & b, float r, int sd = 5 );
 void drawCylinder( const Vector3 & p1, const Vector3 & p2, float radius, int numSegments = 5 );
 void drawDashLine( const Vector3 & a, const Vector3 & b, int sd = 15 );
-void drawConvexHull( const NifModel * nif, const QModelIndex & iShape, float scale, bool solid = false );
-void drawNiTSS( const NifModel * nif, const QModelIndex & iShape, bool solid = false );
-void drawCMS( const NifModel * nif, const QModelIndex & iShape, bool solid = false );
+//! Triangles of the hull of a bhkConvexVerticesShape, three vertices each
+QVector<Vector3> convexHullTriangles( const NifModel * nif, const QModelIndex & iShape, float scale );
+//! Triangles of the strips of a bhkNiTriStripsShape, three vertices each
+QVector<Vector3> niTSSTriangles( const NifModel * nif, const QModelIndex & iShape );
+//! Triangles of the big triangles and chunks of a bhkCompressedMeshShape, three vertices each
+QVector<Vector3> cmsTriangles( const NifModel * nif, const QModelIndex & iShape );
+//! Draws triangles of three vertices each from a buffer object, as wireframe unless @p solid
+void drawTriangleList( QOpenGLFunctions * fn, GLBuffer<Vector3> & buffer, const QVector<Vector3> & tris, bool solid = false );
 void drawSpring( const Vector3 & a, const Vector3 & b, float stiffness, int sd = 16, bool solid = false );
 void drawRail( const Vector3 & a, const Vector3 & b );
 
@@ -59,6 +59,9 @@ bool shader_ready = true;
 
 bool Renderer::initialize()
 {
+	if ( !drawRangeElements )
+		drawRangeElements = (PFNGLDRAWRANGEELEMENTSPROC)cx->getProcAddress( "glDrawRangeElements" );
+
 	if ( !shader_initialized ) {
 
 		// check for OpenGL 2.0
@@ -117,28 +120,32 @@ Renderer::ConditionSingle::ConditionSingle( const QString & line, bool neg ) : i
 		left = line;
 		comp = NONE;
 	}
-}
-
-QModelIndex Renderer::ConditionSingle::getIndex( const NifModel * nif, const QVector<QModelIndex> & iBlocks, QString blkid ) const
-{
-	QString childid;
-
-	if ( blkid.startsWith( "HEADER/" ) )
-		return nif->getIndex( nif->getHeader(), blkid.remove( "HEADER/" ) );
 
-	int pos = blkid.indexOf( "/" );
+	// Split the operands once instead of on every evaluation
+	rightCount = right.toUInt( nullptr, 0 );
+	rightFloat = (float)right.toDouble();
 
-	if ( pos > 0 ) {
-		childid = blkid.right( blkid.length() - pos - 1 );
-		blkid = blkid.left( pos );
+	if ( left.startsWith( "HEADER/" ) ) {
+		headerField = true;
+		field = QString( left ).remove( "HEADER/" );
+	} else {
+		int slash = left.indexOf( "/" );
+		blockType = (slash > 0) ? left.left( slash ) : left;
+		field = (slash > 0) ? left.mid( slash + 1 ) : QString();
 	}
+}
 
-	for ( QModelIndex iBlock : iBlocks ) {
-		if ( nif->inherits( iBlock, blkid ) ) {
-			if ( childid.isEmpty() )
+QModelIndex Renderer::ConditionSingle::getIndex( const NifModel * nif, const QVector<QModelIndex> & iBlocks ) const
+{
+	if ( headerField )
+		return nif->getIndex( nif->getHeader(), field );
+
+	for ( const QModelIndex & iBlock : iBlocks ) {
+		if ( nif->inherits( iBlock, blockType ) ) {
+			if ( field.isEmpty() )
 				return iBlock;
 
-			return nif->getIndex( iBlock, childid );
+			return nif->getIndex( iBlock, field );
 		}
 	}
 	return QModelIndex();
@@ -146,7 +153,7 @@ QModelIndex Renderer::ConditionSingle::getIndex( const NifModel * nif, const QVe
 
 bool Renderer::ConditionSingle::eval( const NifModel * nif, const QVector<QModelIndex> & iBlocks ) const
 {
-	QModelIndex iLeft = getIndex( nif, iBlocks, left );
+	QModelIndex iLeft = getIndex( nif, iBlocks );
 
 	if ( !iLeft.isValid() )
 		return invert;
@@ -159,13 +166,13 @@ bool Renderer::ConditionSingle::eval( const NifModel * nif, const QVector<QModel
 	if ( val.isString() )
 		return compare( val.toString(), right ) ^ invert;
 	else if ( val.isCount() )
-		return compare( val.toCount(), right.toUInt( nullptr, 0 ) ) ^ invert;
+		return compare( val.toCount(), rightCount ) ^ invert;
 	else if ( val.isFloat() )
-		return compare( val.toFloat(), (float)right.toDouble() ) ^ invert;
+		return compare( val.toFloat(), rightFloat ) ^ invert;
 	else if ( val.isFileVersion() )
-		return compare( val.toFileVersion(), right.toUInt( nullptr, 0 ) ) ^ invert;
+		return compare( val.toFileVersion(), rightCount ) ^ invert;
 	else if ( val.type() == NifValue::tBSVertexDesc )
-		return compare( (uint)val.get<BSVertexDesc>().GetFlags(), right.toUInt( nullptr, 0 ) ) ^ invert;
+		return compare( (uint)val.get<BSVertexDesc>().GetFlags(), rightCount ) ^ invert;
 
 	return false;
 }
@@ -381,8 +388,10 @@ bool Renderer::Program::load( const QString & filepath, Renderer * renderer )
 
 void Renderer::Program::setUniformLocations()
 {
-	for ( int i = 0; i < NUM_UNIFORM_TYPES; i++ )
+	for ( int i = 0; i < NUM_UNIFORM_TYPES; i++ ) {
 		uniformLocations[i] = f->glGetUniformLocation( id, uniforms[i].c_str() );
+		uniformKnown[i] = false;
+	}
 }
 
 Renderer::Renderer( QOpenGLContext * c, QOpenGLFunctions * f )
@@ -390,7 +399,9 @@ Renderer::Renderer( QOpenGLContext * c, QOpenGLFunctions * f )
 {
 	updateSettings();
 
-	connect( NifSkope::getOptions(), &SettingsDialog::saveSettings, this, &Renderer::updateSettings );
+	// No settings dialog exists when rendering without a window
+	if ( NifSkope::getOptions() )
+		connect( NifSkope::getOptions(), &SettingsDialog::saveSettings, this, &Renderer::updateSettings );
 }
 
 Renderer::~Renderer()
@@ -459,6 +470,8 @@ void Renderer::releaseShaders()
 	if ( !shader_ready )
 		return;
 
+	useProgram( 0 );
+
 	qDeleteAll( programs );
 	programs.clear();
 	qDeleteAll( shaders );
@@ -467,6 +480,8 @@ void Renderer::releaseShaders()
 
 QString Renderer::setupProgram( Shape * mesh, const QString & hint )
 {
+	FrameProfiler::Scope scope( mesh->scene->profiler, FrameProfiler::SetupProgram );
+
 	PropertyList props;
 	mesh->activeProperties( props );
 
@@ -474,10 +489,20 @@ QString Renderer::setupProgram( Shape * mesh, const QString & hint )
 		 || (mesh->scene->options & Scene::DisableShaders)
 		 || (mesh->scene->visMode & Scene::VisSilhouette)
 		 || (mesh->nifVersion == 0) ) {
+		if ( shader_ready )
+			useProgram( 0 );
+
 		setupFixedFunction( mesh, props );
 		return {};
 	}
 
+	// The shape keeps the selected program until its blocks or properties change
+	if ( !hint.isEmpty() ) {
+		Program * program = programs.value( hint );
+		if ( program && program->status && setupProgram( program, mesh, props, {}, false ) )
+			return program->name;
+	}
+
 	QVector<QModelIndex> iBlocks;
 	iBlocks << mesh->index();
 	iBlocks << mesh->iData;
@@ -485,54 +510,113 @@ QString Renderer::setupProgram( Shape * mesh, const QString & hint )
 		iBlocks.append( p->index() );
 	}
 
-	if ( !hint.isEmpty() ) {
-		Program * program = programs.value( hint );
-		if ( program && program->status && setupProgram( program, mesh, props, iBlocks, false ) )
-			return program->name;
-	}
-
 	for ( Program * program : programs ) {
 		if ( program->status && setupProgram( program, mesh, props, iBlocks ) )
 			return program->name;
 	}
 
 	stopProgram();
+	if ( shader_ready )
+		useProgram( 0 );
+
 	setupFixedFunction( mesh, props );
 	return {};
 }
 
 void Renderer::stopProgram()
 {
-	if ( shader_ready ) {
-		fn->glUseProgram( 0 );
+	// Shapes of a batch which use the same program do not unbind it in between
+	if ( shader_ready && !batching ) {
+		useProgram( 0 );
 	}
 
 	resetTextureUnits();
 }
 
+void Renderer::useProgram( GLuint id )
+{
+	if ( id == currentProgram )
+		return;
+
+	fn->glUseProgram( id );
+	currentProgram = id;
+
+	if ( id )
+		stats.programSwitches++;
+}
+
+void Renderer::beginBatch()
+{
+	batching = true;
+}
+
+void Renderer::endBatch()
+{
+	batching = false;
+
+	if ( shader_ready )
+		useProgram( 0 );
+}
+
+bool Renderer::isSkinningProgram( const QString & name ) const
+{
+	if ( !shader_ready || name.isEmpty() )
+		return false;
+
+	Program * program = programs.value( name );
+	if ( !program || !program->status )
+		return false;
+
+	if ( program->uniformLocations[GPU_SKINNED] < 0 || program->uniformLocations[GPU_BONES] < 0 )
+		return false;
+
+	QList<Program::CoordType> coords = program->texcoords.values();
+	return coords.contains( Program::CT_BONE ) && coords.contains( Program::CT_WEIGHT );
+}
+
+bool Renderer::Program::uniformChanged( UniformType var, float x, float y, float z, float w )
+{
+	if ( uniformLocations[var] < 0 )
+		return false;
+
+	std::array<float, 4> value = { { x, y, z, w } };
+	if ( uniformKnown[var] && uniformValues[var] == value )
+		return false;
+
+	uniformValues[var] = value;
+	uniformKnown[var] = true;
+	return true;
+}
+
 void Renderer::Program::uni1f( UniformType var, float x )
 {
-	f->glUniform1f( uniformLocations[var], x );
+	if ( uniformChanged( var, x ) )
+		f->glUniform1f( uniformLocations[var], x );
 }
 
 void Renderer::Program::uni2f( UniformType var, float x, float y )
 {
-	f->glUniform2f( uniformLocations[var], x, y );
+	if ( uniformChanged( var, x, y ) )
+		f->glUniform2f( uniformLocations[var], x, y );
 }
 
 void Renderer::Program::uni3f( UniformType var, float x, float y, float z )
 {
-	f->glUniform3f( uniformLocations[var], x, y, z );
+	if ( uniformChanged( var, x, y, z ) )
+		f->glUniform3f( uniformLocations[var], x, y, z );
 }
 
 void Renderer::Program::uni4f( UniformType var, float x, float y, float z, float w )
 {
-	f->glUniform4f( uniformLocations[var], x, y, z, w );
+	if ( uniformChanged( var, x, y, z, w ) )
+		f->glUniform4f( uniformLocations[var], x, y, z, w );
 }
 
 void Renderer::Program::uni1i( UniformType var, int val )
 {
-	f->glUniform1i( uniformLocations[var], val );
+	// Flags and texture units, exact as floats
+	if ( uniformChanged( var, val ) )
+		f->glUniform1i( uniformLocations[var], val );
 }
 
 void Renderer::Program::uni3m( UniformType var, const Matrix & val )
@@ -563,7 +647,7 @@ bool Renderer::Program::uniSampler( BSShaderLightingProperty * bsprop, UniformTy
 										|| bsprop->bind( textureSlot, alternate, TexClampMode(3) ))) )
 			return uniSamplerBlank( var, texunit );
 
-		f->glUniform1i( uniSamp, texunit++ );
+		uni1i( var, texunit++ );
 
 		return true;
 	}
@@ -579,7 +663,7 @@ bool Renderer::Program::uniSamplerBlank( UniformType var, int & texunit )
 			return false;
 
 		glBindTexture( GL_TEXTURE_2D, 0 );
-		f->glUniform1i( uniSamp, texunit++ );
+		uni1i( var, texunit++ );
 
 		return true;
 	}
@@ -605,7 +689,7 @@ bool Renderer::setupProgram( Program * prog, Shape * mesh, const PropertyList &
 	if ( eval && !prog->conditions.eval( nif, iBlocks ) )
 		return false;
 
-	fn->glUseProgram( prog->id );
+	useProgram( prog->id );
 
 	auto opts = mesh->scene->options;
 	auto vis = mesh->scene->visMode;
@@ -645,7 +729,7 @@ bool Renderer::setupProgram( Program * prog, Shape * mesh, const PropertyList &
 			if ( !activateTextureUnit( texunit ) || (texprop && !texprop->bind( 0 )) )
 				prog->uniSamplerBlank( SAMP_BASE, texunit );
 			else
-				fn->glUniform1i( uniBaseMap, texunit++ );
+				prog->uni1i( SAMP_BASE, texunit++ );
 		}
 	}
 
@@ -675,7 +759,7 @@ bool Renderer::setupProgram( Program * prog, Shape * mesh, const PropertyList &
 			if ( !result )
 				prog->uniSamplerBlank( SAMP_NORMAL, texunit );
 			else
-				fn->glUniform1i( uniNormalMap, texunit++ );
+				prog->uni1i( SAMP_NORMAL, texunit++ );
 		}
 	}
 
@@ -702,7 +786,7 @@ bool Renderer::setupProgram( Program * prog, Shape * mesh, const PropertyList &
 			if ( !result )
 				prog->uniSamplerBlank( SAMP_GLOW, texunit );
 			else
-				fn->glUniform1i( uniGlowMap, texunit++ );
+				prog->uni1i( SAMP_GLOW, texunit++ );
 		}
 	}
 
@@ -826,7 +910,7 @@ bool Renderer::setupProgram( Program * prog, Shape * mesh, const PropertyList &
 				if ( !activateTextureUnit( texunit ) || !bsprop->bindCube( 4, cube ) )
 					return false;
 
-			fn->glUniform1i( uniCubeMap, texunit++ );
+			prog->uni1i( SAMP_CUBE, texunit++ );
 		}
 		// Always bind mask regardless of shader settings
 		prog->uniSampler( bsprop, SAMP_ENV_MASK, 5, texunit, white, clamp );
@@ -910,7 +994,7 @@ bool Renderer::setupProgram( Program * prog, Shape * mesh, const PropertyList &
 						return false;
 
 
-				fn->glUniform1i( uniCubeMap, texunit++ );
+				prog->uni1i( SAMP_CUBE, texunit++ );
 			}
 			prog->uniSampler( bsprop, SAMP_SPECULAR, 4, texunit, white, clamp );
 		}
@@ -932,26 +1016,18 @@ bool Renderer::setupProgram( Program * prog, Shape * mesh, const PropertyList &
 
 		auto it = itx.value();
 		if ( it == Program::CT_TANGENT ) {
-			if ( mesh->transTangents.count() ) {
-				glEnableClientState( GL_TEXTURE_COORD_ARRAY );
-				glTexCoordPointer( 3, GL_FLOAT, 0, mesh->transTangents.constData() );
-			} else if ( mesh->tangents.count() ) {
-				glEnableClientState( GL_TEXTURE_COORD_ARRAY );
-				glTexCoordPointer( 3, GL_FLOAT, 0, mesh->tangents.constData() );
-			} else {
+			if ( !mesh->bindTangents() )
 				return false;
-			}
 
 		} else if ( it == Program::CT_BITANGENT ) {
-			if ( mesh->transBitangents.count() ) {
-				glEnableClientState( GL_TEXTURE_COORD_ARRAY );
-				glTexCoordPointer( 3, GL_FLOAT, 0, mesh->transBitangents.constData() );
-			} else if ( mesh->bitangents.count() ) {
-				glEnableClientState( GL_TEXTURE_COORD_ARRAY );
-				glTexCoordPointer( 3, GL_FLOAT, 0, mesh->bitangents.constData() );
-			} else {
+			if ( !mesh->bindBitangents() )
+				return false;
+		} else if ( it == Program::CT_BONE || it == Program::CT_WEIGHT ) {
+			if ( !mesh->gpuSkinned )
+				continue;
+
+			if ( !((it == Program::CT_BONE) ? mesh->bindBoneIndices() : mesh->bindBoneWeights()) )
 				return false;
-			}
 		} else if ( texprop ) {
 			int txid = it;
 			if ( txid < 0 )
@@ -959,11 +1035,8 @@ bool Renderer::setupProgram( Program * prog, Shape * mesh, const PropertyList &
 
 			int set = texprop->coordSet( txid );
 
-			if ( set < 0 || !(set < mesh->coords.count()) || !mesh->coords[set].count() )
+			if ( !mesh->bindCoords( set ) )
 				return false;
-
-			glEnableClientState( GL_TEXTURE_COORD_ARRAY );
-			glTexCoordPointer( 2, GL_FLOAT, 0, mesh->coords[set].constData() );
 		} else if ( bsprop ) {
 			int txid = it;
 			if ( txid < 0 )
@@ -971,14 +1044,23 @@ bool Renderer::setupProgram( Program * prog, Shape * mesh, const PropertyList &
 
 			int set = 0;
 
-			if ( set < 0 || !(set < mesh->coords.count()) || !mesh->coords[set].count() )
+			if ( !mesh->bindCoords( set ) )
 				return false;
-
-			glEnableClientState( GL_TEXTURE_COORD_ARRAY );
-			glTexCoordPointer( 2, GL_FLOAT, 0, mesh->coords[set].constData() );
 		}
 	}
 
+	// Skinning palette, the vertices are still in bind pose
+	prog->uni1i( GPU_SKINNED, mesh->gpuSkinned );
+
+	if ( mesh->gpuSkinned ) {
+		GLint uniBones = prog->uniformLocations[GPU_BONES];
+		if ( uniBones < 0 )
+			return false;
+
+		const QVector<Matrix4> & bones = mesh->skin.boneMatrices();
+		fn->glUniformMatrix4fv( uniBones, bones.count(), 0, bones.constData()->data() );
+	}
+
 	// setup lighting
 
 	//glEnable( GL_LIGHTING );
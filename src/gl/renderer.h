@@ -86,6 +86,24 @@ public:
 	QString setupProgram( Shape *, const QString & hint = {} );
 	//! Stop shader program
 	void stopProgram();
+	//! Whether the named shader program can skin vertices with the bone palette
+	bool isSkinningProgram( const QString & name ) const;
+
+	//! Keeps the current program bound across stopProgram() calls until endBatch()
+	void beginBatch();
+	//! Ends a batch started by beginBatch() and unbinds the program
+	void endBatch();
+
+	//! glDrawRangeElements, resolved by initialize() as not every OpenGL library exports it
+	PFNGLDRAWRANGEELEMENTSPROC drawRangeElements = nullptr;
+
+	//! Render state counters, reset every frame by the scene
+	struct Stats
+	{
+		int drawItems = 0;
+		int programSwitches = 0;
+		int culledShapes = 0;
+	} stats;
 
 	typedef enum
 	{
@@ -190,7 +208,18 @@ protected:
 
 		bool invert;
 
-		QModelIndex getIndex( const NifModel * nif, const QVector<QModelIndex> & iBlock, QString name ) const;
+		//! Is the left operand a header field?
+		bool headerField = false;
+		//! Block type of the left operand
+		QString blockType;
+		//! Field path of the left operand, empty to test for the block
+		QString field;
+		//! Right operand as a count
+		uint rightCount = 0;
+		//! Right operand as a float
+		float rightFloat = 0;
+
+		QModelIndex getIndex( const NifModel * nif, const QVector<QModelIndex> & iBlock ) const;
 		template <typename T> bool compare( T a, T b ) const;
 	};
 
@@ -333,7 +362,14 @@ public:
 
 		int uniformLocations[NUM_UNIFORM_TYPES];
 
+		//! Values last set per uniform; program objects keep them between draws
+		std::array<float, 4> uniformValues[NUM_UNIFORM_TYPES];
+		//! Whether uniformValues holds the value of the uniform
+		bool uniformKnown[NUM_UNIFORM_TYPES] = {};
+
 		void setUniformLocations();
+		//! Records a value for a uniform; returns false if the program has no such uniform or already has the value
+		bool uniformChanged( UniformType var, float x, float y = 0, float z = 0, float w = 0 );
 
 		void uni1f( UniformType var, float x );
 		void uni2f( UniformType var, float x, float y );
@@ -350,6 +386,14 @@ public:
 	QMap<QString, Shader *> shaders;
 	QMap<QString, Program *> programs;
 
+	//! Binds a program unless it is bound already
+	void useProgram( GLuint id );
+
+	//! Program object currently bound
+	GLuint currentProgram = 0;
+	//! Is a batch of shapes being drawn?
+	bool batching = false;
+
 	bool setupProgram( Program *, Shape *, const PropertyList &, const QVector<QModelIndex> & iBlocks, bool eval = true );
 	void setupFixedFunction( Shape *, const PropertyList & );
 
@@ -49,6 +49,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <QDebug>
 #include <QDialog>
 #include <QDir>
+#include <QFileDialog>
 #include <QGroupBox>
 #include <QImageWriter>
 #include <QLabel>
@@ -58,10 +59,12 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <QMouseEvent>
 #include <QPushButton>
 #include <QRadioButton>
+#include <QScreen>
 #include <QSettings>
 #include <QSpinBox>
 #include <QTimer>
 #include <QToolBar>
+#include <QWindow>
 
 #include <QOpenGLContext>
 #include <QOpenGLFunctions>
@@ -83,11 +86,15 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 //	Also the QTimer is integer milliseconds 
 //	so 60 will give you 1000/60 = 16, not 16.666
 //	therefore it's really 62.5FPS
+//	The timer only runs while something moves, see GLView::scheduleGears()
 #define FPS 144
 
 #define ZOOM_MIN 1.0
 #define ZOOM_MAX 1000.0
 
+// Pixels around the cursor in which shapes are drawn for picking; covers the vertex points
+#define PICK_RADIUS 8
+
 #ifndef M_PI
 #define M_PI 3.1415926535897932385
 #endif
@@ -195,6 +202,7 @@ GLView::GLView( const QGLFormat & format, QWidget * p, const QGLWidget * shareWi
 	lastTime = QTime::currentTime();
 
 	textures = new TexCache( this );
+	textures->streaming = true;
 
 	updateSettings();
 
@@ -203,8 +211,8 @@ GLView::GLView( const QGLFormat & format, QWidget * p, const QGLWidget * shareWi
 	connect( scene, &Scene::sceneUpdated, this, static_cast<void (GLView::*)()>(&GLView::update) );
 
 	timer = new QTimer( this );
+	timer->setTimerType( Qt::PreciseTimer );
 	timer->setInterval( 1000 / FPS );
-	timer->start();
 	connect( timer, &QTimer::timeout, this, &GLView::advanceGears );
 
 	lightVisTimeout = 1500;
@@ -222,10 +230,13 @@ GLView::GLView( const QGLFormat & format, QWidget * p, const QGLWidget * shareWi
 
 GLView::~GLView()
 {
+	// The scene and textures delete their GL objects
+	makeCurrent();
+
 	flush();
 
-	delete textures;
 	delete scene;
+	delete textures;
 }
 
 void GLView::updateSettings()
@@ -259,6 +270,7 @@ Scene * GLView::getScene()
 
 void GLView::updateScene()
 {
+	makeCurrent();
 	scene->update( model, QModelIndex() );
 	update();
 }
@@ -326,7 +338,11 @@ void GLView::updateShaders()
 
 void GLView::glProjection( int x, int y )
 {
-	Q_UNUSED( x ); Q_UNUSED( y );
+	// Picking only draws the shapes near the cursor
+	if ( x >= 0 && y >= 0 )
+		scene->pickWindow = QRect( x - PICK_RADIUS, height() - 1 - y - PICK_RADIUS, 2 * PICK_RADIUS + 1, 2 * PICK_RADIUS + 1 );
+	else
+		scene->pickWindow = QRect();
 
 	glMatrixMode( GL_PROJECTION );
 	glLoadIdentity();
@@ -391,6 +407,8 @@ void GLView::paintGL()
 #endif
 	
 
+	scene->profiler.beginFrame();
+
 	// Save GL state
 	glPushAttrib( GL_ALL_ATTRIB_BITS );
 	glMatrixMode( GL_PROJECTION );
@@ -674,6 +692,21 @@ void GLView::paintGL()
 	glMatrixMode( GL_PROJECTION );
 	glPopMatrix();
 
+	scene->profiler.endFrame();
+
+	// Profiling overlay
+	if ( scene->profiler.isEnabled() ) {
+		QFont font;
+		int lineHeight = QFontMetrics( font ).height();
+		int y = lineHeight;
+
+		qglColor( Qt::white );
+		for ( const QString & line : scene->profiler.textSummary().split( "\n" ) ) {
+			renderText( 8, y, line, font );
+			y += lineHeight;
+		}
+	}
+
 	// Check for errors
 	GLenum err;
 	while ( ( err = glGetError() ) != GL_NO_ERROR )
@@ -684,6 +717,9 @@ void GLView::paintGL()
 	// Manually handle the buffer swap
 	swapBuffers();
 
+	// The model may have gained animations, or the view may have been shown again
+	scheduleGears();
+
 #ifdef USE_GL_QPAINTER
 	painter.end();
 #endif
@@ -752,6 +788,12 @@ void GLView::setDebugMode( DebugMode mode )
 	debugMode = mode;
 }
 
+void GLView::setProfiling( bool enable )
+{
+	scene->profiler.setEnabled( enable );
+	update();
+}
+
 void GLView::setVisMode( Scene::VisMode mode, bool checked )
 {
 	if ( checked )
@@ -865,6 +907,39 @@ QModelIndex GLView::indexAt( const QPoint & pos, int cycle )
 	glViewport( 0, 0, width(), height() );
 	glProjection( pos.x(), pos.y() );
 
+	// Shapes alone are picked by casting a ray through the pixel
+	//	The color keys are still rendered for the overlays and for debugging
+	bool overlays = scene->options & (Scene::ShowCollision | Scene::ShowNodes | Scene::ShowMarkers);
+	if ( !overlays && debugMode != DbgColorPicker ) {
+		GLdouble proj[16];
+		glGetDoublev( GL_PROJECTION_MATRIX, proj );
+
+		const GLdouble eye[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+		const GLint viewport[4] = { 0, 0, width(), height() };
+		GLdouble winX = pos.x() + 0.5;
+		GLdouble winY = height() - pos.y() - 0.5;
+
+		GLdouble nx, ny, nz, fx, fy, fz;
+		gluUnProject( winX, winY, 0.0, eye, proj, viewport, &nx, &ny, &nz );
+		gluUnProject( winX, winY, 1.0, eye, proj, viewport, &fx, &fy, &fz );
+
+		Scene::Hit hit = scene->pick( Vector3( nx, ny, nz ), Vector3( fx - nx, fy - ny, fz - nz ) );
+
+		glPopAttrib();
+		glMatrixMode( GL_MODELVIEW );
+		glPopMatrix();
+		glMatrixMode( GL_PROJECTION );
+		glPopMatrix();
+
+		if ( !hit.shape )
+			return QModelIndex();
+
+		if ( scene->selMode & Scene::SelVertex )
+			return hit.shape->vertexAt( hit.vertex );
+
+		return model->getBlock( hit.shape->id() );
+	}
+
 	QList<DrawFunc> df;
 
 	if ( scene->options & Scene::ShowCollision )
@@ -1174,6 +1249,8 @@ void GLView::dataChanged( const QModelIndex & idx, const QModelIndex & xdi )
 	}
 
 	if ( ix.isValid() ) {
+		// Updated blocks release their buffer objects
+		makeCurrent();
 		scene->update( model, idx );
 		update();
 	} else {
@@ -1269,8 +1346,11 @@ void GLView::advanceGears()
 
 	lastTime = t;
 
-	if ( !isVisible() )
+	if ( !isVisible() ) {
+		// Painting starts it again once visible
+		timer->stop();
 		return;
+	}
 
 	if ( ( animState & AnimEnabled ) && ( animState & AnimPlay )
 		&& scene->timeMin() != scene->timeMax() )
@@ -1337,9 +1417,53 @@ void GLView::advanceGears()
 		rotate( mouseRot[0], mouseRot[1], mouseRot[2] );
 		mouseRot = Vector3();
 	}
+
+	scheduleGears();
+}
+
+void GLView::scheduleGears()
+{
+	bool playing = ( animState & AnimEnabled ) && ( animState & AnimPlay )
+		&& scene->timeMin() != scene->timeMax();
+
+	bool moving = mouseMov[0] != 0 || mouseMov[1] != 0 || mouseMov[2] != 0
+		|| mouseRot[0] != 0 || mouseRot[1] != 0 || mouseRot[2] != 0;
+	for ( auto it = kbd.constBegin(); it != kbd.constEnd() && !moving; ++it ) {
+		// Space only changes what the mouse does
+		moving = it.value() && it.key() != Qt::Key_Space;
+	}
+
+	if ( !isVisible() || !(playing || moving) ) {
+		timer->stop();
+		return;
+	}
+
+	if ( timer->isActive() )
+		return;
+
+	// Tick once per display refresh, at most FPS times a second;
+	//	with V-Sync the buffer swap paces the frames to the display
+	QScreen * screen = window()->windowHandle() ? window()->windowHandle()->screen() : QGuiApplication::primaryScreen();
+	qreal rate = screen ? screen->refreshRate() : FPS;
+	timer->setInterval( qMax( 1000 / FPS, qRound( 1000 / qBound( 1.0, rate, qreal( FPS ) ) ) ) );
+
+	// Do not count the idle time as animation time
+	lastTime = QTime::currentTime();
+	timer->start();
 }
 
 
+void GLView::saveProfile()
+{
+	QString fname = QFileDialog::getSaveFileName( qApp->activeWindow(), tr( "Save Render Profile" ),
+	                                              "profile.json", "Chrome Trace (*.json)" );
+	if ( fname.isEmpty() )
+		return;
+
+	if ( !scene->profiler.exportTrace( fname ) )
+		Message::critical( this, tr( "Could not save %1" ).arg( fname ) );
+}
+
 // TODO: Separate widget
 void GLView::saveImage()
 {
@@ -1657,6 +1781,7 @@ void GLView::keyPressEvent( QKeyEvent * event )
 	case Qt::Key_E:
 	case Qt::Key_Space:
 		kbd[event->key()] = true;
+		scheduleGears();
 		break;
 	case Qt::Key_Escape:
 		doCompile = true;
@@ -1723,6 +1848,8 @@ void GLView::mouseMoveEvent( QMouseEvent * event )
 	}
 
 	lastPos = event->pos();
+
+	scheduleGears();
 }
 
 void GLView::mousePressEvent( QMouseEvent * event )
@@ -1795,10 +1922,12 @@ void GLView::mouseReleaseEvent( QMouseEvent * event )
 
 void GLView::wheelEvent( QWheelEvent * event )
 {
-	if ( view == ViewWalk )
+	if ( view == ViewWalk ) {
 		mouseMov += Vector3( 0, 0, event->delta() );
-	else
+		scheduleGears();
+	} else {
 		setDistance( Dist * (event->delta() < 0 ? 1.0 / 0.8 : 0.8) );
+	}
 }
 
 
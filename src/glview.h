@@ -144,6 +144,8 @@ public:
 	void flipOrientation();
 
 	void setDebugMode( DebugMode );
+	//! Records the time of the frame stages and shows it over the view
+	void setProfiling( bool );
 
 	QColor clearColor() const;
 
@@ -213,6 +215,7 @@ protected:
 
 protected slots:
 	void saveImage();
+	void saveProfile();
 
 private:
 	NifModel * model;
@@ -266,6 +269,8 @@ private:
 
 private slots:
 	void advanceGears();
+	//! Runs the advanceGears() timer while an animation plays or the camera moves, stops it otherwise
+	void scheduleGears();
 
 	void dataChanged( const QModelIndex &, const QModelIndex & );
 	void modelChanged();
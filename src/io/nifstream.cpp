@@ -37,222 +37,250 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "lib/half.h"
 
-#include <QDataStream>
 #include <QIODevice>
+#include <QtEndian>
 
+#include <cstring>
 
-//! @file nifstream.cpp NIF file I/O
-
-/*
-*  NifIStream
-*/
-
-void NifIStream::init()
-{
-	bool32bit = (model->inherits( "NifModel" ) && model->getVersionNumber() <= 0x04000002);
-	linkAdjust = (model->inherits( "NifModel" ) && model->getVersionNumber() <  0x0303000D);
-	stringAdjust = (model->inherits( "NifModel" ) && model->getVersionNumber() >= 0x14010003);
-	bigEndian = false; // set when tFileVersion is read
-
-	dataStream = std::unique_ptr<QDataStream>( new QDataStream( device ) );
-	dataStream->setByteOrder( QDataStream::LittleEndian );
-	dataStream->setFloatingPointPrecision( QDataStream::SinglePrecision );
 
-	maxLength = 0x8000;
-}
+//! @file nifstream.cpp NIF file I/O
 
-bool NifIStream::read( NifValue & val )
+//! Size on disk of a value accepted by NifIStream::readFixed() and NifOStream::writeFixed()
+static int fixedSize( const NifValue & val, bool bool32bit )
 {
 	switch ( val.type() ) {
 	case NifValue::tBool:
-		{
-			val.val.u32 = 0;
-
-			if ( bool32bit )
-				*dataStream >> val.val.u32;
-			else
-				*dataStream >> val.val.u08;
-
-			return (dataStream->status() == QDataStream::Ok);
-		}
+		return (bool32bit) ? 4 : 1;
 	case NifValue::tByte:
-		{
-			val.val.u32 = 0;
-			*dataStream >> val.val.u08;
-			return (dataStream->status() == QDataStream::Ok);
-		}
+		return 1;
 	case NifValue::tWord:
 	case NifValue::tShort:
 	case NifValue::tFlags:
 	case NifValue::tBlockTypeIndex:
-		{
-			val.val.u32 = 0;
-			*dataStream >> val.val.u16;
-			return (dataStream->status() == QDataStream::Ok);
-		}
+	case NifValue::tHfloat:
+		return 2;
+	case NifValue::tByteVector3:
+		return 3;
 	case NifValue::tStringOffset:
 	case NifValue::tInt:
 	case NifValue::tUInt:
-		{
-			*dataStream >> val.val.u32;
-			return (dataStream->status() == QDataStream::Ok);
-		}
 	case NifValue::tULittle32:
-		{
-			if ( bigEndian )
-				dataStream->setByteOrder( QDataStream::LittleEndian );
+	case NifValue::tStringIndex:
+	case NifValue::tLink:
+	case NifValue::tUpLink:
+	case NifValue::tFloat:
+	case NifValue::tHalfVector2:
+	case NifValue::tByteColor4:
+		return 4;
+	case NifValue::tHalfVector3:
+	case NifValue::tTriangle:
+		return 6;
+	case NifValue::tVector2:
+	case NifValue::tBSVertexDesc:
+		return 8;
+	case NifValue::tVector3:
+	case NifValue::tColor3:
+		return 12;
+	case NifValue::tVector4:
+	case NifValue::tQuat:
+	case NifValue::tQuatXYZW:
+	case NifValue::tColor4:
+		return 16;
+	case NifValue::tMatrix:
+		return 36;
+	case NifValue::tMatrix4:
+		return 64;
+	default:
+		return 0;
+	}
+}
 
-			*dataStream >> val.val.u32;
+//! Loads a value stored in the given byte order
+template <typename T, bool BigEndian> static inline T loadValue( const char * data )
+{
+	return (BigEndian) ? qFromBigEndian<T>( data ) : qFromLittleEndian<T>( data );
+}
 
-			if ( bigEndian )
-				dataStream->setByteOrder( QDataStream::BigEndian );
+//! Loads a float stored in the given byte order
+template <bool BigEndian> static inline float loadFloat( const char * data )
+{
+	union { float f; quint32 i; } u;
+	u.i = loadValue<quint32, BigEndian>( data );
+	return u.f;
+}
 
-			return (dataStream->status() == QDataStream::Ok);
-		}
+//! Width of the components of a fixed-size value that are stored in file byte order, 0 if none are
+static int swapWidth( const NifValue & val, bool bool32bit )
+{
+	switch ( val.type() ) {
+	case NifValue::tBool:
+		return (bool32bit) ? 4 : 0;
+	case NifValue::tWord:
+	case NifValue::tShort:
+	case NifValue::tFlags:
+	case NifValue::tBlockTypeIndex:
+	case NifValue::tHfloat:
+	case NifValue::tHalfVector3:
+	case NifValue::tHalfVector2:
+	case NifValue::tTriangle:
+		return 2;
+	case NifValue::tStringOffset:
+	case NifValue::tInt:
+	case NifValue::tUInt:
 	case NifValue::tStringIndex:
-		{
-			*dataStream >> val.val.u32;
-			return (dataStream->status() == QDataStream::Ok);
-		}
 	case NifValue::tLink:
 	case NifValue::tUpLink:
-		{
-			*dataStream >> val.val.i32;
-
-			if ( linkAdjust )
-				val.val.i32--;
-
-			return (dataStream->status() == QDataStream::Ok);
-		}
 	case NifValue::tFloat:
-		{
-			*dataStream >> val.val.f32;
-			return (dataStream->status() == QDataStream::Ok);
-		}
-	case NifValue::tHfloat:
-		{
-			uint16_t half;
-			*dataStream >> half;
-			val.val.u32 = half_to_float( half );
-			return (dataStream->status() == QDataStream::Ok);
-		}
-	case NifValue::tByteVector3:
-		{
-			quint8 x, y, z;
-			float xf, yf, zf;
-
-			*dataStream >> x;
-			*dataStream >> y;
-			*dataStream >> z;
+	case NifValue::tVector2:
+	case NifValue::tVector3:
+	case NifValue::tVector4:
+	case NifValue::tQuat:
+	case NifValue::tColor4:
+		return 4;
+	case NifValue::tBSVertexDesc:
+		return 8;
+	default:
+		return 0;
+	}
+}
 
-			xf = (double( x ) / 255.0) * 2.0 - 1.0;
-			yf = (double( y ) / 255.0) * 2.0 - 1.0;
-			zf = (double( z ) / 255.0) * 2.0 - 1.0;
+//! Number of half floats in a fixed-size value
+static int halfCount( const NifValue & val )
+{
+	switch ( val.type() ) {
+	case NifValue::tHfloat:
+		return 1;
+	case NifValue::tHalfVector2:
+		return 2;
+	case NifValue::tHalfVector3:
+		return 3;
+	default:
+		return 0;
+	}
+}
 
-			Vector3 * v = static_cast<Vector3 *>(val.val.data);
-			v->xyz[0] = xf; v->xyz[1] = yf; v->xyz[2] = zf;
+//! Single precision source of the half floats in a fixed-size value, null if there is none
+static const float * halfSource( const NifValue & val )
+{
+	switch ( val.type() ) {
+	case NifValue::tHfloat:
+		return &val.val.f32;
+	case NifValue::tHalfVector3:
+		return (val.val.data) ? static_cast<Vector3 *>(val.val.data)->xyz : nullptr;
+	case NifValue::tHalfVector2:
+		return (val.val.data) ? static_cast<Vector2 *>(val.val.data)->xy : nullptr;
+	default:
+		return nullptr;
+	}
+}
 
-			return (dataStream->status() == QDataStream::Ok);
+//! Lookup tables for byte components, with the same results as the per-component conversions
+struct ByteTables
+{
+	float snorm[256];
+	float unorm[256];
+
+	ByteTables()
+	{
+		for ( int i = 0; i < 256; i++ ) {
+			snorm[i] = (double( i ) / 255.0) * 2.0 - 1.0;
+			unorm[i] = (float)i / 255.0;
 		}
-	case NifValue::tHalfVector3:
-		{
-			uint16_t x, y, z;
-			union { float f; uint32_t i; } xu, yu, zu;
+	}
+};
 
-			*dataStream >> x;
-			*dataStream >> y;
-			*dataStream >> z;
+static const ByteTables byteTables;
 
-			xu.i = half_to_float( x );
-			yu.i = half_to_float( y );
-			zu.i = half_to_float( z );
+//! Swaps the byte order of a buffer of values of the given width in place
+static void swapBuffer( char * data, int len, int width )
+{
+	switch ( width ) {
+	case 2:
+		for ( int i = 0; i + 2 <= len; i += 2 )
+			qToLittleEndian<quint16>( qFromBigEndian<quint16>( data + i ), data + i );
+		break;
+	case 4:
+		for ( int i = 0; i + 4 <= len; i += 4 )
+			qToLittleEndian<quint32>( qFromBigEndian<quint32>( data + i ), data + i );
+		break;
+	case 8:
+		for ( int i = 0; i + 8 <= len; i += 8 )
+			qToLittleEndian<quint64>( qFromBigEndian<quint64>( data + i ), data + i );
+		break;
+	default:
+		break;
+	}
+}
 
-			Vector3 * v = static_cast<Vector3 *>(val.val.data);
-			v->xyz[0] = xu.f; v->xyz[1] = yu.f; v->xyz[2] = zu.f;
 
-			return (dataStream->status() == QDataStream::Ok);
-		}
-	case NifValue::tHalfVector2:
-		{
-			uint16_t x, y;
-			union { float f; uint32_t i; } xu, yu;
+/*
+*  NifIStream
+*/
 
-			*dataStream >> x;
-			*dataStream >> y;
+void NifIStream::init()
+{
+	bool32bit = (model->inherits( "NifModel" ) && model->getVersionNumber() <= 0x04000002);
+	linkAdjust = (model->inherits( "NifModel" ) && model->getVersionNumber() <  0x0303000D);
+	stringAdjust = (model->inherits( "NifModel" ) && model->getVersionNumber() >= 0x14010003);
+	bigEndian = false; // set when tFileVersion is read
 
-			xu.i = half_to_float( x );
-			yu.i = half_to_float( y );
+	maxLength = 0x8000;
 
-			Vector2 * v = static_cast<Vector2 *>(val.val.data);
-			v->xy[0] = xu.f; v->xy[1] = yu.f;
+	selectDecoder();
+}
 
-			return (dataStream->status() == QDataStream::Ok);
-		}
-	case NifValue::tVector3:
-		{
-			Vector3 * v = static_cast<Vector3 *>(val.val.data);
-			*dataStream >> *v;
-			return (dataStream->status() == QDataStream::Ok);
-		}
-	case NifValue::tVector4:
-		{
-			Vector4 * v = static_cast<Vector4 *>(val.val.data);
-			*dataStream >> *v;
-			return (dataStream->status() == QDataStream::Ok);
-		}
-	case NifValue::tTriangle:
-		{
-			Triangle * t = static_cast<Triangle *>(val.val.data);
-			*dataStream >> *t;
-			return (dataStream->status() == QDataStream::Ok);
-		}
-	case NifValue::tQuat:
-		{
-			Quat * q = static_cast<Quat *>(val.val.data);
-			*dataStream >> *q;
-			return (dataStream->status() == QDataStream::Ok);
-		}
-	case NifValue::tQuatXYZW:
-		{
-			Quat * q = static_cast<Quat *>(val.val.data);
-			return device->read( (char *)&q->wxyz[1], 12 ) == 12 && device->read( (char *)q->wxyz, 4 ) == 4;
-		}
-	case NifValue::tMatrix:
-		return device->read( (char *)static_cast<Matrix *>(val.val.data)->m, 36 ) == 36;
-	case NifValue::tMatrix4:
-		return device->read( (char *)static_cast<Matrix4 *>(val.val.data)->m, 64 ) == 64;
-	case NifValue::tVector2:
-		{
-			Vector2 * v = static_cast<Vector2 *>(val.val.data);
-			*dataStream >> *v;
-			return (dataStream->status() == QDataStream::Ok);
-		}
-	case NifValue::tColor3:
-		return device->read( (char *)static_cast<Color3 *>(val.val.data)->rgb, 12 ) == 12;
-	case NifValue::tByteColor4:
-		{
-			quint8 r, g, b, a;
-			*dataStream >> r;
-			*dataStream >> g;
-			*dataStream >> b;
-			*dataStream >> a;
+void NifIStream::selectDecoder()
+{
+	static const Decoder decoders[8] = {
+		&NifIStream::decode<false, false, false>,
+		&NifIStream::decode<false, false, true>,
+		&NifIStream::decode<false, true, false>,
+		&NifIStream::decode<false, true, true>,
+		&NifIStream::decode<true, false, false>,
+		&NifIStream::decode<true, false, true>,
+		&NifIStream::decode<true, true, false>,
+		&NifIStream::decode<true, true, true>
+	};
+
+	static const RunDecoder runDecoders[8] = {
+		&NifIStream::decodeRun<false, false, false>,
+		&NifIStream::decodeRun<false, false, true>,
+		&NifIStream::decodeRun<false, true, false>,
+		&NifIStream::decodeRun<false, true, true>,
+		&NifIStream::decodeRun<true, false, false>,
+		&NifIStream::decodeRun<true, false, true>,
+		&NifIStream::decodeRun<true, true, false>,
+		&NifIStream::decodeRun<true, true, true>
+	};
+
+	int config = (bool32bit ? 2 : 0) | (linkAdjust ? 1 : 0);
+
+	decoder = decoders[(bigEndian ? 4 : 0) | config];
+	runDecoder = runDecoders[(bigEndian ? 4 : 0) | config];
+	// Used for big-endian runs which have been swapped in bulk
+	swappedRunDecoder = runDecoders[config];
+}
 
-			Color4 * c = static_cast<Color4 *>(val.val.data);
-			c->setRGBA( (float)r / 255.0, (float)g / 255.0, (float)b / 255.0, (float)a / 255.0 );
+bool NifIStream::read( NifValue & val )
+{
+	if ( val.isFixedSize() ) {
+		char buf[64];
+		int len = fixedSize( val, bool32bit );
+		if ( device->read( buf, len ) != len )
+			return false;
 
-			return (dataStream->status() == QDataStream::Ok);
-		}
-	case NifValue::tColor4:
-		{
-			Color4 * c = static_cast<Color4 *>(val.val.data);
-			*dataStream >> *c;
-			return (dataStream->status() == QDataStream::Ok);
-		}
+		(this->*decoder)( val, buf );
+		return true;
+	}
+
+	switch ( val.type() ) {
 	case NifValue::tSizedString:
 		{
-			int len;
-			//device->read( (char *) &len, 4 );
-			*dataStream >> len;
+			char buf[4];
+			if ( device->read( buf, 4 ) != 4 )
+				return false;
+
+			int len = qint32( bigEndian ? qFromBigEndian<quint32>( buf ) : qFromLittleEndian<quint32>( buf ) );
 
 			if ( len > maxLength || len < 0 ) {
 				*static_cast<QString *>(val.val.data) = tr( "<string too long (0x%1)>" ).arg( len, 0, 16 ); return false;
@@ -396,9 +424,7 @@ bool NifIStream::read( NifValue & val )
 				device->peek( (char *)&littleEndian, 1 );
 				bigEndian = !littleEndian;
 
-				if ( bigEndian ) {
-					dataStream->setByteOrder( QDataStream::BigEndian );
-				}
+				selectDecoder();
 			}
 
 			// hack for neosteam
@@ -458,11 +484,6 @@ bool NifIStream::read( NifValue & val )
 				return true;
 			}
 		}
-	case NifValue::tBSVertexDesc:
-		{
-			*dataStream >> *static_cast<BSVertexDesc *>(val.val.data);
-			return (dataStream->status() == QDataStream::Ok);
-		}
 	case NifValue::tBlob:
 		{
 			if ( val.val.data ) {
@@ -474,168 +495,311 @@ bool NifIStream::read( NifValue & val )
 		}
 	case NifValue::tNone:
 		return true;
+	default:
+		break;
 	}
 
 	return false;
 }
 
+bool NifIStream::readFixed( const QVector<NifValue *> & values )
+{
+	if ( values.isEmpty() )
+		return true;
+
+	qint64 len = 0;
+	int halfTotal = 0;
+	bool uniform = true;
+	NifValue::Type type = values.first()->type();
+	for ( const NifValue * v : values ) {
+		int size = fixedSize( *v, bool32bit );
+		if ( size == 0 )
+			return false;
 
-/*
-*  NifOStream
-*/
+		len += size;
+		halfTotal += halfCount( *v );
+		uniform = uniform && (v->type() == type);
+	}
 
-void NifOStream::init()
+	QByteArray buffer = device->read( len );
+	if ( buffer.size() != len )
+		return false;
+
+	// Swap big-endian arrays of a single type in bulk
+	int width = (bigEndian && uniform) ? swapWidth( *values.first(), bool32bit ) : 0;
+	if ( width > 0 )
+		swapBuffer( buffer.data(), buffer.size(), width );
+
+	bool swapped = (width > 0) || !bigEndian;
+
+	// Convert the half floats of the run at once, e.g. the vertex data of BSTriShape
+	QVector<quint32> halves;
+	if ( halfTotal > 0 ) {
+		QVector<quint16> halfData( halfTotal );
+		quint16 * dst = halfData.data();
+		const char * data = buffer.constData();
+		for ( const NifValue * v : values ) {
+			for ( int i = 0; i < halfCount( *v ); i++ )
+				*dst++ = (swapped) ? qFromLittleEndian<quint16>( data + i * 2 ) : qFromBigEndian<quint16>( data + i * 2 );
+
+			data += fixedSize( *v, bool32bit );
+		}
+
+		halves.resize( halfTotal );
+		half_to_float_array( halfData.constData(), halves.data(), halfTotal );
+	}
+
+	const quint32 * h = (halves.isEmpty()) ? nullptr : halves.constData();
+	if ( width > 0 )
+		(this->*swappedRunDecoder)( values, buffer.constData(), h );
+	else
+		(this->*runDecoder)( values, buffer.constData(), h );
+
+	return true;
+}
+
+template <bool BigEndian, bool Bool32bit, bool LinkAdjust>
+void NifIStream::decodeRun( const QVector<NifValue *> & values, const char * data, const quint32 * halves ) const
 {
-	bool32bit = (model->inherits( "NifModel" ) && model->getVersionNumber() <= 0x04000002);
-	linkAdjust = (model->inherits( "NifModel" ) && model->getVersionNumber() <  0x0303000D);
-	stringAdjust = (model->inherits( "NifModel" ) && model->getVersionNumber() >= 0x14010003);
+	if ( !halves ) {
+		for ( NifValue * v : values )
+			data = decode<BigEndian, Bool32bit, LinkAdjust>( *v, data );
+
+		return;
+	}
+
+	union { float f; quint32 i; } u;
+	for ( NifValue * v : values ) {
+		switch ( v->type() ) {
+		case NifValue::tHfloat:
+			v->val.u32 = *halves++;
+			data += 2;
+			break;
+		case NifValue::tHalfVector3:
+			{
+				Vector3 * vec = static_cast<Vector3 *>(v->val.data);
+				for ( int i = 0; i < 3; i++ ) {
+					u.i = *halves++;
+					vec->xyz[i] = u.f;
+				}
+				data += 6;
+			}
+			break;
+		case NifValue::tHalfVector2:
+			{
+				Vector2 * vec = static_cast<Vector2 *>(v->val.data);
+				for ( int i = 0; i < 2; i++ ) {
+					u.i = *halves++;
+					vec->xy[i] = u.f;
+				}
+				data += 4;
+			}
+			break;
+		default:
+			data = decode<BigEndian, Bool32bit, LinkAdjust>( *v, data );
+			break;
+		}
+	}
 }
 
-bool NifOStream::write( const NifValue & val )
+template <bool BigEndian, bool Bool32bit, bool LinkAdjust>
+const char * NifIStream::decode( NifValue & val, const char * data ) const
 {
 	switch ( val.type() ) {
 	case NifValue::tBool:
+		if ( Bool32bit ) {
+			val.val.u32 = loadValue<quint32, BigEndian>( data );
+			return data + 4;
+		}
 
-		if ( bool32bit )
-			return device->write( (char *)&val.val.u32, 4 ) == 4;
-		else
-			return device->write( (char *)&val.val.u08, 1 ) == 1;
-
+		val.val.u32 = quint8( *data );
+		return data + 1;
 	case NifValue::tByte:
-		return device->write( (char *)&val.val.u08, 1 ) == 1;
+		val.val.u32 = quint8( *data );
+		return data + 1;
 	case NifValue::tWord:
 	case NifValue::tShort:
 	case NifValue::tFlags:
 	case NifValue::tBlockTypeIndex:
-		return device->write( (char *)&val.val.u16, 2 ) == 2;
+		val.val.u32 = loadValue<quint16, BigEndian>( data );
+		return data + 2;
 	case NifValue::tStringOffset:
 	case NifValue::tInt:
 	case NifValue::tUInt:
-	case NifValue::tULittle32:
 	case NifValue::tStringIndex:
-		return device->write( (char *)&val.val.u32, 4 ) == 4;
-	case NifValue::tFileVersion:
-		{
-			if ( NifModel * mdl = static_cast<NifModel *>(const_cast<BaseModel *>(model)) ) {
-				QString headerString = mdl->getItem( mdl->getHeaderItem(), "Header String" )->value().toString();
-				quint32 version;
-
-				// hack for neosteam
-				if ( headerString.startsWith( "NS" ) ) {
-					version = 0x08F35232;
-				} else {
-					version = val.val.u32;
-				}
-
-				return device->write( (char *)&version, 4 ) == 4;
-			} else {
-				return device->write( (char *)&val.val.u32, 4 ) == 4;
-			}
-		}
+	case NifValue::tFloat:
+		val.val.u32 = loadValue<quint32, BigEndian>( data );
+		return data + 4;
+	case NifValue::tULittle32:
+		val.val.u32 = qFromLittleEndian<quint32>( data );
+		return data + 4;
 	case NifValue::tLink:
 	case NifValue::tUpLink:
-
-		if ( !linkAdjust ) {
-			return device->write( (char *)&val.val.i32, 4 ) == 4;
-		} else {
-			qint32 l = val.val.i32 + 1;
-			return device->write( (char *)&l, 4 ) == 4;
-		}
-
-	case NifValue::tFloat:
-		return device->write( (char *)&val.val.f32, 4 ) == 4;
+		val.val.i32 = qint32( loadValue<quint32, BigEndian>( data ) );
+		if ( LinkAdjust )
+			val.val.i32--;
+		return data + 4;
 	case NifValue::tHfloat:
-		{
-			uint16_t half = half_from_float( val.val.u32 );
-			return device->write( (char *)&half, 2 ) == 2;
-		}
+		val.val.u32 = half_to_float( loadValue<quint16, BigEndian>( data ) );
+		return data + 2;
 	case NifValue::tByteVector3:
 		{
-			Vector3 * vec = static_cast<Vector3 *>(val.val.data);
-			if ( !vec )
-				return false;
-
-			uint8_t v[3];
-			v[0] = round( ((vec->xyz[0] + 1.0) / 2.0) * 255.0 );
-			v[1] = round( ((vec->xyz[1] + 1.0) / 2.0) * 255.0 );
-			v[2] = round( ((vec->xyz[2] + 1.0) / 2.0) * 255.0 );
-
-			return device->write( (char*)v, 3 ) == 3;
+			Vector3 * v = static_cast<Vector3 *>(val.val.data);
+			for ( int i = 0; i < 3; i++ )
+				v->xyz[i] = byteTables.snorm[quint8( data[i] )];
+			return data + 3;
 		}
 	case NifValue::tHalfVector3:
 		{
-			Vector3 * vec = static_cast<Vector3 *>(val.val.data);
-			if ( !vec )
-				return false;
-
-			union { float f; uint32_t i; } xu, yu, zu;
-
-			xu.f = vec->xyz[0];
-			yu.f = vec->xyz[1];
-			zu.f = vec->xyz[2];
-
-			uint16_t v[3];
-			v[0] = half_from_float( xu.i );
-			v[1] = half_from_float( yu.i );
-			v[2] = half_from_float( zu.i );
-
-			return device->write( (char*)v, 6 ) == 6;
+			union { float f; uint32_t i; } u;
+			Vector3 * v = static_cast<Vector3 *>(val.val.data);
+			for ( int i = 0; i < 3; i++ ) {
+				u.i = half_to_float( loadValue<quint16, BigEndian>( data + i * 2 ) );
+				v->xyz[i] = u.f;
+			}
+			return data + 6;
 		}
 	case NifValue::tHalfVector2:
 		{
-			Vector2 * vec = static_cast<Vector2 *>(val.val.data);
-			if ( !vec )
-				return false;
-
-			union { float f; uint32_t i; } xu, yu;
-
-			xu.f = vec->xy[0];
-			yu.f = vec->xy[1];
-
-			uint16_t v[2];
-			v[0] = half_from_float( xu.i );
-			v[1] = half_from_float( yu.i );
-
-			return device->write( (char*)v, 4 ) == 4;
+			union { float f; uint32_t i; } u;
+			Vector2 * v = static_cast<Vector2 *>(val.val.data);
+			for ( int i = 0; i < 2; i++ ) {
+				u.i = half_to_float( loadValue<quint16, BigEndian>( data + i * 2 ) );
+				v->xy[i] = u.f;
+			}
+			return data + 4;
+		}
+	case NifValue::tVector2:
+		{
+			Vector2 * v = static_cast<Vector2 *>(val.val.data);
+			for ( int i = 0; i < 2; i++ )
+				v->xy[i] = loadFloat<BigEndian>( data + i * 4 );
+			return data + 8;
 		}
 	case NifValue::tVector3:
-		return device->write( (char *)static_cast<Vector3 *>(val.val.data)->xyz, 12 ) == 12;
+		{
+			Vector3 * v = static_cast<Vector3 *>(val.val.data);
+			for ( int i = 0; i < 3; i++ )
+				v->xyz[i] = loadFloat<BigEndian>( data + i * 4 );
+			return data + 12;
+		}
 	case NifValue::tVector4:
-		return device->write( (char *)static_cast<Vector4 *>(val.val.data)->xyzw, 16 ) == 16;
-	case NifValue::tTriangle:
-		return device->write( (char *)static_cast<Triangle *>(val.val.data)->v, 6 ) == 6;
+		{
+			Vector4 * v = static_cast<Vector4 *>(val.val.data);
+			for ( int i = 0; i < 4; i++ )
+				v->xyzw[i] = loadFloat<BigEndian>( data + i * 4 );
+			return data + 16;
+		}
 	case NifValue::tQuat:
-		return device->write( (char *)static_cast<Quat *>(val.val.data)->wxyz, 16 ) == 16;
+		{
+			Quat * q = static_cast<Quat *>(val.val.data);
+			for ( int i = 0; i < 4; i++ )
+				q->wxyz[i] = loadFloat<BigEndian>( data + i * 4 );
+			return data + 16;
+		}
+	case NifValue::tColor4:
+		{
+			Color4 * c = static_cast<Color4 *>(val.val.data);
+			for ( int i = 0; i < 4; i++ )
+				c->rgba[i] = loadFloat<BigEndian>( data + i * 4 );
+			return data + 16;
+		}
+	case NifValue::tTriangle:
+		{
+			Triangle * t = static_cast<Triangle *>(val.val.data);
+			for ( int i = 0; i < 3; i++ )
+				t->v[i] = loadValue<quint16, BigEndian>( data + i * 2 );
+			return data + 6;
+		}
 	case NifValue::tQuatXYZW:
 		{
 			Quat * q = static_cast<Quat *>(val.val.data);
-			return device->write( (char *)&q->wxyz[1], 12 ) == 12 && device->write( (char *)q->wxyz, 4 ) == 4;
+			memcpy( &q->wxyz[1], data, 12 );
+			memcpy( q->wxyz, data + 12, 4 );
+			return data + 16;
 		}
 	case NifValue::tMatrix:
-		return device->write( (char *)static_cast<Matrix *>(val.val.data)->m, 36 ) == 36;
+		memcpy( static_cast<Matrix *>(val.val.data)->m, data, 36 );
+		return data + 36;
 	case NifValue::tMatrix4:
-		return device->write( (char *)static_cast<Matrix4 *>(val.val.data)->m, 64 ) == 64;
-	case NifValue::tVector2:
-		return device->write( (char *)static_cast<Vector2 *>(val.val.data)->xy, 8 ) == 8;
+		memcpy( static_cast<Matrix4 *>(val.val.data)->m, data, 64 );
+		return data + 64;
 	case NifValue::tColor3:
-		return device->write( (char *)static_cast<Color3 *>(val.val.data)->rgb, 12 ) == 12;
+		memcpy( static_cast<Color3 *>(val.val.data)->rgb, data, 12 );
+		return data + 12;
 	case NifValue::tByteColor4:
 		{
-			Color4 * color = static_cast<Color4 *>(val.val.data);
-			if ( !color )
-				return false;
+			Color4 * c = static_cast<Color4 *>(val.val.data);
+			c->setRGBA( byteTables.unorm[quint8( data[0] )], byteTables.unorm[quint8( data[1] )],
+						byteTables.unorm[quint8( data[2] )], byteTables.unorm[quint8( data[3] )] );
+			return data + 4;
+		}
+	case NifValue::tBSVertexDesc:
+		static_cast<BSVertexDesc *>(val.val.data)->desc = loadValue<quint64, BigEndian>( data );
+		return data + 8;
+	default:
+		break;
+	}
 
-			quint8 c[4];
+	return data;
+}
 
-			auto cF = color->rgba;
-			for ( int i = 0; i < 4; i++ ) {
-				c[i] = round( cF[i] * 255.0f );
+
+/*
+*  NifOStream
+*/
+
+void NifOStream::init()
+{
+	bool32bit = (model->inherits( "NifModel" ) && model->getVersionNumber() <= 0x04000002);
+	linkAdjust = (model->inherits( "NifModel" ) && model->getVersionNumber() <  0x0303000D);
+	stringAdjust = (model->inherits( "NifModel" ) && model->getVersionNumber() >= 0x14010003);
+}
+
+bool NifOStream::write( const NifValue & val )
+{
+	// Fixed-size values share the encoder of writeFixed()
+	int size = fixedSize( val, bool32bit );
+	if ( size > 0 && halfCount( val ) == 0 ) {
+		char data[64];
+		return encodeFixed( val, data ) && device->write( data, size ) == size;
+	}
+
+	switch ( val.type() ) {
+	case NifValue::tFileVersion:
+		{
+			if ( NifModel * mdl = static_cast<NifModel *>(const_cast<BaseModel *>(model)) ) {
+				QString headerString = mdl->getItem( mdl->getHeaderItem(), "Header String" )->value().toString();
+				quint32 version;
+
+				// hack for neosteam
+				if ( headerString.startsWith( "NS" ) ) {
+					version = 0x08F35232;
+				} else {
+					version = val.val.u32;
+				}
+
+				return device->write( (char *)&version, 4 ) == 4;
+			} else {
+				return device->write( (char *)&val.val.u32, 4 ) == 4;
 			}
+		}
+	case NifValue::tHfloat:
+	case NifValue::tHalfVector3:
+	case NifValue::tHalfVector2:
+		{
+			const float * src = halfSource( val );
+			if ( !src )
+				return false;
 
-			return device->write( (char*)c, 4 ) == 4;
+			int n = halfCount( val );
+			quint32 floats[3];
+			quint16 halves[3];
+			memcpy( floats, src, n * 4 );
+			half_from_float_array( floats, halves, n );
+
+			return device->write( (char *)halves, n * 2 ) == n * 2;
 		}
-	case NifValue::tColor4:
-		return device->write( (char *)static_cast<Color4 *>(val.val.data)->rgba, 16 ) == 16;
 	case NifValue::tSizedString:
 		{
 			QByteArray string = static_cast<QString *>(val.val.data)->toLatin1();
@@ -766,14 +930,6 @@ bool NifOStream::write( const NifValue & val )
 				return device->write( string.constData(), string.size() ) == string.size();
 			}
 		}
-	case NifValue::tBSVertexDesc:
-		{
-			auto d = static_cast<BSVertexDesc *>(val.val.data);
-			if ( !d )
-				return false;
-
-			return device->write( (char*)&d->desc, 8 ) == 8;
-		}
 	case NifValue::tBlob:
 
 		if ( val.val.data ) {
@@ -784,12 +940,179 @@ bool NifOStream::write( const NifValue & val )
 		return true;
 	case NifValue::tNone:
 		return true;
+	default:
+		break;
 	}
 
 	return false;
 }
 
 
+bool NifOStream::writeFixed( const QVector<NifValue *> & values )
+{
+	int len = 0;
+	int halfTotal = 0;
+	for ( const NifValue * v : values ) {
+		int size = fixedSize( *v, bool32bit );
+		if ( size == 0 )
+			return false;
+
+		len += size;
+		halfTotal += halfCount( *v );
+	}
+
+	// Convert the half floats of the run at once
+	QVector<quint16> halves( halfTotal );
+	if ( halfTotal > 0 ) {
+		QVector<quint32> floats( halfTotal );
+		quint32 * dst = floats.data();
+		for ( const NifValue * v : values ) {
+			if ( halfCount( *v ) == 0 )
+				continue;
+
+			const float * src = halfSource( *v );
+			if ( !src )
+				return false;
+
+			memcpy( dst, src, halfCount( *v ) * 4 );
+			dst += halfCount( *v );
+		}
+
+		half_from_float_array( floats.constData(), halves.data(), halfTotal );
+	}
+
+	QByteArray buffer( len, Qt::Uninitialized );
+
+	char * data = buffer.data();
+	const quint16 * half = halves.constData();
+	for ( const NifValue * v : values ) {
+		int n = halfCount( *v );
+		if ( n > 0 ) {
+			memcpy( data, half, n * 2 );
+			data += n * 2;
+			half += n;
+			continue;
+		}
+
+		data = encodeFixed( *v, data );
+		if ( !data )
+			return false;
+	}
+
+	return device->write( buffer ) == len;
+}
+
+char * NifOStream::encodeFixed( const NifValue & val, char * data ) const
+{
+	switch ( val.type() ) {
+	case NifValue::tBool:
+		if ( bool32bit ) {
+			memcpy( data, &val.val.u32, 4 );
+			return data + 4;
+		}
+
+		memcpy( data, &val.val.u08, 1 );
+		return data + 1;
+	case NifValue::tByte:
+		memcpy( data, &val.val.u08, 1 );
+		return data + 1;
+	case NifValue::tWord:
+	case NifValue::tShort:
+	case NifValue::tFlags:
+	case NifValue::tBlockTypeIndex:
+		memcpy( data, &val.val.u16, 2 );
+		return data + 2;
+	case NifValue::tStringOffset:
+	case NifValue::tInt:
+	case NifValue::tUInt:
+	case NifValue::tULittle32:
+	case NifValue::tStringIndex:
+		memcpy( data, &val.val.u32, 4 );
+		return data + 4;
+	case NifValue::tLink:
+	case NifValue::tUpLink:
+		{
+			qint32 l = (linkAdjust) ? val.val.i32 + 1 : val.val.i32;
+			memcpy( data, &l, 4 );
+			return data + 4;
+		}
+	case NifValue::tFloat:
+		memcpy( data, &val.val.f32, 4 );
+		return data + 4;
+	case NifValue::tByteVector3:
+		{
+			Vector3 * vec = static_cast<Vector3 *>(val.val.data);
+			if ( !vec )
+				return nullptr;
+
+			for ( int i = 0; i < 3; i++ )
+				data[i] = quint8( round( ((vec->xyz[i] + 1.0) / 2.0) * 255.0 ) );
+
+			return data + 3;
+		}
+	case NifValue::tVector3:
+		memcpy( data, static_cast<Vector3 *>(val.val.data)->xyz, 12 );
+		return data + 12;
+	case NifValue::tVector4:
+		memcpy( data, static_cast<Vector4 *>(val.val.data)->xyzw, 16 );
+		return data + 16;
+	case NifValue::tTriangle:
+		memcpy( data, static_cast<Triangle *>(val.val.data)->v, 6 );
+		return data + 6;
+	case NifValue::tQuat:
+		memcpy( data, static_cast<Quat *>(val.val.data)->wxyz, 16 );
+		return data + 16;
+	case NifValue::tQuatXYZW:
+		{
+			Quat * q = static_cast<Quat *>(val.val.data);
+			memcpy( data, &q->wxyz[1], 12 );
+			memcpy( data + 12, q->wxyz, 4 );
+			return data + 16;
+		}
+	case NifValue::tMatrix:
+		memcpy( data, static_cast<Matrix *>(val.val.data)->m, 36 );
+		return data + 36;
+	case NifValue::tMatrix4:
+		memcpy( data, static_cast<Matrix4 *>(val.val.data)->m, 64 );
+		return data + 64;
+	case NifValue::tVector2:
+		memcpy( data, static_cast<Vector2 *>(val.val.data)->xy, 8 );
+		return data + 8;
+	case NifValue::tColor3:
+		memcpy( data, static_cast<Color3 *>(val.val.data)->rgb, 12 );
+		return data + 12;
+	case NifValue::tByteColor4:
+		{
+			Color4 * color = static_cast<Color4 *>(val.val.data);
+			if ( !color )
+				return nullptr;
+
+			auto cF = color->rgba;
+			for ( int i = 0; i < 4; i++ )
+				data[i] = quint8( round( cF[i] * 255.0f ) );
+
+			return data + 4;
+		}
+	case NifValue::tColor4:
+		memcpy( data, static_cast<Color4 *>(val.val.data)->rgba, 16 );
+		return data + 16;
+	case NifValue::tBSVertexDesc:
+		{
+			auto d = static_cast<BSVertexDesc *>(val.val.data);
+			if ( !d )
+				return nullptr;
+
+			memcpy( data, &d->desc, 8 );
+			return data + 8;
+		}
+	default:
+		break;
+	}
+
+	return nullptr;
+}
+
+
 /*
 *  NifSStream
 */
@@ -34,15 +34,13 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define NIFSTREAM_H
 
 #include <QCoreApplication>
-
-#include <memory>
+#include <QVector>
 
 
 //! @file nifstream.h NifIStream, NifOStream, NifSStream
 
 class NifValue;
 class BaseModel;
-class QDataStream;
 class QIODevice;
 
 
@@ -60,16 +58,39 @@ public:
 	//! Reads a NifValue from the underlying device. Returns true if successful.
 	bool read( NifValue & );
 
+	/*! Reads a run of fixed-size NifValues with a single device read. Returns true if successful.
+	 *
+	 * @see NifValue::isFixedSize()
+	 */
+	bool readFixed( const QVector<NifValue *> & values );
+
 private:
+	//! Decodes a fixed-size NifValue from a buffer and returns the position after it.
+	template <bool BigEndian, bool Bool32bit, bool LinkAdjust>
+	const char * decode( NifValue & val, const char * data ) const;
+	//! Decodes consecutive fixed-size NifValues from a buffer, taking half floats from \a halves if already converted.
+	template <bool BigEndian, bool Bool32bit, bool LinkAdjust>
+	void decodeRun( const QVector<NifValue *> & values, const char * data, const quint32 * halves ) const;
+
+	using Decoder = const char * (NifIStream::*)( NifValue &, const char * ) const;
+	using RunDecoder = void (NifIStream::*)( const QVector<NifValue *> &, const char *, const quint32 * ) const;
+
+	//! Decoder specialized for the stream configuration
+	Decoder decoder = nullptr;
+	//! Run decoder specialized for the stream configuration
+	RunDecoder runDecoder = nullptr;
+	//! Run decoder for big-endian data which has already been swapped
+	RunDecoder swappedRunDecoder = nullptr;
+
 	//! The model that data is being read into.
 	BaseModel * model;
 	//! The underlying device that data is being read from.
 	QIODevice * device;
-	//! The data stream that is wrapped around the device (simplifies endian conversion)
-	std::unique_ptr<QDataStream> dataStream;
 
 	//! Initialises the stream.
 	void init();
+	//! Selects the decoders for the stream configuration.
+	void selectDecoder();
 
 	//! Whether a boolean is 32-bit.
 	bool bool32bit = false;
@@ -96,7 +117,16 @@ public:
 	//! Writes a NifValue to the underlying device. Returns true if successful.
 	bool write( const NifValue & );
 
+	/*! Writes a run of fixed-size NifValues with a single device write. Returns true if successful.
+	 *
+	 * @see NifValue::isFixedSize()
+	 */
+	bool writeFixed( const QVector<NifValue *> & values );
+
 private:
+	//! Encodes a fixed-size NifValue other than a half float into a buffer and returns the position after it, or null on failure.
+	char * encodeFixed( const NifValue & val, char * data ) const;
+
 	//! The model that data is being read from.
 	const BaseModel * model;
 	//! The underlying device that data is being written to.
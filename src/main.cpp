@@ -31,33 +31,214 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 ***** END LICENCE BLOCK *****/
 
 #include "nifskope.h"
+#include "message.h"
 #include "version.h"
 #include "data/nifvalue.h"
 #include "model/nifmodel.h"
 #include "model/kfmmodel.h"
+#include "gl/glpicking.h"
+#include "gl/glskinning.h"
+#include "gl/glthumbnail.h"
 
 #include <QApplication>
+#include <QBuffer>
 #include <QCommandLineParser>
+#include <QDebug>
 #include <QDesktopServices>
 #include <QDir>
+#include <QDirIterator>
 #include <QSettings>
 #include <QStack>
+#include <QThread>
 #include <QUdpSocket>
 #include <QUrl>
 
 
-QCoreApplication * createApplication( int &argc, char *argv[] )
+//! Whether NifSkope was started with -no-gui, for batch tools without windows
+static bool isHeadless( int argc, char * argv[] )
 {
 	// Iterate over args
 	for ( int i = 1; i < argc; ++i ) {
-		// -no-gui: start as core app without all the GUI overhead
 		if ( !qstrcmp( argv[i], "-no-gui" ) ) {
-			return new QCoreApplication( argc, argv );
+			return true;
 		}
 	}
+	return false;
+}
+
+QApplication * createApplication( int &argc, char *argv[], bool headless )
+{
+	// -no-gui: batch tools still need a GUI application for OpenGL
+	//	Without a display they draw through the offscreen platform plugin
+#ifdef Q_OS_LINUX
+	if ( headless && qEnvironmentVariableIsEmpty( "QT_QPA_PLATFORM" )
+		&& qEnvironmentVariableIsEmpty( "DISPLAY" ) && qEnvironmentVariableIsEmpty( "WAYLAND_DISPLAY" ) )
+	{
+		qputenv( "QT_QPA_PLATFORM", "offscreen" );
+	}
+#else
+	Q_UNUSED( headless );
+#endif
 	return new QApplication( argc, argv );
 }
 
+/*! Loads and saves every NIF in @p inputs and compares the saved bytes with the file
+ *
+ * Checks that the fixed-layout array readers and writers of NifIStream and NifOStream
+ * round-trip blocks such as BSTriShape, NiTriShapeData, NiSkinPartition and NiTransformData.
+ *
+ * @return The number of files that failed to load or did not match
+ */
+static int checkRoundTrip( const QStringList & inputs )
+{
+	static const QStringList filters = { "*.nif", "*.nifcache", "*.btr", "*.bto", "*.kf" };
+
+	QStringList files;
+	for ( const QString & input : inputs ) {
+		QFileInfo info( input );
+
+		if ( info.isDir() ) {
+			QDirIterator it( info.absoluteFilePath(), filters, QDir::Files, QDirIterator::Subdirectories );
+			while ( it.hasNext() )
+				files << it.next();
+		} else if ( info.isFile() ) {
+			files << info.absoluteFilePath();
+		} else {
+			qWarning() << "Could not find" << input;
+		}
+	}
+
+	int failed = 0;
+	for ( const QString & file : files ) {
+		QFile f( file );
+		if ( !f.open( QIODevice::ReadOnly ) ) {
+			qWarning() << "Could not open" << file;
+			failed++;
+			continue;
+		}
+
+		QByteArray original = f.readAll();
+
+		QBuffer in( &original );
+		in.open( QIODevice::ReadOnly );
+
+		NifModel nif;
+		if ( !nif.load( in ) ) {
+			qWarning() << "Could not load" << file;
+			failed++;
+			continue;
+		}
+
+		QByteArray saved;
+		QBuffer out( &saved );
+		out.open( QIODevice::WriteOnly );
+		nif.save( out );
+
+		if ( saved == original ) {
+			qInfo() << "Matches" << file;
+			continue;
+		}
+
+		int offset = 0;
+		while ( offset < saved.size() && offset < original.size() && saved.at( offset ) == original.at( offset ) )
+			offset++;
+
+		qWarning() << "Differs" << file << "at offset" << offset << "of" << original.size() << "saved" << saved.size();
+		failed++;
+	}
+
+	qInfo() << files.count() - failed << "of" << files.count() << "files match";
+
+	return failed;
+}
+
+//! Renders PNG thumbnails of the NIF files and folders on the command line
+static int renderThumbnails( QApplication * a )
+{
+	a->setOrganizationName( "NifTools" );
+	a->setOrganizationDomain( "niftools.org" );
+	a->setApplicationName( "NifSkope " + NifSkopeVersion::rawToMajMin( NIFSKOPE_VERSION ) );
+	a->setApplicationVersion( NIFSKOPE_VERSION );
+
+	// Paths on the command line are relative to where NifSkope was started
+	QDir startDir = QDir::current();
+	QDir::setCurrent( qApp->applicationDirPath() );
+
+	// Log messages instead of showing message boxes
+	Message::setHeadless( true );
+
+	// Register types
+	qRegisterMetaType<NifValue>( "NifValue" );
+	QMetaType::registerComparators<NifValue>();
+
+	// Load XML files
+	NifModel::loadXML();
+
+	// Command Line setup
+	QCommandLineParser parser;
+	parser.setSingleDashWordOptionMode( QCommandLineParser::ParseAsLongOptions );
+	parser.setApplicationDescription( "Renders PNG thumbnails of NIF files, and of the NIF files in folders" );
+	parser.addHelpOption();
+	parser.addVersionOption();
+
+	QCommandLineOption noGuiOption( "no-gui", "Run without windows" );
+	QCommandLineOption sizeOption( {"s", "size"}, "Thumbnail size, as 256 or 320x240", "size", "256" );
+	QCommandLineOption outputOption( {"o", "output"}, "Folder for the thumbnails, next to the NIF files by default", "folder" );
+	QCommandLineOption threadsOption( {"t", "threads"}, "Threads reading and writing files", "threads",
+	                                  QString::number( QThread::idealThreadCount() ) );
+	QCommandLineOption roundTripOption( "roundtrip", "Load and save the NIF files and compare the bytes instead of rendering" );
+	QCommandLineOption benchSkinningOption( "bench-skinning", "Time the CPU skinning of a mesh instead of rendering", "vertices" );
+	QCommandLineOption checkPickingOption( "check-picking", "Cast known rays against a test mesh instead of rendering" );
+	parser.addOption( noGuiOption );
+	parser.addOption( sizeOption );
+	parser.addOption( outputOption );
+	parser.addOption( threadsOption );
+	parser.addOption( roundTripOption );
+	parser.addOption( benchSkinningOption );
+	parser.addOption( checkPickingOption );
+	parser.addPositionalArgument( "files", "NIF files or folders", "[files...]" );
+
+	// Process options
+	parser.process( *a );
+
+	QStringList size = parser.value( sizeOption ).split( 'x' );
+	int width = size.value( 0 ).toInt();
+	int height = size.value( 1, size.value( 0 ) ).toInt();
+
+	if ( width <= 0 || height <= 0 ) {
+		qCritical() << "Invalid thumbnail size" << parser.value( sizeOption );
+		return 1;
+	}
+
+	if ( parser.isSet( benchSkinningOption ) ) {
+		// 4 influences per vertex over 60 bones, as in a typical character body
+		SkinKernel::benchmark( parser.value( benchSkinningOption ).toInt(), 4, 60, 200 );
+		return 0;
+	}
+
+	if ( parser.isSet( checkPickingOption ) )
+		return (TriangleTree::check() > 0) ? 1 : 0;
+
+	QStringList inputs;
+	for ( const QString & arg : parser.positionalArguments() ) {
+		inputs << startDir.absoluteFilePath( arg );
+	}
+
+	if ( inputs.isEmpty() )
+		parser.showHelp( 1 );
+
+	if ( parser.isSet( roundTripOption ) )
+		return (checkRoundTrip( inputs ) > 0) ? 1 : 0;
+
+	QString output;
+	if ( parser.isSet( outputOption ) )
+		output = startDir.absoluteFilePath( parser.value( outputOption ) );
+
+	int written = ThumbnailRenderer::renderFiles( inputs, output, QSize( width, height ), parser.value( threadsOption ).toInt() );
+
+	return (written < 0) ? 1 : 0;
+}
+
 
 /*
  *  main
@@ -66,9 +247,12 @@ QCoreApplication * createApplication( int &argc, char *argv[] )
 //! The main program
 int main( int argc, char * argv[] )
 {
-	QScopedPointer<QCoreApplication> app( createApplication( argc, argv ) );
+	bool headless = isHeadless( argc, argv );
+
+	QScopedPointer<QApplication> app( createApplication( argc, argv, headless ) );
+	auto a = app.data();
 
-	if ( auto a = qobject_cast<QApplication *>(app.data()) ) {
+	if ( !headless ) {
 
 		a->setOrganizationName( "NifTools" );
 		a->setOrganizationDomain( "niftools.org" );
@@ -148,7 +332,8 @@ int main( int argc, char * argv[] )
 			return 0;
 		}
 	} else {
-		// Future command line batch tools here
+		// Command line batch tools
+		return renderThumbnails( a );
 	}
 
 	return 0;
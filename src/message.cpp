@@ -11,6 +11,22 @@ Q_LOGGING_CATEGORY( nsIo, "nifskope.io" )
 Q_LOGGING_CATEGORY( nsNif, "nifskope.nif" )
 Q_LOGGING_CATEGORY( nsSpell, "nifskope.spell" )
 
+//! Whether messages are logged instead of shown
+static bool headless = false;
+
+//! Writes a message to the log with the category of its icon
+static void logMessage( const QString & str, const QString & err, QMessageBox::Icon icon )
+{
+	QString msg = err.isEmpty() ? str : QString( "%1 %2" ).arg( str, err );
+
+	if ( icon == QMessageBox::Critical )
+		qCCritical( ns ).noquote() << msg;
+	else if ( icon == QMessageBox::Warning )
+		qCWarning( ns ).noquote() << msg;
+	else
+		qCInfo( ns ).noquote() << msg;
+}
+
 
 Message::Message() : QObject( nullptr )
 {
@@ -22,9 +38,19 @@ Message::~Message()
 
 }
 
+void Message::setHeadless( bool enable )
+{
+	headless = enable;
+}
+
 //! Static helper for message box without detail text
 void Message::message( QWidget * parent, const QString & str, QMessageBox::Icon icon )
 {
+	if ( headless ) {
+		logMessage( str, QString(), icon );
+		return;
+	}
+
 	auto msgBox = new QMessageBox( parent );
 
 	// Keep message box on top if it does not have a parent
@@ -43,6 +69,11 @@ void Message::message( QWidget * parent, const QString & str, QMessageBox::Icon
 //! Static helper for message box with detail text
 void Message::message( QWidget * parent, const QString & str, const QString & err, QMessageBox::Icon icon )
 {
+	if ( headless ) {
+		logMessage( str, err, icon );
+		return;
+	}
+
 	if ( !parent )
 		parent = qApp->activeWindow();
 
@@ -139,6 +170,11 @@ static QMap<QString, QMessageBox *> messageBoxes;
 
 void Message::append( QWidget * parent, const QString & str, const QString & err, QMessageBox::Icon icon )
 {
+	if ( headless ) {
+		logMessage( str, err, icon );
+		return;
+	}
+
 	if ( !parent )
 		parent = qApp->activeWindow();
 
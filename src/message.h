@@ -22,6 +22,9 @@ class Message : QObject
 	~Message();
 
 public:
+	//! Writes all messages to the log instead of showing message boxes, for batch tools
+	static void setHeadless( bool );
+
 	static void message( QWidget *, const QString &, QMessageBox::Icon );
 	static void message( QWidget *, const QString &, const QString &, QMessageBox::Icon );
 	static void message( QWidget *, const QString &, const QMessageLogContext *, QMessageBox::Icon );
@@ -173,12 +173,75 @@ bool NifModel::evalVersion( NifItem * item, bool chkParents ) const
 		return true;
 
 	// If there is a vercond, evaluate it
-	NifModelEval functor( this, getHeaderItem() );
-	item->setVersionCondition( item->verexpr().evaluateBool( functor ) );
+	item->setVersionCondition( evalVersionCondition( item->vercond(), item->verexpr() ) );
 
 	return item->versionCondition();
 }
 
+bool NifModel::evalVersionCondition( const QString & vercond, const NifExpr & verexpr ) const
+{
+	if ( schema.active ) {
+		auto it = schema.verconds.constFind( vercond );
+		if ( it != schema.verconds.constEnd() )
+			return it.value();
+	}
+
+	NifModelEval functor( this, getHeaderItem() );
+	bool result = verexpr.evaluateBool( functor );
+
+	if ( schema.active )
+		schema.verconds.insert( vercond, result );
+
+	return result;
+}
+
+void NifModel::updateSchemaView()
+{
+	NifItem * header = getHeaderItem();
+	if ( !header )
+		return;
+
+	// Read the header without the cached verconds
+	schema.active = false;
+
+	schema.version = version;
+	schema.userVersion = get<int>( header, "User Version" );
+	schema.userVersion2 = get<int>( header, "User Version 2" );
+	schema.verconds.clear();
+
+	schema.active = true;
+
+	// Prototypes were built for the previous view
+	prototypes.clear();
+
+	// Rebuild the version conditions of the existing rows
+	updateSchemaConditions( root );
+}
+
+void NifModel::updateSchemaConditions( NifItem * parent )
+{
+	for ( NifItem * c : parent->children() ) {
+		setSchemaCondition( c );
+		updateSchemaConditions( c );
+	}
+}
+
+void NifModel::setSchemaCondition( NifItem * item ) const
+{
+	if ( !schema.active )
+		return;
+
+	// Rows of a row outside of the view are outside too
+	NifItem * parent = item->parent();
+	if ( parent && parent != root && parent->isVercondValid() && !parent->versionCondition() ) {
+		item->setVersionCondition( false );
+		return;
+	}
+
+	item->setVersionCondition( item->evalVersion( version )
+		&& (item->vercond().isEmpty() || evalVersionCondition( item->vercond(), item->verexpr() )) );
+}
+
 void NifModel::clear()
 {
 	beginResetModel();
@@ -187,6 +250,10 @@ void NifModel::clear()
 	folder = QString();
 	root->killChildren();
 
+	// Header and footer are inserted before the version is known
+	schema = SchemaView();
+	prototypes.clear();
+
 	NifData headerData = NifData( "NiHeader", "Header" );
 	NifData footerData = NifData( "NiFooter", "Footer" );
 	headerData.setIsCompound( true );
@@ -659,20 +726,11 @@ QModelIndex NifModel::insertNiBlock( const QString & identifier, int at )
 
 		beginInsertRows( QModelIndex(), at, at );
 
-		NifItem * branch = insertBranch( root, NifData( identifier, "NiBlock", block->text ), at );
-		branch->setCondition( true );
+		NifItem * branch = getPrototype( identifier, block )->clone();
+		root->insertChild( branch, at );
 
 		endInsertRows();
 
-		if ( !block->ancestor.isEmpty() )
-			insertAncestor( branch, block->ancestor );
-
-		branch->prepareInsert( block->types.count() );
-
-		for ( const NifData& data : block->types ) {
-			insertType( branch, data );
-		}
-
 		if ( state != Loading ) {
 			updateHeader();
 			updateLinks();
@@ -1001,6 +1059,37 @@ int NifModel::getBlockCount() const
 }
 
 
+NifItem * NifModel::getPrototype( const QString & identifier, const NifBlockPtr & block )
+{
+	// String types are resolved against the version on insertion
+	if ( prototypeVersion != version ) {
+		prototypes.clear();
+		prototypeVersion = version;
+	}
+
+	NifItemPtr proto = prototypes.value( identifier );
+	if ( proto )
+		return proto.get();
+
+	proto = NifItemPtr( new NifItem( NifData( identifier, "NiBlock", block->text ), nullptr ) );
+	proto->value().changeType( NifValue::tNone );
+	proto->setCondition( true );
+
+	if ( !block->ancestor.isEmpty() )
+		insertAncestor( proto.get(), block->ancestor );
+
+	proto->prepareInsert( block->types.count() );
+
+	for ( const NifData & data : block->types ) {
+		insertType( proto.get(), data );
+	}
+
+	prototypes.insert( identifier, proto );
+
+	return proto.get();
+}
+
+
 /*
  *  ancestor functions
  */
@@ -1085,11 +1174,13 @@ void NifModel::insertType( NifItem * parent, const NifData & data, int at )
 
 	if ( data.isArray() ) {
 		NifItem * item = insertBranch( parent, data, at );
+		setSchemaCondition( item );
 	} else if ( data.isCompound() ) {
 		NifBlockPtr compound = compounds.value( data.type() );
 		if ( !compound )
 			return;
 		NifItem * branch = insertBranch( parent, data, at );
+		setSchemaCondition( branch );
 		branch->prepareInsert( compound->types.count() );
 		for ( const NifData & d : compound->types ) {
 			insertType( branch, d );
@@ -1127,6 +1218,7 @@ void NifModel::insertType( NifItem * parent, const NifData & data, int at )
 		insertType( parent, d, at );
 	} else {
 		NifItem * item = parent->insertChild( data, at );
+		setSchemaCondition( item );
 
 		// Kludge for string conversion.
 		//  Ensure that the string type is correct for the nif version
@@ -1561,6 +1653,16 @@ bool NifModel::setData( const QModelIndex & index, const QVariant & value, int r
 					updateFooter();
 					emit linksChanged();
 				}
+
+				// Header edits may change the verconds of the schema view
+				if ( schema.active ) {
+					NifItem * block = item;
+					while ( block->parent() && block->parent() != root )
+						block = block->parent();
+
+					if ( block == getHeaderItem() )
+						updateSchemaView();
+				}
 			}
 		}
 		break;
@@ -1788,6 +1890,9 @@ bool NifModel::load( QIODevice & device )
 		return false;
 	}
 
+	// Blocks are inserted using the version of this file
+	updateSchemaView();
+
 	int numblocks = 0;
 	numblocks = get<int>( header, "Num Blocks" );
 	//qDebug( "numblocks %i", numblocks );
@@ -2293,8 +2398,16 @@ bool NifModel::loadItem( NifItem * parent, NifIStream & stream )
 
 		if ( evalCondition( child ) ) {
 			if ( isArray( child ) ) {
-				if ( !updateArrayItem( child ) || !loadItem( child, stream ) )
+				if ( !updateArrayItem( child ) )
 					return false;
+
+				QVector<NifValue *> values;
+				if ( loadFixedArray( child, values ) ) {
+					if ( !stream.readFixed( values ) )
+						return false;
+				} else if ( !loadItem( child, stream ) ) {
+					return false;
+				}
 			} else if ( child->childCount() > 0 ) {
 				if ( !loadItem( child, stream ) )
 					return false;
@@ -2308,6 +2421,135 @@ bool NifModel::loadItem( NifItem * parent, NifIStream & stream )
 	return true;
 }
 
+bool NifModel::loadFixedArray( NifItem * array, QVector<NifValue *> & values )
+{
+	if ( array->isBinary() || array->childCount() == 0 )
+		return false;
+
+	NifItem * first = array->child( 0 );
+
+	if ( first->isCompound() ) {
+		bool fixedCompound = isFixedCompound( array->type() );
+
+		// Evaluate the rows of the first compound and size its constant length arrays in every compound
+		for ( auto c : first->children() ) {
+			if ( !fixedCompound && !c->cond().isEmpty() )
+				return false;
+
+			if ( !c->isConditionless() )
+				c->invalidateCondition();
+
+			if ( c->isAbstract() || !evalCondition( c ) || !isArray( c ) )
+				continue;
+
+			bool ok = false;
+			int length = c->arr1().toInt( &ok );
+			if ( !ok || length <= 0 || !c->arr2().isEmpty() || c->isBinary() )
+				return false;
+
+			for ( auto e : array->children() ) {
+				if ( e->childCount() != first->childCount() )
+					return false;
+
+				NifItem * r = e->child( c->row() );
+				if ( r->childCount() != length && !updateArrayItem( r ) )
+					return false;
+			}
+		}
+
+		// Cache the conditions of the first compound on the others
+		for ( auto e : array->children() ) {
+			if ( e == first || e->childCount() != first->childCount() )
+				continue;
+
+			for ( int r = 0; r < e->childCount(); r++ )
+				e->child( r )->setCondition( first->child( r )->condition() );
+		}
+	}
+
+	return getFixedArray( array, values );
+}
+
+bool NifModel::getFixedArray( NifItem * array, QVector<NifValue *> & values ) const
+{
+	if ( array->isBinary() || array->childCount() == 0 )
+		return false;
+
+	NifItem * first = array->child( 0 );
+
+	// Array of values
+	if ( first->childCount() == 0 && !isArray( first ) ) {
+		if ( first->isAbstract() || !first->value().isFixedSize() )
+			return false;
+
+		values.reserve( array->childCount() );
+		for ( auto c : array->children() )
+			values.append( &c->value() );
+
+		return true;
+	}
+
+	// Array of compounds, the rows must have the same conditions in every compound
+	if ( !first->isCompound() )
+		return false;
+
+	bool fixedCompound = isFixedCompound( array->type() );
+
+	// Rows of the first compound which are present, and their length if they are arrays
+	QVector<int> rows;
+	QVector<int> lengths;
+	for ( auto c : first->children() ) {
+		if ( !fixedCompound && !c->cond().isEmpty() )
+			return false;
+
+		if ( c->isAbstract() || !evalCondition( c ) )
+			continue;
+
+		int length = 0;
+		if ( isArray( c ) ) {
+			// Only arrays of constant length
+			bool ok = false;
+			length = c->arr1().toInt( &ok );
+			if ( !ok || length <= 0 || !c->arr2().isEmpty() || c->isBinary() )
+				return false;
+
+			if ( c->childCount() != length )
+				return false;
+
+			NifItem * v = c->child( 0 );
+			if ( v->childCount() > 0 || !v->value().isFixedSize() )
+				return false;
+		} else if ( c->childCount() > 0 || !c->value().isFixedSize() ) {
+			return false;
+		}
+
+		rows << c->row();
+		lengths << length;
+	}
+
+	values.reserve( array->childCount() * rows.count() );
+	for ( auto e : array->children() ) {
+		if ( e->childCount() != first->childCount() )
+			return false;
+
+		for ( int i = 0; i < rows.count(); i++ ) {
+			NifItem * c = e->child( rows.at( i ) );
+			if ( lengths.at( i ) == 0 ) {
+				values.append( &c->value() );
+				continue;
+			}
+
+			if ( c->childCount() != lengths.at( i ) )
+				return false;
+
+			for ( auto v : c->children() )
+				values.append( &v->value() );
+		}
+	}
+
+	return true;
+}
+
 bool NifModel::loadHeader( NifItem * header, NifIStream & stream )
 {
 	// Load header separately and invalidate conditions before reading
@@ -2346,8 +2588,13 @@ bool NifModel::saveItem( NifItem * parent, NifOStream & stream ) const
 					}
 				}
 
-				if ( !saveItem( child, stream ) )
+				QVector<NifValue *> values;
+				if ( isArray( child ) && getFixedArray( child, values ) ) {
+					if ( !stream.writeFixed( values ) )
+						return false;
+				} else if ( !saveItem( child, stream ) ) {
 					return false;
+				}
 			} else {
 				if ( !stream.write( child->value() ) )
 					return false;
@@ -2436,7 +2683,11 @@ void NifModel::invalidateConditions( NifItem * item, bool refresh )
 {
 	for ( NifItem * c : item->children() ) {
 		c->invalidateCondition();
-		c->invalidateVersionCondition();
+		// Version conditions only change with the schema view
+		if ( schema.active )
+			setSchemaCondition( c );
+		else
+			c->invalidateVersionCondition();
 		if ( refresh )
 			c->setCondition( BaseModel::evalCondition( c ) );
 
@@ -47,6 +47,7 @@ class SpellBook;
 class QUndoStack;
 
 using NifBlockPtr = std::shared_ptr<NifBlock>;
+using NifItemPtr = std::shared_ptr<NifItem>;
 using SpellBookPtr = std::shared_ptr<SpellBook>;
 
 //! @file nifmodel.h NifModel, NifModelEval
@@ -330,6 +331,10 @@ protected:
 	// end BaseModel
 
 	bool loadItem( NifItem * parent, NifIStream & stream );
+	//! Evaluate the conditions and sizes of a fixed layout array before it is read, then collect its values
+	bool loadFixedArray( NifItem * array, QVector<NifValue *> & values );
+	//! Collect the values of an array whose elements share a fixed byte layout, without changing its items
+	bool getFixedArray( NifItem * array, QVector<NifValue *> & values ) const;
 	bool loadHeader( NifItem * parent, NifIStream & stream );
 	bool saveItem( NifItem * parent, NifOStream & stream ) const;
 	bool fileOffset( NifItem * parent, NifItem * target, NifSStream & stream, int & ofs ) const;
@@ -341,7 +346,18 @@ protected:
 	int getBlockNumber( NifItem * item ) const;
 	bool itemIsLink( NifItem * item, bool * ischildLink = 0 ) const;
 
+	//! Specialize the schema view for the version and user versions in the header
+	void updateSchemaView();
+	//! Set the version conditions of the rows below parent from the schema view
+	void updateSchemaConditions( NifItem * parent );
+	//! Set the version condition of a row from the schema view, while it is active
+	void setSchemaCondition( NifItem * item ) const;
+	//! Evaluate a vercond expression, cached by the schema view while it is active
+	bool evalVersionCondition( const QString & vercond, const NifExpr & verexpr ) const;
+
 	void insertAncestor( NifItem * parent, const QString & identifier, int row = -1 );
+	//! Get the prototype item tree for a NiBlock, building it on first use
+	NifItem * getPrototype( const QString & identifier, const NifBlockPtr & block );
 	void insertType( NifItem * parent, const NifData & data, int row = -1 );
 	NifItem * insertBranch( NifItem * parent, const NifData & data, int row = -1 );
 
@@ -366,6 +382,24 @@ protected:
 
 	bool lockUpdates;
 
+	//! Prototype item trees for each inserted NiBlock type, cloned by insertNiBlock
+	QHash<QString, NifItemPtr> prototypes;
+	//! The version the prototypes were built for
+	quint32 prototypeVersion = 0;
+
+	//! The XML schema specialized for the version of the loaded file
+	struct SchemaView
+	{
+		//! Set once the header of a file has been read
+		bool active = false;
+		quint32 version = 0;
+		quint32 userVersion = 0;
+		quint32 userVersion2 = 0;
+		//! Pre-evaluated vercond expressions
+		QHash<QString, bool> verconds;
+	};
+	mutable SchemaView schema;
+
 	enum UpdateType
 	{
 		utNone   = 0,
@@ -301,6 +301,9 @@ void NifSkope::initActions()
 
 	connect( ui->aPrintView, &QAction::triggered, ogl, &GLView::saveImage );
 
+	connect( ui->aProfiler, &QAction::toggled, ogl, &GLView::setProfiling );
+	connect( ui->aSaveProfile, &QAction::triggered, ogl, &GLView::saveProfile );
+
 #ifdef QT_NO_DEBUG
 	ui->aColorKeyDebug->setDisabled( true );
 	ui->aColorKeyDebug->setVisible( false );